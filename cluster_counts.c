@@ -0,0 +1,160 @@
+// cluster number counts from two look-up tables instead of one N_N200 integration per bin
+//   mass function table: dV/dz dz x M dn/dM on (cluster z bin, z node, ln M node), depends on cosmology only
+//   selection table: probability of the richness bin for the Murata et al. (2018) lognormal
+//                    mass-richness relation on (cluster z bin, z node, richness bin, ln M node), depends on cluster_Mobs only
+// counts are the contraction of the two tables; each table is recomputed only when its parameters change,
+// so steps in the mass-observable parameters (m_lambda in fisher.py) skip the mass function
+// call reset_cluster_counts whenever the cluster z or richness bins change
+// the cluster covariance blocks still use the cosmolike_core N_N200; check_cluster_counts compares both bin by bin
+// (opt-in, ./like_fourier <scenario> validate_clusters)
+
+#define CLUSTER_NM 200
+#define CLUSTER_NZ 16
+#define CLUSTER_LNMMIN 27.631021 //ln(1e12 Msun/h)
+#define CLUSTER_LNMMAX 36.841361 //ln(1e16 Msun/h)
+#define CLUSTER_COUNTS_TOL 1.e-2 //largest accepted relative deviation from N_N200
+
+typedef struct {
+  int Nbin; //cluster z bins of the tables
+  int Nrich; //richness bins of the tables
+  int ready_mf, ready_sel;
+  double cosmo_key[9]; //parameter state of the mass function table
+  double mor_key[6]; //parameter state of the selection table
+  double *mf; //[Nbin][CLUSTER_NZ][CLUSTER_NM]
+  double *sel; //[Nbin][CLUSTER_NZ][Nrich][CLUSTER_NM]
+}clustercounttable;
+
+clustercounttable cluster_counts = {0, 0, 0, 0, {0.}, {0.}, NULL, NULL};
+
+void reset_cluster_counts();
+double N_N200_table(int nz, int nN);
+double check_cluster_counts();
+
+void reset_cluster_counts()
+{
+  free(cluster_counts.mf);
+  free(cluster_counts.sel);
+  cluster_counts.mf=cluster_counts.sel=NULL;
+  cluster_counts.Nbin=cluster_counts.Nrich=0;
+  cluster_counts.ready_mf=cluster_counts.ready_sel=0;
+}
+
+double cluster_counts_lnM(int iM)
+{
+  return CLUSTER_LNMMIN+iM*(CLUSTER_LNMMAX-CLUSTER_LNMMIN)/(CLUSTER_NM-1.);
+}
+
+// z node iz of cluster z bin nz, trapezoid in z
+double cluster_counts_z(int nz, int iz, double *dz)
+{
+  double h=(tomo.cluster_zmax[nz]-tomo.cluster_zmin[nz])/(CLUSTER_NZ-1.);
+  *dz=((iz==0 || iz==CLUSTER_NZ-1) ? 0.5*h : h);
+  return tomo.cluster_zmin[nz]+iz*h;
+}
+
+void cluster_counts_alloc()
+{
+  reset_cluster_counts();
+  cluster_counts.Nbin=tomo.cluster_Nbin;
+  cluster_counts.Nrich=Cluster.N200_Nbin;
+  cluster_counts.mf=malloc(cluster_counts.Nbin*CLUSTER_NZ*CLUSTER_NM*sizeof(double));
+  cluster_counts.sel=malloc(cluster_counts.Nbin*CLUSTER_NZ*cluster_counts.Nrich*CLUSTER_NM*sizeof(double));
+  if (cluster_counts.sel==NULL){
+    printf("cluster_counts_alloc: allocation failed\nEXIT\n");
+    exit(1);
+  }
+}
+
+void cluster_counts_mass_function()
+{
+  int nz,iz,iM;
+  double z,dz,a,fK,dV,dlnM,M,*mf;
+  dlnM=(CLUSTER_LNMMAX-CLUSTER_LNMMIN)/(CLUSTER_NM-1.);
+  for (nz=0;nz<cluster_counts.Nbin; nz++){
+    for (iz=0;iz<CLUSTER_NZ; iz++){
+      z=cluster_counts_z(nz,iz,&dz);
+      a=1./(1.+z);
+      fK=f_K(chi(a));
+      // comoving volume per steradian, dV/dz = f_K^2 dchi/da a^2 in (c/H0)^3, the volume unit of massfunc
+      dV=fK*fK*dchi_da(a)*a*a*dz;
+      mf=cluster_counts.mf+(nz*CLUSTER_NZ+iz)*CLUSTER_NM;
+      for (iM=0;iM<CLUSTER_NM; iM++){
+        M=exp(cluster_counts_lnM(iM));
+        mf[iM]=dV*massfunc(M,a)*M*((iM==0 || iM==CLUSTER_NM-1) ? 0.5*dlnM : dlnM);
+      }
+    }
+  }
+}
+
+// probability of Cluster.N_min[nN] <= N200 < Cluster.N_max[nN] given M and z,
+// lnN200 = lgN0 + alpha ln(M/3e14) + beta ln(1+z) with scatter scatter_lgN200_model_mz
+void cluster_counts_selection()
+{
+  int nz,iz,nN,iM;
+  double z,dz,a,M,mu,sigma,*sel;
+  for (nz=0;nz<cluster_counts.Nbin; nz++){
+    for (iz=0;iz<CLUSTER_NZ; iz++){
+      z=cluster_counts_z(nz,iz,&dz);
+      a=1./(1.+z);
+      for (iM=0;iM<CLUSTER_NM; iM++){
+        M=exp(cluster_counts_lnM(iM));
+        mu=nuisance.cluster_Mobs_lgN0+nuisance.cluster_Mobs_alpha*log(M/3.e14)+nuisance.cluster_Mobs_beta*log(1.+z);
+        sigma=scatter_lgN200_model_mz(M,a);
+        for (nN=0;nN<cluster_counts.Nrich; nN++){
+          sel=cluster_counts.sel+((nz*CLUSTER_NZ+iz)*cluster_counts.Nrich+nN)*CLUSTER_NM;
+          sel[iM]=0.5*(erf((log(Cluster.N_max[nN])-mu)/(M_SQRT2*sigma))-erf((log(Cluster.N_min[nN])-mu)/(M_SQRT2*sigma)));
+        }
+      }
+    }
+  }
+}
+
+void update_cluster_counts()
+{
+  double ckey[9]={cosmology.Omega_m,cosmology.sigma_8,cosmology.n_spec,cosmology.w0,cosmology.wa,cosmology.omb,cosmology.h0,cosmology.MGSigma,cosmology.MGmu};
+  double mkey[6]={nuisance.cluster_Mobs_lgN0,nuisance.cluster_Mobs_alpha,nuisance.cluster_Mobs_beta,nuisance.cluster_Mobs_sigma0,nuisance.cluster_Mobs_sigma_qm,nuisance.cluster_Mobs_sigma_qz};
+
+  if (cluster_counts.mf==NULL || cluster_counts.Nbin!=tomo.cluster_Nbin || cluster_counts.Nrich!=Cluster.N200_Nbin) cluster_counts_alloc();
+  if (!cluster_counts.ready_mf || memcmp(ckey,cluster_counts.cosmo_key,sizeof(ckey))!=0){
+    cluster_counts_mass_function();
+    memcpy(cluster_counts.cosmo_key,ckey,sizeof(ckey));
+    cluster_counts.ready_mf=1;
+  }
+  if (!cluster_counts.ready_sel || memcmp(mkey,cluster_counts.mor_key,sizeof(mkey))!=0){
+    cluster_counts_selection();
+    memcpy(cluster_counts.mor_key,mkey,sizeof(mkey));
+    cluster_counts.ready_sel=1;
+  }
+}
+
+// expected number of clusters in cluster z bin nz and richness bin nN
+double N_N200_table(int nz, int nN)
+{
+  int iz,iM;
+  double N=0.,*mf,*sel;
+  update_cluster_counts();
+  for (iz=0;iz<CLUSTER_NZ; iz++){
+    mf=cluster_counts.mf+(nz*CLUSTER_NZ+iz)*CLUSTER_NM;
+    sel=cluster_counts.sel+((nz*CLUSTER_NZ+iz)*cluster_counts.Nrich+nN)*CLUSTER_NM;
+    for (iM=0;iM<CLUSTER_NM; iM++) N+=mf[iM]*sel[iM];
+  }
+  return N*survey.area*pow(M_PI/180.,2.)*nuisance.cluster_completeness[nz];
+}
+
+// prints N_N200_table and the cosmolike_core N_N200 of every bin, returns the largest relative deviation
+double check_cluster_counts()
+{
+  int nz,nN;
+  double Nt,Nc,dev,maxdev=0.;
+  for (nz=0;nz<tomo.cluster_Nbin; nz++){
+    for (nN=0;nN<Cluster.N200_Nbin; nN++){
+      Nt=N_N200_table(nz,nN);
+      Nc=N_N200(nz,nN);
+      dev=(Nc > 0. ? fabs(Nt/Nc-1.) : fabs(Nt));
+      if (dev > maxdev) maxdev=dev;
+      printf("cluster z bin %d, richness bin %d (%e - %e): N_N200_table %e, N_N200 %e, deviation %e\n",nz,nN,Cluster.N_min[nN],Cluster.N_max[nN],Nt,Nc,dev);
+    }
+  }
+  if (maxdev > CLUSTER_COUNTS_TOL) printf("check_cluster_counts: WARNING table deviates from N_N200 by %e > %e\n",maxdev,CLUSTER_COUNTS_TOL);
+  return maxdev;
+}
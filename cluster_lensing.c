@@ -0,0 +1,107 @@
+// cluster weak lensing spectra from the cluster count tables (cluster_counts.c)
+// for every (cluster z bin, richness bin) the richness-weighted halo-matter cross spectrum
+//   P_cm(k,z) = <M/rho_m u_nfw(k,M) + b(M) P_lin(k,z)>, averaged with dn/dM x P(richness bin|M,z)
+// is evaluated once on the (z node, ell_Cluster) grid; the NFW profiles are shared by all richness bins.
+// C_cgl(ell,zc,nN,zs) is then a sum over the z nodes of the cluster redshift distribution, the same for
+// all source bins, instead of a mass x redshift integral per (ell, zc, nN, zs) as in C_cgl_tomo_nointerp.
+// centrally located clusters (cluster_centering_f0=1), as in the SRD setup, and a linear-bias 2-halo term;
+// the cgl covariance uses the cosmolike_core C_cgl_tomo_nointerp, check_cluster_lensing (like_fourier.c,
+// ./like_fourier <scenario> validate_clusters) compares both per (richness bin, zc, zs, ell)
+
+typedef struct {
+  int Nbin, Nrich, Nl;
+  double *Pcm; //[Nbin][Nrich][CLUSTER_NZ][Nl], cosmolike units
+  double *nz; //normalized cluster redshift distribution x dz, [Nbin][Nrich][CLUSTER_NZ]
+  double *fK; //f_K at the z nodes, [Nbin][CLUSTER_NZ]
+}clusterlensingtable;
+
+clusterlensingtable cluster_lensing = {0, 0, 0, NULL, NULL, NULL};
+
+void cluster_lensing_setup(int Nl, double *ell_Cluster);
+void C_cgl_tomo_ell(int Nl, int nz, int nN, int zs, double *Cl);
+
+void cluster_lensing_alloc(int Nl)
+{
+  free(cluster_lensing.Pcm);
+  free(cluster_lensing.nz);
+  free(cluster_lensing.fK);
+  cluster_lensing.Nbin=tomo.cluster_Nbin;
+  cluster_lensing.Nrich=Cluster.N200_Nbin;
+  cluster_lensing.Nl=Nl;
+  cluster_lensing.Pcm=malloc(tomo.cluster_Nbin*Cluster.N200_Nbin*CLUSTER_NZ*Nl*sizeof(double));
+  cluster_lensing.nz=malloc(tomo.cluster_Nbin*Cluster.N200_Nbin*CLUSTER_NZ*sizeof(double));
+  cluster_lensing.fK=malloc(tomo.cluster_Nbin*CLUSTER_NZ*sizeof(double));
+  if (cluster_lensing.fK==NULL){
+    printf("cluster_lensing_alloc: allocation failed\nEXIT\n");
+    exit(1);
+  }
+}
+
+void cluster_lensing_setup(int Nl, double *ell_Cluster)
+{
+  int nz,nN,iz,iM,l,Nrich;
+  double z,dz,a,fK,k,M,c,rho_m,Plin,norm,*mf,*sel,*P,*b,*u,*N;
+
+  update_cluster_counts();
+  if (Nl!=cluster_lensing.Nl || cluster_lensing.Nbin!=tomo.cluster_Nbin || cluster_lensing.Nrich!=Cluster.N200_Nbin || cluster_lensing.Pcm==NULL) cluster_lensing_alloc(Nl);
+  Nrich=Cluster.N200_Nbin;
+  rho_m=cosmology.rho_crit*cosmology.Omega_m;
+  b=malloc(CLUSTER_NM*sizeof(double));
+  u=malloc(Nl*CLUSTER_NM*sizeof(double));
+  N=calloc(Nrich,sizeof(double));
+  for (nz=0;nz<tomo.cluster_Nbin; nz++){
+    for (nN=0;nN<Nrich; nN++) N[nN]=0.;
+    for (iz=0;iz<CLUSTER_NZ; iz++){
+      z=cluster_counts_z(nz,iz,&dz);
+      a=1./(1.+z);
+      fK=f_K(chi(a));
+      cluster_lensing.fK[nz*CLUSTER_NZ+iz]=fK;
+      // halo bias and M/rho_m x NFW profile at the Limber k of every ell, shared by all richness bins
+      for (iM=0;iM<CLUSTER_NM; iM++){
+        M=exp(cluster_counts_lnM(iM));
+        c=conc(M,a);
+        b[iM]=B1(M,a);
+        for (l=0;l<Nl; l++) u[l*CLUSTER_NM+iM]=M/rho_m*u_nfw_c(c,(ell_Cluster[l]+0.5)/fK,M,a);
+      }
+      mf=cluster_counts.mf+(nz*CLUSTER_NZ+iz)*CLUSTER_NM;
+      for (nN=0;nN<Nrich; nN++){
+        sel=cluster_counts.sel+((nz*CLUSTER_NZ+iz)*Nrich+nN)*CLUSTER_NM;
+        P=cluster_lensing.Pcm+((nz*Nrich+nN)*CLUSTER_NZ+iz)*Nl;
+        norm=0.;
+        for (iM=0;iM<CLUSTER_NM; iM++) norm+=mf[iM]*sel[iM];
+        cluster_lensing.nz[(nz*Nrich+nN)*CLUSTER_NZ+iz]=norm;
+        N[nN]+=norm;
+        for (l=0;l<Nl; l++){
+          k=(ell_Cluster[l]+0.5)/fK;
+          Plin=p_lin(k,a);
+          P[l]=0.;
+          for (iM=0;iM<CLUSTER_NM; iM++) P[l]+=mf[iM]*sel[iM]*(u[l*CLUSTER_NM+iM]+b[iM]*Plin);
+          P[l]=(norm > 0. ? P[l]/norm : 0.);
+        }
+      }
+    }
+    for (nN=0;nN<Nrich; nN++){
+      for (iz=0;iz<CLUSTER_NZ; iz++){
+        if (N[nN] > 0.) cluster_lensing.nz[(nz*Nrich+nN)*CLUSTER_NZ+iz]/=N[nN];
+      }
+    }
+  }
+  free(b); free(u); free(N);
+}
+
+// C_cgl for all ell_Cluster of (cluster z bin nz, richness bin nN, source bin zs), without shear calibration
+void C_cgl_tomo_ell(int Nl, int nz, int nN, int zs, double *Cl)
+{
+  int iz,l;
+  double z,dz,a,fK,W,*P,*n;
+  n=cluster_lensing.nz+(nz*cluster_lensing.Nrich+nN)*CLUSTER_NZ;
+  for (l=0;l<Nl; l++) Cl[l]=0.;
+  for (iz=0;iz<CLUSTER_NZ; iz++){
+    z=cluster_counts_z(nz,iz,&dz);
+    a=1./(1.+z);
+    fK=cluster_lensing.fK[nz*CLUSTER_NZ+iz];
+    W=n[iz]*W_kappa(a,fK,(double)zs)/(fK*fK);
+    P=cluster_lensing.Pcm+((nz*cluster_lensing.Nrich+nN)*CLUSTER_NZ+iz)*Nl;
+    for (l=0;l<Nl; l++) Cl[l]+=W*P[l];
+  }
+}
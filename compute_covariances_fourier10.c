@@ -7,6 +7,12 @@
 #include <assert.h>
 #include <time.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <pthread.h>
 
 #include <fftw3.h>
 
@@ -40,7 +46,16 @@
 #include "../cosmolike_core/theory/covariances_3D.c"
 #include "../cosmolike_core/theory/covariances_fourier.c"
 #include "../cosmolike_core/theory/covariances_cluster.c"
+#include "tomography.c"
+#include "priors.c"
+#include "limber.c"
+#include "cluster_counts.c"
+#include "cov_ng_table.c"
+#include "cov_g_table.c"
+#include "config.c"
+#include "covio.c"
 #include "init_SRD.c"
+#include "datav_cache.c"
 
 void run_cov_N_N (char *OUTFILE, char *PATH, int nzc1, int nzc2,int start);
 void run_cov_cgl_N (char *OUTFILE, char *PATH, double *ell_Cluster, double *dell_Cluster,int N1, int nzc2, int start);
@@ -60,6 +75,28 @@ void run_cov_clustering(char *OUTFILE, char *PATH, double *ell, double *dell, in
 void run_cov_ggl(char *OUTFILE, char *PATH, double *ell, double *dell, int n1, int n2,int start);
 void run_cov_shear_shear(char *OUTFILE, char *PATH, double *ell, double *dell, int n1, int n2,int start);
 
+// component output (config [output] cov_components = 1) for rescale_cov.py and cov_terms.py: one file <PATH>comp_<OUTFILE>_<start>
+// per block, rows "i j ell1 ell2 z1 z2 z3 z4 c_g c_ng" followed by the G_TABLE_NCOMP noise-order components of c_g (cov_g_table.c)
+// and the connected NG and SSC parts of c_ng (cov_ng_table.c); convert_cov_components turns the archive into a container
+// the cluster blocks (clusterN, clusterWL) are not split and write no component rows
+FILE *open_cov_components(char *PATH, char *OUTFILE, int start)
+{
+  char filename[400];
+  if (!config.cov_components) return NULL;
+  sprintf(filename,"%scomp_%s_%d",PATH,OUTFILE,start);
+  return fopen(filename,"w");
+}
+
+void write_cov_components(FILE *F, int i, int j, double ell1, double ell2, int z1, int z2, int z3, int z4, double c_g, double c_ng, double *comp)
+{
+  int k;
+  if (F==NULL) return;
+  fprintf(F,"%d %d %e %e %d %d %d %d %e %e",i,j,ell1,ell2,z1,z2,z3,z4,c_g,c_ng);
+  for (k=0;k<G_TABLE_NCOMP; k++) fprintf(F," %e",(c_g != 0. ? comp[k] : 0.));
+  for (k=G_TABLE_NCOMP;k<G_TABLE_NCOMP+NG_TABLE_NCOMP; k++) fprintf(F," %e",(c_ng != 0. ? comp[k] : 0.));
+  fprintf(F,"\n");
+}
+
 
 void run_cov_N_N (char *OUTFILE, char *PATH, int nzc1, int nzc2,int start)
 {
@@ -71,10 +108,8 @@ void run_cov_N_N (char *OUTFILE, char *PATH, int nzc1, int nzc2,int start)
   F1 =fopen(filename,"w");
   for (nN1 = 0; nN1 < Cluster.N200_Nbin; nN1 ++){
     for (nN2 = 0; nN2 < Cluster.N200_Nbin; nN2 ++){
-      i = like.Ncl*(tomo.shear_Npowerspectra+tomo.ggl_Npowerspectra+tomo.clustering_Npowerspectra);
-      i += Cluster.N200_Nbin*nzc1+nN1;
-      j = like.Ncl*(tomo.shear_Npowerspectra+tomo.ggl_Npowerspectra+tomo.clustering_Npowerspectra);
-      j += Cluster.N200_Nbin*nzc2+nN2;
+      i = index_clusterN(nzc1,nN1);
+      j = index_clusterN(nzc2,nN2);
 
       cov =cov_N_N(nzc1,nN1, nzc2, nN2);
       fprintf(F1,"%d %d %e %e %d %d %d %d  %e %e\n",i,j,0.0,0.0, nzc1, nN1, nzc2, nN2,cov,0.0);
@@ -96,10 +131,8 @@ void run_cov_cgl_N (char *OUTFILE, char *PATH, double *ell_Cluster, double *dell
   for (nN1 = 0; nN1 < Cluster.N200_Nbin; nN1 ++){
     for( nl1 = 0; nl1 < Cluster.lbin; nl1 ++){
      for (nN2 = 0; nN2 < Cluster.N200_Nbin; nN2 ++){
-       i = like.Ncl*(tomo.shear_Npowerspectra+tomo.ggl_Npowerspectra+tomo.clustering_Npowerspectra)+Cluster.N200_Nbin*tomo.cluster_Nbin;
-       i += (N1*Cluster.N200_Nbin+nN1)*Cluster.lbin +nl1;
-       j = like.Ncl*(tomo.shear_Npowerspectra+tomo.ggl_Npowerspectra+tomo.clustering_Npowerspectra);
-       j += Cluster.N200_Nbin*nzc2+nN2;
+       i = index_cgl(N1,nN1,nl1);
+       j = index_clusterN(nzc2,nN2);
 
        cov =cov_cgl_N(ell_Cluster[nl1],nzc1,nN1, nzs1, nzc2, nN2);
        fprintf(F1,"%d %d %e %e %d %d %d %d  %e %e\n",i,j, ell_Cluster[nl1], 0., nzc1, nzs1, nzc2, nN2,cov,0.);
@@ -125,10 +158,8 @@ void run_cov_cgl_cgl (char *OUTFILE, char *PATH, double *ell_Cluster, double *de
     for( nl1 = 0; nl1 < Cluster.lbin; nl1 ++){
       for (nN2 = 0; nN2 < Cluster.N200_Nbin; nN2 ++){
         for( nl2 = 0; nl2 < Cluster.lbin; nl2 ++){
-          i = like.Ncl*(tomo.shear_Npowerspectra+tomo.ggl_Npowerspectra+tomo.clustering_Npowerspectra)+Cluster.N200_Nbin*tomo.cluster_Nbin;
-          i += (N1*Cluster.N200_Nbin+nN1)*Cluster.lbin +nl1;
-          j = like.Ncl*(tomo.shear_Npowerspectra+tomo.ggl_Npowerspectra+tomo.clustering_Npowerspectra)+Cluster.N200_Nbin*tomo.cluster_Nbin;
-          j += (N2*Cluster.N200_Nbin+nN2)*Cluster.lbin +nl2;
+          i = index_cgl(N1,nN1,nl1);
+          j = index_cgl(N2,nN2,nl2);
 
           c_g = 0;
           c_ng = cov_NG_cgl_cgl(ell_Cluster[nl1],ell_Cluster[nl2],nzc1,nN1, nzs1, nzc2, nN2,nzs2);
@@ -159,10 +190,8 @@ void run_cov_cgl_cgl_all (char *OUTFILE, char *PATH, double *ell_Cluster, double
         for( nl1 = 0; nl1 < Cluster.lbin; nl1 ++){
           for (nN2 = 0; nN2 < Cluster.N200_Nbin; nN2 ++){
             for( nl2 = 0; nl2 < Cluster.lbin; nl2 ++){
-              i = like.Ncl*(tomo.shear_Npowerspectra+tomo.ggl_Npowerspectra+tomo.clustering_Npowerspectra)+Cluster.N200_Nbin*tomo.cluster_Nbin;
-              i += (N1*Cluster.N200_Nbin+nN1)*Cluster.lbin +nl1;
-              j = like.Ncl*(tomo.shear_Npowerspectra+tomo.ggl_Npowerspectra+tomo.clustering_Npowerspectra)+Cluster.N200_Nbin*tomo.cluster_Nbin;
-              j += (N2*Cluster.N200_Nbin+nN2)*Cluster.lbin +nl2;         
+              i = index_cgl(N1,nN1,nl1);
+              j = index_cgl(N2,nN2,nl2);
               c_g = 0;
               c_ng = cov_NG_cgl_cgl(ell_Cluster[nl1],ell_Cluster[nl2],nzc1,nN1, nzs1, nzc2, nN2,nzs2);
               if (nl2 == nl1){c_g =cov_G_cgl_cgl(ell_Cluster[nl1],dell_Cluster[nl1],nzc1,nN1, nzs1, nzc2, nN2,nzs2);}
@@ -189,9 +218,8 @@ void run_cov_shear_N (char *OUTFILE, char *PATH, double *ell, double *dell, int
   for( nl1 = 0; nl1 < like.Ncl; nl1 ++){
     for (nN2 = 0; nN2 < Cluster.N200_Nbin; nN2 ++){
       cov = 0.;
-      i = like.Ncl*N1+nl1;
-      j = like.Ncl*(tomo.shear_Npowerspectra+tomo.ggl_Npowerspectra+tomo.clustering_Npowerspectra);
-      j += Cluster.N200_Nbin*nzc2+nN2;
+      i = index_shear(N1,nl1);
+      j = index_clusterN(nzc2,nN2);
 
       if (ell[nl1] < like.lmax_shear){cov =cov_shear_N(ell[nl1],nz1,nz2, nzc2, nN2);}
       fprintf(F1,"%d %d %e %e %d %d %d %d  %e %e\n",i,j, ell[nl1], 0., nz1, nz2, nzc2, nN2,cov,0.);
@@ -215,9 +243,8 @@ void run_cov_shear_cgl (char *OUTFILE, char *PATH, double *ell, double *dell, do
   for(nl1 = 0; nl1 < like.Ncl; nl1 ++){
     for (nN2 = 0; nN2 < Cluster.N200_Nbin; nN2 ++){
       for( nl2 = 0; nl2 < Cluster.lbin; nl2 ++){
-        i = like.Ncl*N1+nl1;
-        j = like.Ncl*(tomo.shear_Npowerspectra+tomo.ggl_Npowerspectra+tomo.clustering_Npowerspectra)+Cluster.N200_Nbin*tomo.cluster_Nbin;
-        j += (N2*Cluster.N200_Nbin+nN2)*Cluster.lbin +nl2;          
+        i = index_shear(N1,nl1);
+        j = index_cgl(N2,nN2,nl2);
         c_g = 0.;
         c_ng = 0.;
         if (ell[nl1] < like.lmax_shear){
@@ -245,11 +272,10 @@ void run_cov_ggl_N (char *OUTFILE, char *PATH, double *ell, double *dell, int N1
   zs = ZS(N1);
   for( nl1 = 0; nl1 < like.Ncl; nl1 ++){
     for (nN2 = 0; nN2 < Cluster.N200_Nbin; nN2 ++){
-      i = like.Ncl*(tomo.shear_Npowerspectra+N1)+nl1;
-      j = like.Ncl*(tomo.shear_Npowerspectra+tomo.ggl_Npowerspectra+tomo.clustering_Npowerspectra);
-      j += Cluster.N200_Nbin*nzc2+nN2;
+      i = index_ggl(N1,nl1);
+      j = index_clusterN(nzc2,nN2);
       cov = 0.;
-      weight = test_kmax(ell[nl1],zl);
+      weight = kmax_table(nl1,zl);
       if (weight){
         cov =cov_ggl_N(ell[nl1],zl,zs, nzc2, nN2);
       }
@@ -274,12 +300,11 @@ void run_cov_ggl_cgl (char *OUTFILE, char *PATH, double *ell, double *dell, doub
   for(nl1 = 0; nl1 < like.Ncl; nl1 ++){
     for (nN2 = 0; nN2 < Cluster.N200_Nbin; nN2 ++){
       for( nl2 = 0; nl2 < Cluster.lbin; nl2 ++){
-        i = like.Ncl*(tomo.shear_Npowerspectra+N1)+nl1;
-        j = like.Ncl*(tomo.shear_Npowerspectra+tomo.ggl_Npowerspectra+tomo.clustering_Npowerspectra)+Cluster.N200_Nbin*tomo.cluster_Nbin;
-        j += (N2*Cluster.N200_Nbin+nN2)*Cluster.lbin +nl2;
+        i = index_ggl(N1,nl1);
+        j = index_cgl(N2,nN2,nl2);
 
         c_g = 0; c_ng = 0.;
-        weight = test_kmax(ell[nl1],zl);
+        weight = kmax_table(nl1,zl);
         if (weight){
           c_ng = cov_NG_ggl_cgl(ell[nl1],ell_Cluster[nl2],zl,zs, nzc2, nN2,nzs3);
           if (fabs(ell[nl1]/ell_Cluster[nl2] -1.) < 0.1){c_g =cov_G_ggl_cgl(ell[nl1],dell_Cluster[nl2],zl,zs, nzc2, nN2,nzs3);}
@@ -301,11 +326,10 @@ void run_cov_cl_N (char *OUTFILE, char *PATH, double *ell, double *dell,int N1,
   F1 =fopen(filename,"w");
   for( nl1 = 0; nl1 < like.Ncl; nl1 ++){
     for (nN2 = 0; nN2 < Cluster.N200_Nbin; nN2 ++){
-      i = like.Ncl*(tomo.shear_Npowerspectra+tomo.ggl_Npowerspectra+N1)+nl1;
-      j = like.Ncl*(tomo.shear_Npowerspectra+tomo.ggl_Npowerspectra+tomo.clustering_Npowerspectra);
-      j += Cluster.N200_Nbin*nzc2+nN2;
+      i = index_clustering(N1,nl1);
+      j = index_clusterN(nzc2,nN2);
       cov = 0.;
-      weight = test_kmax(ell[nl1],N1);
+      weight = kmax_table(nl1,N1);
       if (weight){
         cov =cov_cl_N(ell[nl1],N1,N1,nzc2,nN2);
       }
@@ -328,12 +352,11 @@ void run_cov_cl_cgl (char *OUTFILE, char *PATH, double *ell, double *dell, doubl
   for(nl1 = 0; nl1 < like.Ncl; nl1 ++){
     for (nN2 = 0; nN2 < Cluster.N200_Nbin; nN2 ++){
       for( nl2 = 0; nl2 < Cluster.lbin; nl2 ++){
-        i = like.Ncl*(tomo.shear_Npowerspectra+tomo.ggl_Npowerspectra+N1)+nl1;
-        j = like.Ncl*(tomo.shear_Npowerspectra+tomo.ggl_Npowerspectra+tomo.clustering_Npowerspectra)+Cluster.N200_Nbin*tomo.cluster_Nbin;
-        j += (N2*Cluster.N200_Nbin+nN2)*Cluster.lbin +nl2;
+        i = index_clustering(N1,nl1);
+        j = index_cgl(N2,nN2,nl2);
 
         c_g = 0; c_ng = 0.;
-        weight = test_kmax(ell[nl1],N1);
+        weight = kmax_table(nl1,N1);
         if (weight){
           c_ng = cov_NG_cl_cgl(ell[nl1],ell_Cluster[nl2],N1,N1, nzc2, nN2,nzs3);
           if (fabs(ell[nl1]/ell_Cluster[nl2] -1.) < 0.1){
@@ -351,11 +374,14 @@ void run_cov_cl_cgl (char *OUTFILE, char *PATH, double *ell, double *dell, doubl
 void run_cov_ggl_shear(char *OUTFILE, char *PATH, double *ell, double *dell, int n1, int n2,int start)
 {
   int zl,zs,z3,z4,nl1,nl2,weight;
-  double c_ng, c_g;
-  FILE *F1;
+  double c_ng, c_g, comp[G_TABLE_NCOMP+NG_TABLE_NCOMP];
+  FILE *F1, *F2;
   char filename[300];
   sprintf(filename,"%s%s_%d",PATH,OUTFILE,start);
   F1 =fopen(filename,"w"); 
+  if (!ng_table.ready) init_ng_table(like.Ncl,ell);
+  if (!g_table.ready) init_g_table(like.Ncl,ell);
+  F2 = open_cov_components(PATH,OUTFILE,start);
   zl = ZL(n1); zs = ZS(n1);
   printf("\nN_ggl = %d (%d, %d)\n", n1,zl,zs);
   z3 = Z1(n2); z4 = Z2(n2);
@@ -363,29 +389,35 @@ void run_cov_ggl_shear(char *OUTFILE, char *PATH, double *ell, double *dell, int
   for (nl1 = 0; nl1 < like.Ncl; nl1 ++){
     for (nl2 = 0; nl2 <like.Ncl; nl2 ++){
       c_ng = 0.; c_g = 0.;
-      weight = test_kmax(ell[nl1],zl);
+      memset(comp,0,sizeof(comp));
+      weight = kmax_table(nl1,zl);
       if (weight && ell[nl2] < like.lmax_shear){
-        if (test_zoverlap(zl,z3)*test_zoverlap(zl,z4)){
-          c_ng = cov_NG_gl_shear_tomo(ell[nl1],ell[nl2],zl,zs,z3,z4);
+        if (overlap.zoverlap[zl][z3] && overlap.zoverlap[zl][z4]){
+          c_ng = cov_NG_gl_shear_table(nl1,nl2,zl,zs,z3,z4,comp+G_TABLE_NCOMP);
         }
         if (nl1 == nl2){
-          c_g =  cov_G_gl_shear_tomo(ell[nl1],dell[nl1],zl,zs,z3,z4);
+          c_g =  cov_G_gl_shear_table(nl1,dell[nl1],zl,zs,z3,z4,comp);
         }
       }
-      fprintf(F1, "%d %d %e %e %d %d %d %d  %e %e\n", like.Ncl*(tomo.shear_Npowerspectra+n1)+nl1,like.Ncl*(n2)+nl2, ell[nl1],ell[nl2],zl,zs,z3,z4,c_g,c_ng);
+      fprintf(F1, "%d %d %e %e %d %d %d %d  %e %e\n", index_ggl(n1,nl1),index_shear(n2,nl2), ell[nl1],ell[nl2],zl,zs,z3,z4,c_g,c_ng);
+      write_cov_components(F2,index_ggl(n1,nl1),index_shear(n2,nl2), ell[nl1],ell[nl2],zl,zs,z3,z4,c_g,c_ng,comp);
     }
   }
   fclose(F1);
+  if (F2) fclose(F2);
 }
 
 void run_cov_clustering_shear(char *OUTFILE, char *PATH, double *ell, double *dell, int n1, int n2,int start)
 {
   int z1,z2,z3,z4,nl1,nl2,weight;
-  double c_ng, c_g;
-  FILE *F1;
+  double c_ng, c_g, comp[G_TABLE_NCOMP+NG_TABLE_NCOMP];
+  FILE *F1, *F2;
   char filename[300];
   sprintf(filename,"%s%s_%d",PATH,OUTFILE,start);
   F1 =fopen(filename,"w");
+  if (!ng_table.ready) init_ng_table(like.Ncl,ell);
+  if (!g_table.ready) init_g_table(like.Ncl,ell);
+  F2 = open_cov_components(PATH,OUTFILE,start);
   z1 = n1; z2 = n1;
   printf("\nN_cl = %d \n", n1);
   z3 = Z1(n2); z4 = Z2(n2);
@@ -393,29 +425,35 @@ void run_cov_clustering_shear(char *OUTFILE, char *PATH, double *ell, double *de
   for (nl1 = 0; nl1 < like.Ncl; nl1 ++){
     for (nl2 = 0; nl2 <like.Ncl; nl2 ++){
       c_ng = 0.; c_g = 0.;
-      weight = test_kmax(ell[nl1],z1);
+      memset(comp,0,sizeof(comp));
+      weight = kmax_table(nl1,z1);
       if (weight && ell[nl2] < like.lmax_shear){
-        if (test_zoverlap(z1,z3)*test_zoverlap(z1,z4)){
-          c_ng = cov_NG_cl_shear_tomo(ell[nl1],ell[nl2],z1,z2,z3,z4);
+        if (overlap.zoverlap[z1][z3] && overlap.zoverlap[z1][z4]){
+          c_ng = cov_NG_cl_shear_table(nl1,nl2,z1,z2,z3,z4,comp+G_TABLE_NCOMP);
         }
         if (nl1 == nl2){
-          c_g =  cov_G_cl_shear_tomo(ell[nl1],dell[nl1],z1,z2,z3,z4);
+          c_g =  cov_G_cl_shear_table(nl1,dell[nl1],z1,z2,z3,z4,comp);
         }
       }
-      fprintf(F1,"%d %d %e %e %d %d %d %d  %e %e\n", like.Ncl*(tomo.shear_Npowerspectra+tomo.ggl_Npowerspectra+n1)+nl1,like.Ncl*(n2)+nl2, ell[nl1],ell[nl2],z1,z2,z3,z4,c_g,c_ng);
+      fprintf(F1,"%d %d %e %e %d %d %d %d  %e %e\n", index_clustering(n1,nl1),index_shear(n2,nl2), ell[nl1],ell[nl2],z1,z2,z3,z4,c_g,c_ng);
+      write_cov_components(F2,index_clustering(n1,nl1),index_shear(n2,nl2), ell[nl1],ell[nl2],z1,z2,z3,z4,c_g,c_ng,comp);
     }
   }
   fclose(F1);
+  if (F2) fclose(F2);
 }
 
 void run_cov_clustering_ggl(char *OUTFILE, char *PATH, double *ell, double *dell, int n1, int n2,int start)
 {
   int z1,z2,zl,zs,nl1,nl2,weight;
-  double c_ng, c_g;
-  FILE *F1;
+  double c_ng, c_g, comp[G_TABLE_NCOMP+NG_TABLE_NCOMP];
+  FILE *F1, *F2;
   char filename[300];
   sprintf(filename,"%s%s_%d",PATH,OUTFILE,start);
   F1 =fopen(filename,"w");
+  if (!ng_table.ready) init_ng_table(like.Ncl,ell);
+  if (!g_table.ready) init_g_table(like.Ncl,ell);
+  F2 = open_cov_components(PATH,OUTFILE,start);
   z1 = n1; z2 = n1;
   printf("\nN_cl_1 = %d \n", n1);
   zl = ZL(n2); zs = ZS(n2);
@@ -423,29 +461,35 @@ void run_cov_clustering_ggl(char *OUTFILE, char *PATH, double *ell, double *dell
   for (nl1 = 0; nl1 < like.Ncl; nl1 ++){
     for (nl2 = 0; nl2 < like.Ncl; nl2 ++){
       c_ng = 0.; c_g = 0.;
+      memset(comp,0,sizeof(comp));
       if (z1 == zl){
-        weight = test_kmax(ell[nl1],z1)*test_kmax(ell[nl2],zl);
+        weight = kmax_table(nl1,z1)*kmax_table(nl2,zl);
         if (weight){
-          c_ng = cov_NG_cl_gl_tomo(ell[nl1],ell[nl2],z1,z2,zl,zs);
+          c_ng = cov_NG_cl_gl_table(nl1,nl2,z1,z2,zl,zs,comp+G_TABLE_NCOMP);
           if (nl1 == nl2){
-            c_g =  cov_G_cl_gl_tomo(ell[nl1],dell[nl1],z1,z2,zl,zs);
+            c_g =  cov_G_cl_gl_table(nl1,dell[nl1],z1,z2,zl,zs,comp);
           }
         }
       }
-      fprintf(F1, "%d %d %e %e %d %d %d %d  %e %e\n", like.Ncl*(tomo.shear_Npowerspectra+tomo.ggl_Npowerspectra+n1)+nl1,like.Ncl*(tomo.shear_Npowerspectra+n2)+nl2, ell[nl1],ell[nl2],z1,z2,zl,zs,c_g,c_ng);
+      fprintf(F1, "%d %d %e %e %d %d %d %d  %e %e\n", index_clustering(n1,nl1),index_ggl(n2,nl2), ell[nl1],ell[nl2],z1,z2,zl,zs,c_g,c_ng);
+      write_cov_components(F2,index_clustering(n1,nl1),index_ggl(n2,nl2), ell[nl1],ell[nl2],z1,z2,zl,zs,c_g,c_ng,comp);
     }
   }
   fclose(F1);
+  if (F2) fclose(F2);
 }
 
 void run_cov_clustering(char *OUTFILE, char *PATH, double *ell, double *dell, int n1, int n2,int start)
 {
   int z1,z2,z3,z4,nl1,nl2,weight;
-  double c_ng, c_g;
-  FILE *F1;
+  double c_ng, c_g, comp[G_TABLE_NCOMP+NG_TABLE_NCOMP];
+  FILE *F1, *F2;
   char filename[300];
   sprintf(filename,"%s%s_%d",PATH,OUTFILE,start);
   F1 =fopen(filename,"w");
+  if (!ng_table.ready) init_ng_table(like.Ncl,ell);
+  if (!g_table.ready) init_g_table(like.Ncl,ell);
+  F2 = open_cov_components(PATH,OUTFILE,start);
   z1 = n1; z2 = n1;
   printf("\nN_cl_1 = %d \n", n1);
   z3 = n2; z4 = n2;
@@ -453,30 +497,36 @@ void run_cov_clustering(char *OUTFILE, char *PATH, double *ell, double *dell, in
   for (nl1 = 0; nl1 < like.Ncl; nl1 ++){
     for (nl2 = 0; nl2 < like.Ncl; nl2 ++){
       c_ng = 0.; c_g = 0.;
+      memset(comp,0,sizeof(comp));
       if (z1 == z3){
-        weight = test_kmax(ell[nl1],z1)*test_kmax(ell[nl2],z3);
+        weight = kmax_table(nl1,z1)*kmax_table(nl2,z3);
         if (weight) {
-          c_ng = cov_NG_cl_cl_tomo(ell[nl1],ell[nl2],z1,z2,z3,z4);
+          c_ng = cov_NG_cl_cl_table(nl1,nl2,z1,z2,z3,z4,comp+G_TABLE_NCOMP);
         }
         if (nl1 == nl2){
-          c_g =  cov_G_cl_cl_tomo(ell[nl1],dell[nl1],z1,z2,z3,z4);
+          c_g =  cov_G_cl_cl_table(nl1,dell[nl1],z1,z2,z3,z4,comp);
         }
       }
-      fprintf(F1, "%d %d %e %e %d %d %d %d %e %e\n", like.Ncl*(tomo.shear_Npowerspectra+tomo.ggl_Npowerspectra+n1)+nl1,like.Ncl*(tomo.shear_Npowerspectra+tomo.ggl_Npowerspectra + n2)+nl2, ell[nl1],ell[nl2],z1,z2,z3,z4,c_g,c_ng);
+      fprintf(F1, "%d %d %e %e %d %d %d %d %e %e\n", index_clustering(n1,nl1),index_clustering(n2,nl2), ell[nl1],ell[nl2],z1,z2,z3,z4,c_g,c_ng);
+      write_cov_components(F2,index_clustering(n1,nl1),index_clustering(n2,nl2), ell[nl1],ell[nl2],z1,z2,z3,z4,c_g,c_ng,comp);
     }
   }
   fclose(F1);
+  if (F2) fclose(F2);
 }
 
 void run_cov_ggl(char *OUTFILE, char *PATH, double *ell, double *dell, int n1, int n2,int start)
 {
   int zl1,zl2,zs1,zs2,nl1,nl2, weight;
-  double c_ng, c_g;
+  double c_ng, c_g, comp[G_TABLE_NCOMP+NG_TABLE_NCOMP];
   double fsky = survey.area/41253.0;
-  FILE *F1;
+  FILE *F1, *F2;
   char filename[300];
   sprintf(filename,"%s%s_%d",PATH,OUTFILE,start);
   F1 =fopen(filename,"w");
+  if (!ng_table.ready) init_ng_table(like.Ncl,ell);
+  if (!g_table.ready) init_g_table(like.Ncl,ell);
+  F2 = open_cov_components(PATH,OUTFILE,start);
 
   zl1 = ZL(n1); zs1 = ZS(n1);
   printf("\nN_tomo_1 = %d (%d, %d)\n", n1,zl1,zs1);
@@ -485,28 +535,31 @@ void run_cov_ggl(char *OUTFILE, char *PATH, double *ell, double *dell, int n1, i
   for (nl1 = 0; nl1 < like.Ncl; nl1 ++){
     for (nl2 = 0; nl2 < like.Ncl; nl2 ++){
       c_ng = 0.; c_g = 0.;
-      weight = test_kmax(ell[nl1],zl1)*test_kmax(ell[nl2],zl2);
+      memset(comp,0,sizeof(comp));
+      weight = kmax_table(nl1,zl1)*kmax_table(nl2,zl2);
       if (weight && zl1 == zl2) {
-        c_ng = cov_NG_gl_gl_tomo(ell[nl1],ell[nl2],zl1,zs1,zl2,zs2);
+        c_ng = cov_NG_gl_gl_table(nl1,nl2,zl1,zs1,zl2,zs2,comp+G_TABLE_NCOMP);
       }
       if (nl1 == nl2){
-        c_g =  cov_G_gl_gl_tomo(ell[nl1],dell[nl1],zl1,zs1,zl2,zs2);
+        c_g =  cov_G_gl_gl_table(nl1,dell[nl1],zl1,zs1,zl2,zs2,comp);
       }
       if (weight ==0 && n2 != n1){
         c_g = 0;
       }
-      fprintf(F1,"%d %d %e %e %d %d %d %d  %e %e\n", like.Ncl*(tomo.shear_Npowerspectra+n1)+nl1,like.Ncl*(tomo.shear_Npowerspectra+n2)+nl2, ell[nl1],ell[nl2],zl1,zs1,zl2,zs2,c_g,c_ng);   
+      fprintf(F1,"%d %d %e %e %d %d %d %d  %e %e\n", index_ggl(n1,nl1),index_ggl(n2,nl2), ell[nl1],ell[nl2],zl1,zs1,zl2,zs2,c_g,c_ng);
+      write_cov_components(F2,index_ggl(n1,nl1),index_ggl(n2,nl2), ell[nl1],ell[nl2],zl1,zs1,zl2,zs2,c_g,c_ng,comp);   
     }
   }
   fclose(F1);
+  if (F2) fclose(F2);
 }
 
 
 void run_cov_shear_shear(char *OUTFILE, char *PATH, double *ell, double *dell,int n1, int n2,int start)
 {
   int z1,z2,z3,z4,nl1,nl2,weight;
-  double c_ng, c_g;
-  FILE *F1;
+  double c_ng, c_g, comp[G_TABLE_NCOMP+NG_TABLE_NCOMP];
+  FILE *F1, *F2;
   char filename[300];
   z1 = Z1(n1); z2 = Z2(n1);
   printf("N_shear = %d\n", n1);
@@ -514,21 +567,27 @@ void run_cov_shear_shear(char *OUTFILE, char *PATH, double *ell, double *dell,in
   printf("N_shear = %d (%d, %d)\n",n2,z3,z4);
   sprintf(filename,"%s%s_%d",PATH,OUTFILE,start);
   F1 =fopen(filename,"w");
+  if (!ng_table.ready) init_ng_table(like.Ncl,ell);
+  if (!g_table.ready) init_g_table(like.Ncl,ell);
+  F2 = open_cov_components(PATH,OUTFILE,start);
   for (nl1 = 0; nl1 < like.Ncl; nl1 ++){
     for (nl2 = 0; nl2 < like.Ncl; nl2 ++){
       c_ng = 0.; c_g = 0.;
+      memset(comp,0,sizeof(comp));
       if (ell[nl1] < like.lmax_shear && ell[nl2] < like.lmax_shear){
-        c_ng = cov_NG_shear_shear_tomo(ell[nl1],ell[nl2],z1,z2,z3,z4);
+        c_ng = cov_NG_shear_shear_table(nl1,nl2,z1,z2,z3,z4,comp+G_TABLE_NCOMP);
       }
       if (nl1 == nl2){
-        c_g =  cov_G_shear_shear_tomo(ell[nl1],dell[nl1],z1,z2,z3,z4);
+        c_g =  cov_G_shear_shear_table(nl1,dell[nl1],z1,z2,z3,z4,comp);
         if (ell[nl1] > like.lmax_shear && n1!=n2){c_g = 0.;} 
       }         
-      fprintf(F1,"%d %d %e %e %d %d %d %d %e %e\n",like.Ncl*n1+nl1,like.Ncl*(n2)+nl2,ell[nl1],ell[nl2],z1,z2,z3,z4,c_g,c_ng);
-      //printf("%d %d %e %e %d %d %d %d %e %e\n", like.Ncl*n1+nl1,like.Ncl*(n2)+nl2, ell[nl1],ell[nl2],z1,z2,z3,z4,c_g,c_ng);
+      fprintf(F1,"%d %d %e %e %d %d %d %d %e %e\n",index_shear(n1,nl1),index_shear(n2,nl2),ell[nl1],ell[nl2],z1,z2,z3,z4,c_g,c_ng);
+      write_cov_components(F2,index_shear(n1,nl1),index_shear(n2,nl2),ell[nl1],ell[nl2],z1,z2,z3,z4,c_g,c_ng,comp);
+      //printf("%d %d %e %e %d %d %d %d %e %e\n", index_shear(n1,nl1),index_shear(n2,nl2), ell[nl1],ell[nl2],z1,z2,z3,z4,c_g,c_ng);
     }
   }
   fclose(F1);
+  if (F2) fclose(F2);
 }
 
 
@@ -556,21 +615,36 @@ int main(int argc, char** argv)
     //!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
    
   int hit=atoi(argv[1]);
-  Ntable.N_a=20;
+  // optional precision tier (fast, standard, high) or configuration file;
+  // default keeps the coarse a-grid of the covariance runs
+  int config_mode = (argc > 2 && strstr(argv[2],".ini") != NULL);
+  if (argc > 2 && !config_mode) init_precision(argv[2]);
+  else Ntable.N_a=20;
   k=1;
    
   for(t=9;t<10;t++){
    
     //RUN MODE setup
-    init_cosmo();
-    init_binning_fourier(20,20.0,15000.0,3000.0,21.0,5,Ntomo_lens[t]);
-    init_survey(survey_designation[t]);
-    sprintf(arg1,"zdistris/%s",source_zfile[t]);
-    sprintf(arg2,"zdistris/%s",lens_zfile[t]); 
-    init_galaxies(arg1,arg2,"none","none","source");
-    init_clusters();
-    init_IA("none", "GAMA"); 
-    init_probes("3x2pt_clusterN_clusterWL");
+    if (config_mode){
+      init_from_config(argv[2]);
+      // [precision] tier sets the other accuracy settings, the covariance keeps its coarse a-grid
+      Ntable.N_a=20;
+      if (validate_cov_config()){
+        printf("%s: not usable for the covariance\nEXIT\n",argv[2]);
+        exit(1);
+      }
+    }
+    else {
+      init_cosmo();
+      init_binning_fourier(20,20.0,15000.0,3000.0,21.0,5,Ntomo_lens[t]);
+      init_survey(survey_designation[t]);
+      sprintf(arg1,"zdistris/%s",source_zfile[t]);
+      sprintf(arg2,"zdistris/%s",lens_zfile[t]); 
+      init_galaxies(arg1,arg2,"none","none","source");
+      init_clusters();
+      init_IA("none", "GAMA"); 
+      init_probes("3x2pt_clusterN_clusterWL");
+    }
    
 
     //set l-bins for shear, ggl, clustering, clusterWL
@@ -595,14 +669,21 @@ int main(int argc, char** argv)
 
 
     printf("----------------------------------\n");  
-    survey.area=area_table[t];
-    survey.n_gal=nsource_table[t];
-    survey.n_lens=nlens_table[t];    
+    if (!config_mode){
+      survey.area=area_table[t];
+      survey.n_gal=nsource_table[t];
+      survey.n_lens=nlens_table[t];    
+    }
     
-    sprintf(survey.name,"%s_area%le_ng%le_nl%le",survey_designation[t],survey.area,survey.n_gal,survey.n_lens);
+    sprintf(survey.name,"%s_area%le_ng%le_nl%le",(config_mode ? config.survey : survey_designation[t]),survey.area,survey.n_gal,survey.n_lens);
     printf("area: %le n_source: %le n_lens: %le\n",survey.area,survey.n_gal,survey.n_lens);
 
-    sprintf(covparams.outdir,"/home/u17/timeifler/covparallel/"); 
+    sprintf(covparams.outdir,"%s",config.cov_outdir); 
+    // layout of the covariance indices i,j, written once by the first job
+    if (hit==1){
+      sprintf(filename,"%s%s_index_map",covparams.outdir,survey.name);
+      write_index_map(filename);
+    }
 
     printf("----------------------------------\n");  
     sprintf(OUTFILE,"%s_ssss_cov_Ncl%d_Ntomo%d",survey.name,like.Ncl,tomo.shear_Nbin);
@@ -0,0 +1,378 @@
+// survey configuration file (INI format) for the init chain, see config/ for examples
+//
+//   [section]
+//   key = value        # comment
+//
+// lists are comma or space separated; unknown sections/keys are an error.
+// read_config fills the config struct and validates it before anything is initialized;
+// init_from_config (init_SRD.c) then runs the init_* chain from it.
+// Defaults are the SRD survey settings of like_fourier.c.
+
+#define CONFIG_INT 0
+#define CONFIG_DOUBLE 1
+#define CONFIG_STRING 2
+#define CONFIG_LIST 3
+
+typedef struct {
+  //[survey]
+  char survey[200];
+  double area; //deg^2, <=0: survey default
+  double n_source; //gal/arcmin^2, <=0: survey default
+  double n_lens;
+  char source_zfile[500];
+  char lens_zfile[500];
+  char source_photoz[50];
+  char lens_photoz[50];
+  char galsample[50];
+  double source_sigma_z;
+  double lens_sigma_z;
+  //[binning]
+  int Ncl;
+  double lmin;
+  double lmax;
+  double lmax_shear;
+  double Rmin_bias;
+  //[tomography]
+  int source_Nbin;
+  int lens_Nbin;
+  char source_binning[50];
+  char lens_binning[50];
+  double lens_zmin;
+  double lens_zmax;
+  int Nsource_edges;
+  double source_edges[11];
+  int Nlens_edges;
+  double lens_edges[11];
+  //[probes]
+  char probes[200];
+  char IA_model[50];
+  char IA_lumfct[50];
+  //[priors]
+  char prior1[200];
+  char prior2[200];
+  char prior3[200];
+  char prior4[200];
+  //[precision]
+  char tier[20]; //empty: leave the executable's default
+  int bandpower; //ell sub-bins for bin-averaged spectra, 0: spectra at the bin centres
+  //[clusters]
+  int Ncluster_zedges; //0: survey default (Y1/Y3: 3 bins, Y6/Y10: 4 bins, 0.2 < z < 1.0)
+  double cluster_zedges[11];
+  int Nrichness_edges;
+  double richness_edges[11]; //N200 bin edges, integers
+  //[data]
+  char datav_file[500];
+  char invcov_file[500];
+  //[output]
+  char cov_outdir[500];
+  int cov_components; //1: also write noise-order covariance components for rescale_cov.py
+  char FILE[500];
+}configpara;
+
+configpara config = {
+  "LSST_Y10", -1., -1., -1.,
+  "", "", "gaussian", "gaussian", "SRD", 0.05, 0.03,
+  20, 20.0, 15000.0, 3000.0, 21.0,
+  5, 10, "equal_number", "equal_width", 0.2, 1.2, 0, {0.}, 0, {0.},
+  "3x2pt_clusterN_clusterWL", "NLA_HF", "GAMA",
+  "none", "none", "none", "none",
+  "", 0,
+  0, {0.}, 6, {20.,30.,45.,70.,120.,220.},
+  "", "",
+  "/home/u17/timeifler/covparallel/", 0,
+  ""
+};
+
+typedef struct {
+  char section[50];
+  char key[50];
+  int type;
+  void *value;
+  int size; //string length or maximal list length
+  int *count; //number of list entries read
+}configkey;
+
+configkey config_table[] = {
+  {"survey", "name", CONFIG_STRING, config.survey, 200, NULL},
+  {"survey", "area", CONFIG_DOUBLE, &config.area, 0, NULL},
+  {"survey", "n_source", CONFIG_DOUBLE, &config.n_source, 0, NULL},
+  {"survey", "n_lens", CONFIG_DOUBLE, &config.n_lens, 0, NULL},
+  {"survey", "source_zfile", CONFIG_STRING, config.source_zfile, 500, NULL},
+  {"survey", "lens_zfile", CONFIG_STRING, config.lens_zfile, 500, NULL},
+  {"survey", "source_photoz", CONFIG_STRING, config.source_photoz, 50, NULL},
+  {"survey", "lens_photoz", CONFIG_STRING, config.lens_photoz, 50, NULL},
+  {"survey", "galsample", CONFIG_STRING, config.galsample, 50, NULL},
+  {"survey", "source_sigma_z", CONFIG_DOUBLE, &config.source_sigma_z, 0, NULL},
+  {"survey", "lens_sigma_z", CONFIG_DOUBLE, &config.lens_sigma_z, 0, NULL},
+  {"binning", "Ncl", CONFIG_INT, &config.Ncl, 0, NULL},
+  {"binning", "lmin", CONFIG_DOUBLE, &config.lmin, 0, NULL},
+  {"binning", "lmax", CONFIG_DOUBLE, &config.lmax, 0, NULL},
+  {"binning", "lmax_shear", CONFIG_DOUBLE, &config.lmax_shear, 0, NULL},
+  {"binning", "Rmin_bias", CONFIG_DOUBLE, &config.Rmin_bias, 0, NULL},
+  {"tomography", "source_Nbin", CONFIG_INT, &config.source_Nbin, 0, NULL},
+  {"tomography", "lens_Nbin", CONFIG_INT, &config.lens_Nbin, 0, NULL},
+  {"tomography", "source_binning", CONFIG_STRING, config.source_binning, 50, NULL},
+  {"tomography", "lens_binning", CONFIG_STRING, config.lens_binning, 50, NULL},
+  {"tomography", "lens_zmin", CONFIG_DOUBLE, &config.lens_zmin, 0, NULL},
+  {"tomography", "lens_zmax", CONFIG_DOUBLE, &config.lens_zmax, 0, NULL},
+  {"tomography", "source_edges", CONFIG_LIST, config.source_edges, 11, &config.Nsource_edges},
+  {"tomography", "lens_edges", CONFIG_LIST, config.lens_edges, 11, &config.Nlens_edges},
+  {"probes", "probes", CONFIG_STRING, config.probes, 200, NULL},
+  {"probes", "IA_model", CONFIG_STRING, config.IA_model, 50, NULL},
+  {"probes", "IA_lumfct", CONFIG_STRING, config.IA_lumfct, 50, NULL},
+  {"priors", "prior1", CONFIG_STRING, config.prior1, 200, NULL},
+  {"priors", "prior2", CONFIG_STRING, config.prior2, 200, NULL},
+  {"priors", "prior3", CONFIG_STRING, config.prior3, 200, NULL},
+  {"priors", "prior4", CONFIG_STRING, config.prior4, 200, NULL},
+  {"precision", "tier", CONFIG_STRING, config.tier, 20, NULL},
+  {"precision", "bandpower", CONFIG_INT, &config.bandpower, 0, NULL},
+  {"clusters", "z_edges", CONFIG_LIST, config.cluster_zedges, 11, &config.Ncluster_zedges},
+  {"clusters", "richness_edges", CONFIG_LIST, config.richness_edges, 11, &config.Nrichness_edges},
+  {"data", "datav_file", CONFIG_STRING, config.datav_file, 500, NULL},
+  {"data", "invcov_file", CONFIG_STRING, config.invcov_file, 500, NULL},
+  {"output", "cov_outdir", CONFIG_STRING, config.cov_outdir, 500, NULL},
+  {"output", "cov_components", CONFIG_INT, &config.cov_components, 0, NULL},
+};
+
+void read_config(char *filename);
+int validate_config();
+int validate_cov_config();
+
+char *config_trim(char *s)
+{
+  char *e;
+  while (*s==' ' || *s=='\t') s++;
+  e=s+strlen(s);
+  while (e>s && (e[-1]==' ' || e[-1]=='\t' || e[-1]=='\n' || e[-1]=='\r')) e--;
+  *e='\0';
+  if (e-s >= 2 && ((s[0]=='"' && e[-1]=='"') || (s[0]=='\'' && e[-1]=='\''))){
+    e[-1]='\0';
+    s++;
+  }
+  return s;
+}
+
+int config_in_list(char *value, char **list, int n)
+{
+  int i;
+  for (i=0;i<n; i++){
+    if (strcmp(value,list[i])==0) return 1;
+  }
+  return 0;
+}
+
+void read_config(char *filename)
+{
+  int i,n,nline=0,nerr=0,Nkeys=sizeof(config_table)/sizeof(configkey);
+  char line[1000],section[50]="",*p,*key,*value,*tok;
+  FILE *F;
+
+  printf("\n");
+  printf("-------------------------------------------\n");
+  printf("Reading configuration %s\n",filename);
+  printf("-------------------------------------------\n");
+  F=fopen(filename,"r");
+  if (F==NULL){
+    printf("read_config: file %s not found.\nEXIT\n",filename);
+    exit(1);
+  }
+  sprintf(config.FILE,"%s",filename);
+  while (fgets(line,sizeof line,F)!=NULL){
+    nline++;
+    p=strchr(line,'#');
+    if (p) *p='\0';
+    p=strchr(line,';');
+    if (p) *p='\0';
+    p=config_trim(line);
+    if (*p=='\0') continue;
+    if (*p=='['){
+      value=strchr(p,']');
+      if (value==NULL){
+        printf("read_config: %s line %d: missing ]\n",filename,nline);
+        nerr++;
+        continue;
+      }
+      *value='\0';
+      snprintf(section,sizeof section,"%s",config_trim(p+1));
+      continue;
+    }
+    value=strchr(p,'=');
+    if (value==NULL){
+      printf("read_config: %s line %d: expected key = value\n",filename,nline);
+      nerr++;
+      continue;
+    }
+    *value='\0';
+    key=config_trim(p);
+    value=config_trim(value+1);
+    for (i=0;i<Nkeys; i++){
+      if (strcmp(config_table[i].section,section)==0 && strcmp(config_table[i].key,key)==0) break;
+    }
+    if (i==Nkeys){
+      printf("read_config: %s line %d: unknown key [%s] %s\n",filename,nline,section,key);
+      nerr++;
+      continue;
+    }
+    switch (config_table[i].type){
+      case CONFIG_INT:
+        *(int *) config_table[i].value=(int) strtol(value,&p,10);
+        if (*p!='\0' || p==value){
+          printf("read_config: %s line %d: %s is not an integer\n",filename,nline,key);
+          nerr++;
+        }
+        break;
+      case CONFIG_DOUBLE:
+        *(double *) config_table[i].value=strtod(value,&p);
+        if (*p!='\0' || p==value){
+          printf("read_config: %s line %d: %s is not a number\n",filename,nline,key);
+          nerr++;
+        }
+        break;
+      case CONFIG_STRING:
+        if ((int) strlen(value) >= config_table[i].size){
+          printf("read_config: %s line %d: %s too long\n",filename,nline,key);
+          nerr++;
+        }
+        else sprintf((char *) config_table[i].value,"%s",value);
+        break;
+      case CONFIG_LIST:
+        n=0;
+        for (tok=strtok(value,", \t"); tok!=NULL; tok=strtok(NULL,", \t")){
+          if (n==config_table[i].size){
+            printf("read_config: %s line %d: more than %d entries for %s\n",filename,nline,config_table[i].size,key);
+            nerr++;
+            break;
+          }
+          ((double *) config_table[i].value)[n++]=strtod(tok,&p);
+          if (*p!='\0'){
+            printf("read_config: %s line %d: %s is not a number\n",filename,nline,tok);
+            nerr++;
+          }
+        }
+        *config_table[i].count=n;
+        break;
+    }
+  }
+  fclose(F);
+  nerr+=validate_config();
+  if (nerr){
+    printf("read_config: %d errors in %s\nEXIT\n",nerr,filename);
+    exit(1);
+  }
+}
+
+// checks the complete configuration and reports every problem, returns the number of errors
+int validate_config()
+{
+  int i,nerr=0;
+  FILE *F;
+  char *surveys[4]={"LSST_Y1","LSST_Y3","LSST_Y6","LSST_Y10"};
+  char *photoz[4]={"none","voigt","voigt_out","gaussian"};
+  char *binning[3]={"equal_number","equal_width","user"};
+  char *probes[11]={"clusterN","clusterN_clusterWL","3x2pt_clusterN","shear_shear","pos_pos","ggl_cl","3x2pt","3x2pt_clusterN_clusterWL","LSSxCMB","gg_gk_gs","kk_ks_ss"};
+  char *IA[3]={"none","NLA_HF","lin"};
+  char *tiers[4]={"","fast","standard","high"};
+
+  if (!config_in_list(config.survey,surveys,4)){
+    printf("config: [survey] name %s not defined (LSST_Y1, LSST_Y3, LSST_Y6, LSST_Y10)\n",config.survey); nerr++;
+  }
+  if (strlen(config.source_zfile)==0 || (F=fopen(config.source_zfile,"r"))==NULL){
+    printf("config: [survey] source_zfile '%s' not readable\n",config.source_zfile); nerr++;
+  }
+  else fclose(F);
+  if (strlen(config.lens_zfile)==0 || (F=fopen(config.lens_zfile,"r"))==NULL){
+    printf("config: [survey] lens_zfile '%s' not readable\n",config.lens_zfile); nerr++;
+  }
+  else fclose(F);
+  if (!config_in_list(config.source_photoz,photoz,4)){
+    printf("config: [survey] source_photoz %s not defined\n",config.source_photoz); nerr++;
+  }
+  if (!config_in_list(config.lens_photoz,photoz,4)){
+    printf("config: [survey] lens_photoz %s not defined\n",config.lens_photoz); nerr++;
+  }
+  if (config.source_sigma_z <= 0. || config.lens_sigma_z <= 0.){
+    printf("config: [survey] photo-z scatter must be positive\n"); nerr++;
+  }
+  if (config.Ncl < 1 || config.lmin <= 0. || config.lmax <= config.lmin || config.lmax_shear > config.lmax || config.lmax_shear < config.lmin){
+    printf("config: [binning] need Ncl >= 1 and 0 < lmin <= lmax_shear <= lmax\n"); nerr++;
+  }
+  if (config.source_Nbin < 1 || config.source_Nbin > 10 || config.lens_Nbin < 1 || config.lens_Nbin > 10){
+    printf("config: [tomography] source_Nbin and lens_Nbin must be in 1..10\n"); nerr++;
+  }
+  if (!config_in_list(config.source_binning,binning,3) || !config_in_list(config.lens_binning,binning,3)){
+    printf("config: [tomography] binning must be equal_number, equal_width or user\n"); nerr++;
+  }
+  if (strcmp(config.source_binning,"user")==0 && config.Nsource_edges != config.source_Nbin+1){
+    printf("config: [tomography] source_edges needs source_Nbin+1 = %d entries\n",config.source_Nbin+1); nerr++;
+  }
+  if (strcmp(config.lens_binning,"user")==0 && config.Nlens_edges != config.lens_Nbin+1){
+    printf("config: [tomography] lens_edges needs lens_Nbin+1 = %d entries\n",config.lens_Nbin+1); nerr++;
+  }
+  if (config.lens_zmax <= config.lens_zmin){
+    printf("config: [tomography] lens_zmax <= lens_zmin\n"); nerr++;
+  }
+  if (!config_in_list(config.probes,probes,11)){
+    printf("config: [probes] probes %s not defined\n",config.probes); nerr++;
+  }
+  if (!config_in_list(config.IA_model,IA,3)){
+    printf("config: [probes] IA_model %s not defined (none, NLA_HF, lin)\n",config.IA_model); nerr++;
+  }
+  if (!prior_combination_exists(config.prior4)){
+    printf("config: [priors] prior4 %s not defined in %s/combinations.txt\n",config.prior4,PRIOR_DIR); nerr++;
+  }
+  if (!config_in_list(config.tier,tiers,4)){
+    printf("config: [precision] tier %s not defined (fast, standard, high)\n",config.tier); nerr++;
+  }
+  if (config.bandpower < 0){
+    printf("config: [precision] bandpower %d, need >= 0\n",config.bandpower); nerr++;
+  }
+  if (config.cov_components != 0 && config.cov_components != 1){
+    printf("config: [output] cov_components %d, need 0 or 1\n",config.cov_components); nerr++;
+  }
+  if (config.Ncluster_zedges == 1 || config.Ncluster_zedges > 11){
+    printf("config: [clusters] z_edges needs 2..11 entries\n"); nerr++;
+  }
+  for (i=1;i<config.Ncluster_zedges; i++){
+    if (config.cluster_zedges[i] <= config.cluster_zedges[i-1]){
+      printf("config: [clusters] z_edges must be increasing\n"); nerr++;
+      break;
+    }
+  }
+  if (config.Nrichness_edges < 2){
+    printf("config: [clusters] richness_edges needs at least 2 entries\n"); nerr++;
+  }
+  for (i=0;i<config.Nrichness_edges; i++){
+    if (config.richness_edges[i] != floor(config.richness_edges[i]) || (i > 0 && config.richness_edges[i] <= config.richness_edges[i-1])){
+      printf("config: [clusters] richness_edges must be increasing integers\n"); nerr++;
+      break;
+    }
+  }
+  if ((strlen(config.datav_file)==0) != (strlen(config.invcov_file)==0)){
+    printf("config: [data] datav_file and invcov_file must be given together\n"); nerr++;
+  }
+  return nerr;
+}
+
+// checks the settings compute_covariances_fourier takes from the configuration, returns the number of errors
+// the covariance programs write every block of 3x2pt_clusterN_clusterWL, so the index map needs these probes
+int validate_cov_config()
+{
+  int nerr=0;
+  if (strcmp(config.probes,"3x2pt_clusterN_clusterWL")!=0){
+    printf("config: [probes] probes %s, the covariance needs 3x2pt_clusterN_clusterWL\n",config.probes); nerr++;
+  }
+  if ((config.area != -1. && config.area <= 0.) || (config.n_source != -1. && config.n_source <= 0.) || (config.n_lens != -1. && config.n_lens <= 0.)){
+    printf("config: [survey] area, n_source and n_lens must be positive (or unset for the survey defaults)\n"); nerr++;
+  }
+  if (strlen(config.cov_outdir)==0 || config.cov_outdir[strlen(config.cov_outdir)-1]!='/'){
+    printf("config: [output] cov_outdir '%s' must be a directory path ending in /\n",config.cov_outdir); nerr++;
+  }
+  else if (access(config.cov_outdir,W_OK)!=0){
+    printf("config: [output] cov_outdir %s is not a writable directory\n",config.cov_outdir); nerr++;
+  }
+  return nerr;
+}
+#undef CONFIG_INT
+#undef CONFIG_DOUBLE
+#undef CONFIG_STRING
+#undef CONFIG_LIST
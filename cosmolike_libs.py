@@ -20,6 +20,18 @@ initcosmo.argtypes=[]
 initfisherprecision=lib.init_fisher_precision
 initfisherprecision.argtypes=[]
 
+initfromconfig=lib.init_from_config
+initfromconfig.argtypes=[ctypes.c_char_p]
+
+initprecision=lib.init_precision
+initprecision.argtypes=[ctypes.c_char_p]
+
+initlimber=lib.init_limber
+initlimber.argtypes=[ctypes.c_int]
+
+initbandpower=lib.init_bandpower
+initbandpower.argtypes=[ctypes.c_int]
+
 initbins=lib.init_binning_fourier
 initbins.argtypes=[ctypes.c_int, ctypes.c_double, ctypes.c_double, ctypes.c_double, ctypes.c_double, ctypes.c_int, ctypes.c_int]
 
@@ -29,6 +41,18 @@ initsurvey.argtypes=[ctypes.c_char_p]
 initgalaxies=lib.init_galaxies
 initgalaxies.argtypes=[ctypes.c_char_p,ctypes.c_char_p,ctypes.c_char_p,ctypes.c_char_p,ctypes.c_char_p]
 
+initgalaxiesparametric=lib.init_galaxies_parametric
+initgalaxiesparametric.argtypes=[ctypes.c_double,ctypes.c_double,ctypes.c_double,ctypes.c_double,ctypes.c_double,ctypes.c_double,ctypes.c_char_p,ctypes.c_char_p,ctypes.c_char_p]
+
+inittomography=lib.init_tomography
+inittomography.argtypes=[ctypes.c_char_p,ctypes.c_char_p]
+
+settomoedges=lib.set_tomo_edges
+settomoedges.argtypes=[ctypes.c_char_p,ctypes.c_int,ctypes.POINTER(ctypes.c_double)]
+
+settomorange=lib.set_tomo_range
+settomorange.argtypes=[ctypes.c_char_p,ctypes.c_double,ctypes.c_double]
+
 initclusters=lib.init_clusters
 initclusters.argtypes=[]
 
@@ -44,6 +68,103 @@ initprobes.argtypes=[ctypes.c_char_p]
 initdatainv=lib.init_data_inv
 initdatainv.argtypes=[ctypes.c_char_p,ctypes.c_char_p]
 
+initdatacompression=lib.init_data_compression
+initdatacompression.argtypes=[ctypes.c_char_p]
+
+initdatavcache=lib.init_datav_cache
+initdatavcache.argtypes=[ctypes.c_double]
+
+cleardatavcache=lib.clear_datav_cache
+cleardatavcache.argtypes=[]
+
+getdatavcachehits=lib.get_datav_cache_hits
+getdatavcachehits.argtypes=[]
+getdatavcachehits.restype=ctypes.c_long
+
+getdatavcachemisses=lib.get_datav_cache_misses
+getdatavcachemisses.argtypes=[]
+getdatavcachemisses.restype=ctypes.c_long
+
+getNdata=lib.get_N_data
+getNdata.argtypes=[]
+getNdata.restype=ctypes.c_int
+
+getprobestart=lib.get_probe_start
+getprobestart.argtypes=[ctypes.c_int]
+getprobestart.restype=ctypes.c_int
+
+getprobeN=lib.get_probe_N
+getprobeN.argtypes=[ctypes.c_int]
+getprobeN.restype=ctypes.c_int
+
+writeindexmap=lib.write_index_map
+writeindexmap.argtypes=[ctypes.c_char_p]
+
+lib.get_index_map.argtypes=[ctypes.POINTER(ctypes.c_int)]*5+[ctypes.POINTER(double)]
+lib.get_index_map.restype=None
+
+probe_names=["shear","ggl","clustering","clusterN","clusterWL"]
+
+# data vector layout after init_probes: block offsets and per-element probe, z1, z2, nN, nl, ell
+def get_index_map():
+    ndata=getNdata()
+    m={}
+    for key in ["probe","z1","z2","nN","nl"]:
+        m[key]=np.zeros(ndata,dtype=np.intc)
+    m["ell"]=np.zeros(ndata)
+    lib.get_index_map(*([m[key].ctypes.data_as(ctypes.POINTER(ctypes.c_int)) for key in ["probe","z1","z2","nN","nl"]]+[m["ell"].ctypes.data_as(ctypes.POINTER(double))]))
+    m["blocks"]=dict([(probe_names[k],(getprobestart(k),getprobeN(k))) for k in range(5)])
+    return m
+
+lib.cov_text_ndata.argtypes=[ctypes.c_char_p]
+lib.cov_text_ndata.restype=ctypes.c_int
+lib.read_cov_text.argtypes=[ctypes.c_char_p,ctypes.c_int,ctypes.c_int,ctypes.c_int,ctypes.c_int,ctypes.POINTER(double),ctypes.POINTER(double)]
+lib.read_cov_text.restype=None
+lib.is_cov_container.argtypes=[ctypes.c_char_p]
+lib.is_cov_container.restype=ctypes.c_int
+lib.cov_container_ndata.argtypes=[ctypes.c_char_p]
+lib.cov_container_ndata.restype=ctypes.c_int
+lib.cov_container_has.argtypes=[ctypes.c_char_p,ctypes.c_char_p]
+lib.cov_container_has.restype=ctypes.c_int
+lib.read_cov_container.argtypes=[ctypes.c_char_p,ctypes.c_char_p,ctypes.POINTER(double)]
+lib.read_cov_container.restype=ctypes.c_int
+
+convertcovarchive=lib.convert_cov_archive
+convertcovarchive.argtypes=[ctypes.c_char_p,ctypes.c_char_p,ctypes.c_int,ctypes.c_int,ctypes.c_int]
+convertcovcomponents=lib.convert_cov_components
+convertcovcomponents.argtypes=[ctypes.c_char_p,ctypes.c_char_p,ctypes.c_int,ctypes.c_int,ctypes.c_int]
+
+# dense symmetric matrix of one container array, packed arrays (lower triangle row by row) are unpacked
+def read_cov_array(filename, name, ndata):
+    M=np.zeros((ndata,ndata))
+    if lib.read_cov_container(filename,name,M.ctypes.data_as(ctypes.POINTER(double))):
+        P=M.ravel()[:ndata*(ndata+1)//2].copy()
+        M=np.zeros((ndata,ndata))
+        M[np.tril_indices(ndata)]=P
+        M=M+np.tril(M,-1).T
+    return M
+
+# dense covariance from a binary container or a text file (archive "i j ... c_g c_ng" or inverse "i j value");
+# returns (g, ng), ng is None for 3-column files and containers without an "ng" array.
+# symmetric=True mirrors (i,j) to (j,i), as needed for the concatenated covariance archives
+def read_cov(filename, ndata=0, symmetric=True, nthreads=0):
+    if lib.is_cov_container(filename):
+        ndata=lib.cov_container_ndata(filename)
+        g=read_cov_array(filename,b"g",ndata)
+        ng=None
+        if lib.cov_container_has(filename,b"ng"):
+            ng=read_cov_array(filename,b"ng",ndata)
+        return g,ng
+    if ndata<=0:
+        ndata=lib.cov_text_ndata(filename)
+    g=np.zeros((ndata,ndata))
+    ng=np.zeros((ndata,ndata))
+    lib.read_cov_text(filename,ndata,0,int(symmetric),nthreads,g.ctypes.data_as(ctypes.POINTER(double)),ng.ctypes.data_as(ctypes.POINTER(double)))
+    with open(filename) as f:
+        if len(f.readline().split())==3:
+            ng=None
+    return g,ng
+
 get_N_tomo_shear = lib.get_N_tomo_shear
 get_N_tomo_shear.argtypes = []
 get_N_tomo_shear.restype = ctypes.c_int
@@ -255,6 +376,11 @@ class InputNuisanceParams(IterableStruct):
         ("lf", double*6),
         ("m_lambda", double*6),
     ]
+    @classmethod
+    def fiducial(cls, survey="LSST_Y10"):
+        # nuisance fiducial of the survey year (LSST_Y1/Y3/Y6/Y10)
+        return getattr(cls, "fiducial_"+survey.replace("LSST_",""))()
+
     @classmethod
     def fiducial_Y10(cls):
         c = cls()
@@ -359,8 +485,9 @@ class InputNuisanceParams(IterableStruct):
 
 
 class LikelihoodFunctionWrapper(object):
-    def __init__(self, varied_parameters):
+    def __init__(self, varied_parameters, survey="LSST_Y10"):
         self.varied_parameters = varied_parameters
+        self.survey = survey
 
 
     def fill_varied(self, icp, inp, x):
@@ -379,9 +506,15 @@ class LikelihoodFunctionWrapper(object):
                             obj[j] = x[i]
                             i+=1
 
+    def parameter_vector(self, x):
+        icp = InputCosmologyParams.fiducial()
+        inp = InputNuisanceParams.fiducial(self.survey)
+        self.fill_varied(icp, inp, x)
+        return icp.convert_to_vector() + inp.convert_to_vector()
+
     def __call__(self, x):
         icp = InputCosmologyParams.fiducial()
-        inp = InputNuisanceParams.fiducial()
+        inp = InputNuisanceParams.fiducial(self.survey)
         self.fill_varied(icp, inp, x)
         #icp.print_struct()
         #inp.print_struct()
@@ -394,6 +527,48 @@ lib.log_like_wrapper.argtypes = [InputCosmologyParams, InputNuisanceParams]
 lib.log_like_wrapper.restype = double
 log_like_wrapper = lib.log_like_wrapper
 
+lib.log_like_batch.argtypes = [ctypes.c_int, ctypes.POINTER(double), ctypes.POINTER(double), ctypes.c_int]
+lib.log_like_batch.restype = None
+
+# data vector emulator (emulator.c), trained with emu_train.py
+datavbatch=lib.datav_batch
+datavbatch.argtypes=[ctypes.c_int, ctypes.POINTER(double), ctypes.POINTER(double), ctypes.c_int]
+datavbatch.restype=None
+
+trainemulator=lib.train_emulator
+trainemulator.argtypes=[ctypes.c_int, ctypes.POINTER(double), ctypes.POINTER(double), ctypes.POINTER(double), ctypes.POINTER(double), ctypes.c_int, ctypes.c_int, ctypes.c_char_p]
+trainemulator.restype=None
+
+initemulator=lib.init_emulator
+initemulator.argtypes=[ctypes.c_char_p, ctypes.c_int, ctypes.c_double]
+initemulator.restype=None
+
+# Taylor expansion of the data vector around the fiducial point (taylor.c), FM_taylor<survey> written by fisher.py
+inittaylor=lib.init_taylor
+inittaylor.argtypes=[ctypes.c_char_p, ctypes.c_int, ctypes.c_double]
+inittaylor.restype=None
+
+printtaylorstats=lib.print_taylor_stats
+printtaylorstats.argtypes=[]
+printtaylorstats.restype=None
+
+
+class ForkPool(object):
+    """emcee pool that evaluates all walkers of a step with log_like_batch,
+    i.e. in nproc forked copies of this process sharing the look-up tables."""
+    def __init__(self, nproc):
+        self.nproc = nproc
+
+    def map(self, func, walkers):
+        like = getattr(func, "f", func)
+        if not isinstance(like, LikelihoodFunctionWrapper):
+            return map(func, walkers)
+        par = np.array([like.parameter_vector(x) for x in walkers], dtype=np.float64)
+        result = np.zeros(len(walkers))
+        lib.log_like_batch(len(walkers), par.ctypes.data_as(ctypes.POINTER(double)),
+            result.ctypes.data_as(ctypes.POINTER(double)), self.nproc)
+        return list(result)
+
 
 def sample_cosmology_only_w0wa(MG = False):
     if MG:
@@ -542,12 +717,19 @@ def sample_cosmology_2pt_cluster_SRD(tomo_N_lens,MG = False):
 
 
 
-def sample_main(varied_parameters, iterations, nwalker, nthreads, filename, blind=False):
+# needs initdatainv(data file, inverse covariance) before the call: the chi^2 is the MOPED-compressed one after
+# initdatacompression, otherwise the full (pred-data) C^-1 (pred-data). emulator=<train_emulator file> and
+# taylor=<FM_taylor file> replace the exact model data vector in both cases.
+def sample_main(varied_parameters, iterations, nwalker, nthreads, filename, blind=False, emulator=None, emu_check_every=1000, emu_tolerance=0.1, taylor=None, taylor_order=1, taylor_radius=4., survey="LSST_Y10"):
     print varied_parameters
+    if emulator is not None:
+        initemulator(emulator, emu_check_every, emu_tolerance)
+    if taylor is not None:
+        inittaylor(taylor, taylor_order, taylor_radius)
 
-    likelihood = LikelihoodFunctionWrapper(varied_parameters)
+    likelihood = LikelihoodFunctionWrapper(varied_parameters, survey)
     starting_point = InputCosmologyParams.fiducial().convert_to_vector_filter(varied_parameters)
-    starting_point += InputNuisanceParams().fiducial().convert_to_vector_filter(varied_parameters)
+    starting_point += InputNuisanceParams.fiducial(survey).convert_to_vector_filter(varied_parameters)
 
     std = InputCosmologyParams.fiducial_sigma().convert_to_vector_filter(varied_parameters)
     std += InputNuisanceParams().fiducial_sigma().convert_to_vector_filter(varied_parameters)
@@ -558,7 +740,10 @@ def sample_main(varied_parameters, iterations, nwalker, nthreads, filename, blin
     print "ndim = ", ndim
     print "start = ", starting_point
     print "std = ", std
-    sampler = emcee.EnsembleSampler(nwalker, ndim, likelihood,threads=nthreads)
+    if nthreads > 1:
+        sampler = emcee.EnsembleSampler(nwalker, ndim, likelihood, pool=ForkPool(nthreads))
+    else:
+        sampler = emcee.EnsembleSampler(nwalker, ndim, likelihood)
     f = open(filename, 'w')
 
     #write header here
@@ -574,4 +759,6 @@ def sample_main(varied_parameters, iterations, nwalker, nthreads, filename, blin
                 row = blind_parameters(varied_parameters, row)
             f.write('%s\n' % ('  '.join([str(r) for r in row])))
     f.close()
+    if taylor is not None:
+        printtaylorstats()
 
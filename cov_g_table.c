@@ -0,0 +1,164 @@
+// Gaussian covariance of the shear, ggl and clustering spectra from one table of spectra
+// all shear, ggl and clustering spectra of all tomography pairs (incl. the cross pairs that only enter the covariance)
+// are computed once per job with the batched Limber integrals of limber.c, the shot and shape noise once per bin;
+// like cov_G_*_tomo the spectra include no intrinsic alignments and are evaluated at the ell bin centres
+// every cov_G element is then the usual ((C13+N13)(C24+N24)+(C14+N14)(C23+N23))/((2 ell+1) dell fsky) of table entries,
+// as in cov_G_*_tomo
+// shape noise sigma_e^2/(2 n_source), shot noise 1/n_lens, with the bin densities nsource(z), nlens(z) from survey.n_gal, survey.n_lens
+// elements can also be split by noise order (comp != NULL), each component scales as 1/fsky times a power of 1/n_gal, 1/n_lens:
+//   comp[0] signal x signal, [1] x shape noise, [2] x shot noise, [3] x shape noise^2, [4] x shot noise^2, [5] x shape x shot noise
+
+#define G_TABLE_NCOMP 6
+
+typedef struct {
+  int Ncl, Nsource, Nlens;
+  int ready;
+  double *ell; //[Ncl]
+  double *Csh; //C_shear, [Nsource][Nsource][Ncl]
+  double *Cgl; //C_gl, [Nlens][Nsource][Ncl]
+  double *Ccl; //C_cl, [Nlens][Nlens][Ncl]
+  double Nsh[10], Ncln[10]; //shape noise of the source bins, shot noise of the lens bins
+}gtable;
+
+gtable g_table = {0, 0, 0, 0, NULL, NULL, NULL, NULL, {0.}, {0.}};
+
+void init_g_table(int Ncl, double *ell);
+double cov_G_shear_shear_table(int nl, double dl, int z1, int z2, int z3, int z4, double *comp);
+double cov_G_gl_shear_table(int nl, double dl, int zl, int zs, int z3, int z4, double *comp);
+double cov_G_cl_shear_table(int nl, double dl, int z1, int z2, int z3, int z4, double *comp);
+double cov_G_cl_gl_table(int nl, double dl, int z1, int z2, int zl, int zs, double *comp);
+double cov_G_cl_cl_table(int nl, double dl, int z1, int z2, int z3, int z4, double *comp);
+double cov_G_gl_gl_table(int nl, double dl, int zl1, int zs1, int zl2, int zs2, double *comp);
+
+void g_table_alloc(int Ncl)
+{
+  free(g_table.ell); free(g_table.Csh); free(g_table.Cgl); free(g_table.Ccl);
+  g_table.Ncl=Ncl;
+  g_table.Nsource=tomo.shear_Nbin;
+  g_table.Nlens=tomo.clustering_Nbin;
+  g_table.ready=0;
+  g_table.ell=malloc(Ncl*sizeof(double));
+  g_table.Csh=malloc(tomo.shear_Nbin*tomo.shear_Nbin*Ncl*sizeof(double));
+  g_table.Cgl=malloc(tomo.clustering_Nbin*tomo.shear_Nbin*Ncl*sizeof(double));
+  g_table.Ccl=malloc(tomo.clustering_Nbin*tomo.clustering_Nbin*Ncl*sizeof(double));
+  if (g_table.Ccl==NULL){
+    printf("g_table_alloc: allocation failed\nEXIT\n");
+    exit(1);
+  }
+}
+
+void init_g_table(int Ncl, double *ell)
+{
+  int i,z1,z2,Ns=tomo.shear_Nbin,Nl=tomo.clustering_Nbin,IA=like.IA,Nsub=limber.Nsub;
+  double *C;
+
+  g_table_alloc(Ncl);
+  for (i=0;i<Ncl; i++) g_table.ell[i]=ell[i];
+  // spectra without IA at the bin centres, as C_shear_tomo_nointerp, C_gl_tomo_nointerp in cov_G_*_tomo
+  like.IA=0;
+  if (Nsub > 0) init_bandpower(0);
+  limber_setup(Ncl,ell);
+  for (z1=0;z1<Ns; z1++){
+    g_table.Nsh[z1]=pow(survey.sigma_e,2.0)/(2.0*nsource(z1)*survey.n_gal_conversion_factor);
+    for (z2=z1;z2<Ns; z2++){
+      C=g_table.Csh+(z1*Ns+z2)*Ncl;
+      if (limber.ready) limber_C_shear(z1,z2,C);
+      else for (i=0;i<Ncl; i++) C[i]=C_shear_tomo_nointerp(ell[i],z1,z2);
+      memcpy(g_table.Csh+(z2*Ns+z1)*Ncl,C,Ncl*sizeof(double));
+    }
+  }
+  for (z1=0;z1<Nl; z1++){
+    g_table.Ncln[z1]=1./(nlens(z1)*survey.n_gal_conversion_factor);
+    for (z2=0;z2<Ns; z2++){
+      C=g_table.Cgl+(z1*Ns+z2)*Ncl;
+      if (limber.ready) limber_C_gl(z1,z2,C);
+      else for (i=0;i<Ncl; i++) C[i]=C_gl_tomo_nointerp(ell[i],z1,z2);
+    }
+    for (z2=z1;z2<Nl; z2++){
+      C=g_table.Ccl+(z1*Nl+z2)*Ncl;
+      if (limber.ready) limber_C_cl(z1,z2,C);
+      else for (i=0;i<Ncl; i++) C[i]=C_cl_tomo_nointerp(ell[i],z1,z2);
+      memcpy(g_table.Ccl+(z2*Nl+z1)*Ncl,C,Ncl*sizeof(double));
+    }
+  }
+  like.IA=IA;
+  if (Nsub > 0) init_bandpower(Nsub);
+  limber.ready=0; // grid has no IA kernels, set up again for the data vector
+  g_table.ready=1;
+  printf("init_g_table: spectra of %d source and %d lens bins tabulated\n",Ns,Nl);
+}
+
+// spectrum, noise and noise type (0 none, 1 shape, 2 shot) of the field pair (f1,z1),(f2,z2), f: 0 source, 1 lens
+double g_table_pair(int nl, int f1, int z1, int f2, int z2, double *N, int *t)
+{
+  *N=0.; *t=0;
+  if (f1==0 && f2==0){
+    if (z1==z2){ *N=g_table.Nsh[z1]; *t=1; }
+    return g_table.Csh[(z1*g_table.Nsource+z2)*g_table.Ncl+nl];
+  }
+  if (f1==1 && f2==1){
+    if (z1==z2){ *N=g_table.Ncln[z1]; *t=2; }
+    return g_table.Ccl[(z1*g_table.Nlens+z2)*g_table.Ncl+nl];
+  }
+  if (f1==1) return g_table.Cgl[(z1*g_table.Nsource+z2)*g_table.Ncl+nl];
+  return g_table.Cgl[(z2*g_table.Nsource+z1)*g_table.Ncl+nl];
+}
+
+// adds (C_ac+N_ac)(C_bd+N_bd) to comp, split by noise order
+void g_table_term(int nl, int fa, int za, int fc, int zc, int fb, int zb, int fd, int zd, double *comp)
+{
+  int t1,t2;
+  double C1,C2,N1,N2;
+  C1=g_table_pair(nl,fa,za,fc,zc,&N1,&t1);
+  C2=g_table_pair(nl,fb,zb,fd,zd,&N2,&t2);
+  comp[0]+=C1*C2;
+  if (t1) comp[t1]+=N1*C2;
+  if (t2) comp[t2]+=C1*N2;
+  if (t1 && t2) comp[(t1==t2 ? t1+2 : 5)]+=N1*N2;
+}
+
+// covariance of the spectra (f1 z1, f2 z2) and (f3 z3, f4 z4): ((C13+N13)(C24+N24)+(C14+N14)(C23+N23))/((2 ell+1) dell fsky)
+double g_table_cov(int nl, double dl, int f1, int z1, int f2, int z2, int f3, int z3, int f4, int z4, double *comp)
+{
+  int k;
+  double c[G_TABLE_NCOMP]={0.},norm,res=0.;
+  g_table_term(nl,f1,z1,f3,z3,f2,z2,f4,z4,c);
+  g_table_term(nl,f1,z1,f4,z4,f2,z2,f3,z3,c);
+  norm=(2.*g_table.ell[nl]+1.)*dl*survey.area/41253.0;
+  for (k=0;k<G_TABLE_NCOMP; k++){
+    c[k]/=norm;
+    res+=c[k];
+    if (comp) comp[k]=c[k];
+  }
+  return res;
+}
+
+double cov_G_shear_shear_table(int nl, double dl, int z1, int z2, int z3, int z4, double *comp)
+{
+  return g_table_cov(nl,dl,0,z1,0,z2,0,z3,0,z4,comp);
+}
+
+double cov_G_gl_shear_table(int nl, double dl, int zl, int zs, int z3, int z4, double *comp)
+{
+  return g_table_cov(nl,dl,1,zl,0,zs,0,z3,0,z4,comp);
+}
+
+double cov_G_cl_shear_table(int nl, double dl, int z1, int z2, int z3, int z4, double *comp)
+{
+  return g_table_cov(nl,dl,1,z1,1,z2,0,z3,0,z4,comp);
+}
+
+double cov_G_cl_gl_table(int nl, double dl, int z1, int z2, int zl, int zs, double *comp)
+{
+  return g_table_cov(nl,dl,1,z1,1,z2,1,zl,0,zs,comp);
+}
+
+double cov_G_cl_cl_table(int nl, double dl, int z1, int z2, int z3, int z4, double *comp)
+{
+  return g_table_cov(nl,dl,1,z1,1,z2,1,z3,1,z4,comp);
+}
+
+double cov_G_gl_gl_table(int nl, double dl, int zl1, int zs1, int zl2, int zs2, double *comp)
+{
+  return g_table_cov(nl,dl,1,zl1,0,zs1,1,zl2,0,zs2,comp);
+}
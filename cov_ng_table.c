@@ -0,0 +1,287 @@
+// non-Gaussian covariance of the shear, ggl and clustering spectra from precomputed tables
+// the halo-model trispectrum tri_matter_cov(k1,k2,a) and the SSC response delP_SSC(k,a) are tabulated once per scenario
+// on the Limber nodes k=(ell+0.5)/f_K(a) of the Ncl ell bins and the limber.Na a nodes of the precision tier
+// (NG_TABLE_NA with the per-ell Limber integration), together with Pdelta and
+// survey_variance; every NG element is then a sum over the a nodes against the tomography kernels,
+// instead of one redshift integral with its own trispectrum evaluations per (ell1, ell2, z1..z4) as in cov_NG_*_tomo.
+// same integrands as inner_project_tri_cov_*_tomo: cNG term (if covparams.cng) and SSC term, galaxy fields add
+// the -b P response of the galaxy density; kernels are W_kappa and W_gal, set to zero outside each bin's range
+// the table only depends on cosmology, binning and survey area, so the first covariance job of a scenario writes it
+// to <outdir><survey.name>_ng_table and all other jobs read it; the file header stores grid, cosmology, survey area,
+// cNG switch and precision settings, and a table computed for other settings is an error
+// after tabulating, check_ng_table compares a few elements with the cosmolike_core cov_NG_*_tomo integrals
+// cluster NG terms (cov_NG_cgl_cgl etc.) depend on the cluster selection and are still integrated by cosmolike_core
+// elements can also be split into comp[0] connected NG and comp[1] super-sample covariance (comp != NULL)
+
+#define NG_TABLE_NA 100 //a nodes without the batched Limber integration (limber.Na = 0)
+#define NG_TABLE_NCOMP 2
+#define NG_TABLE_NINT 6 //header: Ncl, Na, cng, Ntable.N_a, N_k_lin, N_k_nlin
+#define NG_TABLE_NPAR 14 //header: 9 cosmological parameters, survey area, 4 integration tolerances
+#define NG_TABLE_TOL 5.e-2 //largest accepted relative deviation from cov_NG_*_tomo
+
+typedef struct {
+  int Ncl, Na;
+  int ready;
+  double *ell; //[Ncl]
+  double *a, *w; //nodes, trapezoid weight x dchi_da, [Na]
+  double *fcng, *fssc; //1/(f_K^6 A_survey) (0 without cNG) and survey_variance/f_K^4, [Na]
+  double *T; //tri_matter_cov, [Ncl][Ncl][Na]
+  double *R; //delP_SSC, [Ncl][Na]
+  double *P; //Pdelta, [Ncl][Na]
+  double *Wk; //W_kappa of the source bins, [shear_Nbin][Na]
+  double *Wg; //W_gal of the lens bins, [clustering_Nbin][Na]
+  double *b; //linear galaxy bias of the lens bins, [clustering_Nbin][Na]
+}ngtable;
+
+ngtable ng_table = {0, 0, 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
+
+void init_ng_table(int Ncl, double *ell);
+double check_ng_table();
+double cov_NG_shear_shear_table(int nl1, int nl2, int z1, int z2, int z3, int z4, double *comp);
+double cov_NG_gl_shear_table(int nl1, int nl2, int zl, int zs, int z3, int z4, double *comp);
+double cov_NG_cl_shear_table(int nl1, int nl2, int z1, int z2, int z3, int z4, double *comp);
+double cov_NG_cl_gl_table(int nl1, int nl2, int z1, int z2, int zl, int zs, double *comp);
+double cov_NG_cl_cl_table(int nl1, int nl2, int z1, int z2, int z3, int z4, double *comp);
+double cov_NG_gl_gl_table(int nl1, int nl2, int zl1, int zs1, int zl2, int zs2, double *comp);
+
+void ng_table_alloc(int Ncl, int Na)
+{
+  free(ng_table.ell); free(ng_table.a); free(ng_table.w); free(ng_table.fcng); free(ng_table.fssc);
+  free(ng_table.T); free(ng_table.R); free(ng_table.P); free(ng_table.Wk); free(ng_table.Wg); free(ng_table.b);
+  ng_table.Ncl=Ncl;
+  ng_table.Na=Na;
+  ng_table.ready=0;
+  ng_table.ell=malloc(Ncl*sizeof(double));
+  ng_table.a=malloc(Na*sizeof(double));
+  ng_table.w=malloc(Na*sizeof(double));
+  ng_table.fcng=malloc(Na*sizeof(double));
+  ng_table.fssc=malloc(Na*sizeof(double));
+  ng_table.T=malloc(Ncl*Ncl*Na*sizeof(double));
+  ng_table.R=malloc(Ncl*Na*sizeof(double));
+  ng_table.P=malloc(Ncl*Na*sizeof(double));
+  ng_table.Wk=calloc(10*Na,sizeof(double));
+  ng_table.Wg=calloc(10*Na,sizeof(double));
+  ng_table.b=calloc(10*Na,sizeof(double));
+  if (ng_table.b==NULL){
+    printf("ng_table_alloc: allocation failed\nEXIT\n");
+    exit(1);
+  }
+}
+
+// trispectrum, response, Pdelta and survey variance at the table nodes
+void ng_table_compute()
+{
+  int i,l,j,Ncl=ng_table.Ncl,Na=ng_table.Na;
+  double a,fK,k1,k2;
+  for (j=0;j<Na; j++){
+    a=ng_table.a[j];
+    fK=f_K(chi(a));
+    ng_table.fssc[j]=survey_variance(a,survey.area/41253.0);
+    for (i=0;i<Ncl; i++){
+      k1=(ng_table.ell[i]+0.5)/fK;
+      ng_table.R[i*Na+j]=delP_SSC(k1,a);
+      ng_table.P[i*Na+j]=Pdelta(k1,a);
+      for (l=i;l<Ncl; l++){
+        k2=(ng_table.ell[l]+0.5)/fK;
+        ng_table.T[(i*Ncl+l)*Na+j]=ng_table.T[(l*Ncl+i)*Na+j]=tri_matter_cov(k1,k2,a);
+      }
+    }
+  }
+}
+
+// settings the table depends on, written to and compared with the file header
+void ng_table_header(int *n, double *p)
+{
+  n[0]=ng_table.Ncl; n[1]=ng_table.Na; n[2]=covparams.cng;
+  n[3]=Ntable.N_a; n[4]=Ntable.N_k_lin; n[5]=Ntable.N_k_nlin;
+  p[0]=cosmology.Omega_m; p[1]=cosmology.sigma_8; p[2]=cosmology.n_spec;
+  p[3]=cosmology.w0; p[4]=cosmology.wa; p[5]=cosmology.omb;
+  p[6]=cosmology.h0; p[7]=cosmology.MGSigma; p[8]=cosmology.MGmu;
+  p[9]=survey.area;
+  p[10]=precision.low; p[11]=precision.medium; p[12]=precision.high; p[13]=precision.insane;
+}
+
+int ng_table_read(char *filename)
+{
+  int n[NG_TABLE_NINT],n0[NG_TABLE_NINT],Ncl=ng_table.Ncl,Na=ng_table.Na;
+  double p[NG_TABLE_NPAR],p0[NG_TABLE_NPAR],*x;
+  FILE *F;
+  F=fopen(filename,"rb");
+  if (F==NULL) return 0;
+  ng_table_header(n0,p0);
+  if (fread(n,sizeof(int),NG_TABLE_NINT,F)!=NG_TABLE_NINT || fread(p,sizeof(double),NG_TABLE_NPAR,F)!=NG_TABLE_NPAR){
+    printf("init_ng_table: %s has no valid header\nEXIT\n",filename);
+    exit(1);
+  }
+  if (memcmp(n,n0,sizeof(n))!=0 || memcmp(p,p0,sizeof(p))!=0){
+    printf("init_ng_table: %s was computed for different cosmology, area, cNG or precision settings\nEXIT\n",filename);
+    exit(1);
+  }
+  x=malloc((Ncl+Na)*sizeof(double));
+  if (fread(x,sizeof(double),Ncl+Na,F)!=(size_t)(Ncl+Na)
+    || memcmp(x,ng_table.ell,Ncl*sizeof(double))!=0 || memcmp(x+Ncl,ng_table.a,Na*sizeof(double))!=0){
+    printf("init_ng_table: %s was computed for a different ell or a grid\nEXIT\n",filename);
+    exit(1);
+  }
+  free(x);
+  if (fread(ng_table.fssc,sizeof(double),Na,F)!=(size_t)Na || fread(ng_table.R,sizeof(double),Ncl*Na,F)!=(size_t)(Ncl*Na)
+    || fread(ng_table.P,sizeof(double),Ncl*Na,F)!=(size_t)(Ncl*Na) || fread(ng_table.T,sizeof(double),Ncl*Ncl*Na,F)!=(size_t)(Ncl*Ncl*Na)){
+    printf("init_ng_table: %s is truncated\nEXIT\n",filename);
+    exit(1);
+  }
+  fclose(F);
+  return 1;
+}
+
+// written to a temporary file and renamed, so jobs running in parallel never read a partial table
+void ng_table_write(char *filename)
+{
+  char tmp[600];
+  int n[NG_TABLE_NINT],Ncl=ng_table.Ncl,Na=ng_table.Na;
+  double p[NG_TABLE_NPAR];
+  FILE *F;
+  sprintf(tmp,"%s.%d",filename,(int)getpid());
+  F=fopen(tmp,"wb");
+  if (F==NULL){
+    printf("init_ng_table: cannot write %s, table kept in memory only\n",tmp);
+    return;
+  }
+  ng_table_header(n,p);
+  fwrite(n,sizeof(int),NG_TABLE_NINT,F);
+  fwrite(p,sizeof(double),NG_TABLE_NPAR,F);
+  fwrite(ng_table.ell,sizeof(double),Ncl,F);
+  fwrite(ng_table.a,sizeof(double),Na,F);
+  fwrite(ng_table.fssc,sizeof(double),Na,F);
+  fwrite(ng_table.R,sizeof(double),Ncl*Na,F);
+  fwrite(ng_table.P,sizeof(double),Ncl*Na,F);
+  fwrite(ng_table.T,sizeof(double),Ncl*Ncl*Na,F);
+  fclose(F);
+  rename(tmp,filename);
+}
+
+// table file <covparams.outdir><survey.name>_ng_table, set both before the first covariance block
+void init_ng_table(int Ncl, double *ell)
+{
+  char filename[600];
+  int i,j,n,computed=0,Na=(limber.Na > 0 ? limber.Na : NG_TABLE_NA);
+  double amin=0.99999,amax=0.99999,a,fK,da;
+
+  sprintf(filename,"%s%s_ng_table",covparams.outdir,survey.name);
+
+  ng_table_alloc(Ncl,Na);
+  for (i=0;i<Ncl; i++) ng_table.ell[i]=ell[i];
+  for (n=0;n<tomo.shear_Nbin; n++) amin=fmin(amin,amin_source(n));
+  for (n=0;n<tomo.clustering_Nbin; n++) amin=fmin(amin,amin_lens(n));
+  da=(amax-amin)/(Na-1.);
+  for (j=0;j<Na; j++){
+    a=amin+j*da;
+    fK=f_K(chi(a));
+    ng_table.a[j]=a;
+    ng_table.w[j]=((j==0 || j==Na-1) ? 0.5*da : da)*dchi_da(a);
+    ng_table.fcng[j]=(covparams.cng ? pow(fK,-6.)/(survey.area*survey.area_conversion_factor) : 0.);
+    for (n=0;n<tomo.shear_Nbin; n++){
+      if (a >= amin_source(n)) ng_table.Wk[n*Na+j]=W_kappa(a,fK,(double)n);
+    }
+    for (n=0;n<tomo.clustering_Nbin; n++){
+      if (a < amin_lens(n) || a > amax_lens(n)) continue;
+      ng_table.Wg[n*Na+j]=W_gal(a,(double)n);
+      ng_table.b[n*Na+j]=gbias.b1_function(1./a-1.,n);
+    }
+  }
+  if (!ng_table_read(filename)){
+    printf("init_ng_table: tabulating trispectrum and SSC response (%d ell x %d ell x %d a)\n",Ncl,Ncl,Na);
+    ng_table_compute();
+    ng_table_write(filename);
+    computed=1;
+  }
+  else printf("init_ng_table: read %s\n",filename);
+  for (j=0;j<Na; j++){
+    fK=f_K(chi(ng_table.a[j]));
+    ng_table.fssc[j]*=pow(fK,-4.);
+  }
+  ng_table.ready=1;
+  if (computed) check_ng_table();
+}
+
+// sum_a w K1 K2 K3 K4 [T/(f_K^6 A) + (R1-g12 b12 P1)(R2-g34 b34 P2) sigma_b^2/f_K^4],
+// g12, g34: number of galaxy fields in the first and second spectrum, with biases b12 and b34
+double ng_table_sum(int nl1, int nl2, double *K1, double *K2, double *K3, double *K4, int g12, double *b12, int g34, double *b34, double *comp)
+{
+  int j,Na=ng_table.Na;
+  double K,r1,r2,cng=0.,ssc=0.,*T,*R1,*R2,*P1,*P2;
+  T=ng_table.T+(nl1*ng_table.Ncl+nl2)*Na;
+  R1=ng_table.R+nl1*Na; P1=ng_table.P+nl1*Na;
+  R2=ng_table.R+nl2*Na; P2=ng_table.P+nl2*Na;
+  for (j=0;j<Na; j++){
+    K=ng_table.w[j]*K1[j]*K2[j]*K3[j]*K4[j];
+    if (K==0.) continue;
+    r1=R1[j]-(g12 ? g12*b12[j]*P1[j] : 0.);
+    r2=R2[j]-(g34 ? g34*b34[j]*P2[j] : 0.);
+    cng+=K*T[j]*ng_table.fcng[j];
+    ssc+=K*r1*r2*ng_table.fssc[j];
+  }
+  if (comp){
+    comp[0]=cng;
+    comp[1]=ssc;
+  }
+  return cng+ssc;
+}
+
+double cov_NG_shear_shear_table(int nl1, int nl2, int z1, int z2, int z3, int z4, double *comp)
+{
+  int Na=ng_table.Na;
+  return ng_table_sum(nl1,nl2,ng_table.Wk+z1*Na,ng_table.Wk+z2*Na,ng_table.Wk+z3*Na,ng_table.Wk+z4*Na,0,NULL,0,NULL,comp);
+}
+
+double cov_NG_gl_shear_table(int nl1, int nl2, int zl, int zs, int z3, int z4, double *comp)
+{
+  int Na=ng_table.Na;
+  return ng_table_sum(nl1,nl2,ng_table.Wg+zl*Na,ng_table.Wk+zs*Na,ng_table.Wk+z3*Na,ng_table.Wk+z4*Na,1,ng_table.b+zl*Na,0,NULL,comp);
+}
+
+double cov_NG_cl_shear_table(int nl1, int nl2, int z1, int z2, int z3, int z4, double *comp)
+{
+  int Na=ng_table.Na;
+  return ng_table_sum(nl1,nl2,ng_table.Wg+z1*Na,ng_table.Wg+z2*Na,ng_table.Wk+z3*Na,ng_table.Wk+z4*Na,2,ng_table.b+z1*Na,0,NULL,comp);
+}
+
+double cov_NG_cl_gl_table(int nl1, int nl2, int z1, int z2, int zl, int zs, double *comp)
+{
+  int Na=ng_table.Na;
+  return ng_table_sum(nl1,nl2,ng_table.Wg+z1*Na,ng_table.Wg+z2*Na,ng_table.Wg+zl*Na,ng_table.Wk+zs*Na,2,ng_table.b+z1*Na,1,ng_table.b+zl*Na,comp);
+}
+
+double cov_NG_cl_cl_table(int nl1, int nl2, int z1, int z2, int z3, int z4, double *comp)
+{
+  int Na=ng_table.Na;
+  return ng_table_sum(nl1,nl2,ng_table.Wg+z1*Na,ng_table.Wg+z2*Na,ng_table.Wg+z3*Na,ng_table.Wg+z4*Na,2,ng_table.b+z1*Na,2,ng_table.b+z3*Na,comp);
+}
+
+double cov_NG_gl_gl_table(int nl1, int nl2, int zl1, int zs1, int zl2, int zs2, double *comp)
+{
+  int Na=ng_table.Na;
+  return ng_table_sum(nl1,nl2,ng_table.Wg+zl1*Na,ng_table.Wk+zs1*Na,ng_table.Wg+zl2*Na,ng_table.Wk+zs2*Na,1,ng_table.b+zl1*Na,1,ng_table.b+zl2*Na,comp);
+}
+
+// spot check of the table against the cosmolike_core integrals: shear-shear of the last source bin and
+// clustering of the first lens bin at the first, middle and (first, last) ell bins; returns the largest relative deviation
+double check_ng_table()
+{
+  int i,nl1[3]={0,ng_table.Ncl/2,0},nl2[3]={0,ng_table.Ncl/2,ng_table.Ncl-1},zs=tomo.shear_Nbin-1;
+  double c,c0,dev,maxdev=0.;
+  printf("init_ng_table: check against cov_NG_*_tomo\n");
+  for (i=0;i<3; i++){
+    c=cov_NG_shear_shear_table(nl1[i],nl2[i],zs,zs,zs,zs,NULL);
+    c0=cov_NG_shear_shear_tomo(ng_table.ell[nl1[i]],ng_table.ell[nl2[i]],zs,zs,zs,zs);
+    dev=(c0 != 0. ? fabs(c/c0-1.) : 0.);
+    maxdev=fmax(maxdev,dev);
+    printf("shear_shear (%d,%d) ell %e %e: table %e core %e, deviation %e\n",zs,zs,ng_table.ell[nl1[i]],ng_table.ell[nl2[i]],c,c0,dev);
+    c=cov_NG_cl_cl_table(nl1[i],nl2[i],0,0,0,0,NULL);
+    c0=cov_NG_cl_cl_tomo(ng_table.ell[nl1[i]],ng_table.ell[nl2[i]],0,0,0,0);
+    dev=(c0 != 0. ? fabs(c/c0-1.) : 0.);
+    maxdev=fmax(maxdev,dev);
+    printf("clustering (0,0) ell %e %e: table %e core %e, deviation %e\n",ng_table.ell[nl1[i]],ng_table.ell[nl2[i]],c,c0,dev);
+  }
+  if (maxdev > NG_TABLE_TOL) printf("init_ng_table: WARNING largest deviation %e from cov_NG_*_tomo above %e\n",maxdev,NG_TABLE_TOL);
+  return maxdev;
+}
@@ -0,0 +1,88 @@
+import sys
+import numpy as np
+
+# Which covariance term dominates each probe block: reads a component archive (cat covparallel/comp_<survey.name>*)
+# or the container written by convert_cov_components (covio.c), and the index map <outdir><survey.name>_index_map.
+#
+# python cov_terms.py <component archive or container> <index map>
+#   for every pair of probe blocks, the share of each term in the summed |covariance| of the block,
+#   and the ratio of the full to the Gaussian diagonal for the diagonal blocks.
+# only the shear, ggl and clustering blocks are split into components; the cluster number counts and cluster
+# lensing blocks (clusterN, clusterWL) and their cross blocks have no component rows and are listed as not split.
+
+terms = ['cosmic_var','mixed','noise','cNG','SSC']
+# container arrays (COVIO_COMPONENTS) summed into each term
+term_arrays = [['G_cv'],['G_mix_shape','G_mix_shot'],['G_shape','G_shot','G_shape_shot'],['cNG'],['SSC']]
+# the same for the columns of the component archive
+term_columns = [[10],[11,12],[13,14,15],[16],[17]]
+
+def read_index_map(filename):
+    blocks = []
+    ndata = 0
+    for line in open(filename):
+        w = line.split()
+        if len(w) == 5 and w[1] == "block" and int(w[4]) > 0:
+            blocks.append((w[2],int(w[3]),int(w[4])))
+        if len(w) == 3 and w[1] == "Ndata":
+            ndata = int(w[2])
+    return ndata,blocks
+
+def read_container(filename):
+    # layout of write_cov_container: magic, ndata, Narrays, then name[16], packed, pad, data per array
+    f = open(filename,'rb')
+    if f.read(8) != b'CLCOV01\0':
+        return None
+    ndata,narrays = np.fromfile(f,dtype=np.intc,count=2)
+    arrays = {}
+    for k in range(narrays):
+        name = f.read(16).split(b'\0')[0].decode()
+        packed,pad = np.fromfile(f,dtype=np.intc,count=2)
+        if packed:
+            M = np.zeros((ndata,ndata))
+            M[np.tril_indices(ndata)] = np.fromfile(f,dtype=np.float64,count=ndata*(ndata+1)//2)
+            M = M+np.tril(M,-1).T
+        else:
+            M = np.fromfile(f,dtype=np.float64,count=ndata*ndata).reshape(ndata,ndata)
+        arrays[name] = M
+    f.close()
+    return [sum([arrays[a] for a in names]) for names in term_arrays]
+
+def read_archive(filename,ndata):
+    rows = np.atleast_2d(np.loadtxt(filename))
+    if rows.shape[1] < 18:
+        print("cov_terms: %s has %d columns, need a component archive ([output] cov_components = 1)" % (filename,rows.shape[1]))
+        sys.exit(1)
+    i = rows[:,0].astype(int)
+    j = rows[:,1].astype(int)
+    M = []
+    for cols in term_columns:
+        C = np.zeros((ndata,ndata))
+        C[i,j] = rows[:,cols].sum(axis=1)
+        C[j,i] = C[i,j]
+        M.append(C)
+    return M
+
+if __name__ == "__main__":
+    if len(sys.argv) != 3:
+        print("usage: python cov_terms.py <component archive or container> <index map>")
+        sys.exit(1)
+    ndata,blocks = read_index_map(sys.argv[2])
+    M = read_container(sys.argv[1])
+    if M is None:
+        M = read_archive(sys.argv[1],ndata)
+    print('# block1 block2 '+' '.join(terms)+' dominant diag(full)/diag(G)')
+    for n1,(b1,s1,N1) in enumerate(blocks):
+        for b2,s2,N2 in blocks[n1:]:
+            a = np.array([np.abs(C[s1:s1+N1,s2:s2+N2]).sum() for C in M])
+            if a.sum() == 0.:
+                print('%s %s not split into components' % (b1,b2))
+                continue
+            frac = a/a.sum()
+            ratio = ''
+            if b1 == b2:
+                G = np.diag(M[0]+M[1]+M[2])[s1:s1+N1]
+                full = G+np.diag(M[3]+M[4])[s1:s1+N1]
+                ok = G > 0.
+                if ok.any():
+                    ratio = ' %.3f' % np.mean(full[ok]/G[ok])
+            print('%s %s ' % (b1,b2)+' '.join(['%.3f' % f for f in frac])+' %s' % terms[np.argmax(frac)]+ratio)
@@ -0,0 +1,430 @@
+// covariance I/O: multithreaded reader for the concatenated text archives
+// (cat covparallel/<scenario>* > cov/..., rows "i j ell1 ell2 z1 z2 z3 z4 c_g c_ng")
+// and for inverse covariance files (rows "i j value"), plus the binary covariance container
+//
+// the text file is memory-mapped and split at line boundaries into one chunk per thread;
+// each thread parses its rows and writes the values directly into the output matrix
+//
+// container layout (native byte order):
+//   char magic[8]   "CLCOV01\0"
+//   int ndata, Narrays
+//   Narrays x { char name[16]; int packed; int pad; double data[ndata*ndata or ndata*(ndata+1)/2] }
+// packed arrays hold the lower triangle row by row, element (i,j), j<=i, at i*(i+1)/2+j
+//
+// component archives (compute_covariances_fourier.c with [output] cov_components = 1) have COVIO_NCOMP more columns
+// after c_g c_ng; convert_cov_components stores them as the arrays COVIO_COMPONENTS next to "g" and "ng"
+// only the shear, ggl and clustering blocks are split: the component archive has no clusterN and clusterWL rows,
+// so all arrays of its container are zero there; their covariance is only in the full archive
+
+#define COVIO_MAGIC "CLCOV01"
+#define COVIO_MAXCOL 24
+#define COVIO_NCOMP 8
+#define COVIO_COMPONENTS "G_cv,G_mix_shape,G_mix_shot,G_shape,G_shot,G_shape_shot,cNG,SSC"
+#define COVIO_MAXTHREADS 64
+
+typedef struct {
+  const char *begin, *end; //chunk of the mapped file, starts at a line start
+  int ndata;
+  int packed;
+  int symmetric; //also fill (j,i)
+  double *g, *ng; //ng may be NULL
+  double *comp; //COVIO_NCOMP arrays of size entries from columns 10.., may be NULL
+  long size;
+  long Nrows;
+  int imax;
+}covio_chunk;
+
+int cov_text_ndata(char *filename);
+void read_cov_text(char *filename, int ndata, int packed, int symmetric, int Nthreads, double *g, double *ng);
+int is_cov_container(char *filename);
+int cov_container_ndata(char *filename);
+int cov_container_has(char *filename, char *name);
+int read_cov_container(char *filename, char *name, double *out);
+void unpack_cov(double *M, int ndata);
+void write_cov_container(char *filename, int ndata, int packed, char *names, double *arrays);
+void convert_cov_archive(char *txtfile, char *binfile, int ndata, int packed, int Nthreads);
+void read_cov_components(char *filename, int ndata, int packed, int Nthreads, double *arrays);
+void convert_cov_components(char *txtfile, char *binfile, int ndata, int packed, int Nthreads);
+
+static const double covio_p10[23]={1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,1e11,1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,1e20,1e21,1e22};
+
+// decimal float in printf %d/%e/%le/%f form; exact whenever the mantissa has <= 15 digits and |exp| <= 22,
+// everything else (long mantissas, nan, inf) falls back to strtod
+double covio_parse_double(const char *p, const char *end, const char **next)
+{
+  const char *s=p;
+  unsigned long m=0;
+  int neg=0,nd=0,e=0,esign=1,ev=0;
+  char buf[64],*q;
+  double x;
+
+  if (p<end && (*p=='-' || *p=='+')){ neg=(*p=='-'); p++; }
+  while (p<end && *p>='0' && *p<='9'){ if (nd<19){ m=10*m+(*p-'0'); nd+=(m>0);} else e++; p++; }
+  if (p<end && *p=='.'){
+    p++;
+    while (p<end && *p>='0' && *p<='9'){ if (nd<19){ m=10*m+(*p-'0'); nd+=(m>0); e--;} p++; }
+  }
+  if (p<end && (*p=='e' || *p=='E')){
+    p++;
+    if (p<end && (*p=='-' || *p=='+')){ esign=(*p=='-' ? -1 : 1); p++; }
+    while (p<end && *p>='0' && *p<='9'){ ev=10*ev+(*p-'0'); p++; }
+    e+=esign*ev;
+  }
+  if (nd<=15 && e>=-22 && e<=22 && p>s){
+    *next=p;
+    if (e<0) return (neg ? -1. : 1.)*((double) m/covio_p10[-e]);
+    return (neg ? -1. : 1.)*((double) m*covio_p10[e]);
+  }
+  nd=(int)(end-s < 63 ? end-s : 63);
+  memcpy(buf,s,nd);
+  buf[nd]='\0';
+  x=strtod(buf,&q);
+  *next=s+(q-buf);
+  return x;
+}
+
+// parses the numbers on one line into v, returns the number of columns and moves *p to the next line
+int covio_parse_line(const char **p, const char *end, double *v)
+{
+  const char *c=*p,*next;
+  int n=0;
+  while (c<end && *c!='\n'){
+    if (*c==' ' || *c=='\t' || *c=='\r'){ c++; continue; }
+    if (*c=='#'){ while (c<end && *c!='\n') c++; break; }
+    v[n<COVIO_MAXCOL ? n : COVIO_MAXCOL-1]=covio_parse_double(c,end,&next);
+    if (next==c){ while (c<end && *c!='\n' && *c!=' ' && *c!='\t') c++; continue; }
+    n++;
+    c=next;
+  }
+  *p=(c<end ? c+1 : end);
+  return n;
+}
+
+void covio_set(covio_chunk *ch, double *M, int i, int j, double x)
+{
+  if (ch->packed){
+    if (j>i){ int t=i; i=j; j=t; }
+    M[(long) i*(i+1)/2+j]=x;
+    return;
+  }
+  M[(long) i*ch->ndata+j]=x;
+  if (ch->symmetric) M[(long) j*ch->ndata+i]=x;
+}
+
+void *covio_parse_chunk(void *arg)
+{
+  covio_chunk *ch=(covio_chunk *) arg;
+  const char *p=ch->begin;
+  double v[COVIO_MAXCOL];
+  int n,i,j,k;
+
+  ch->Nrows=0;
+  ch->imax=-1;
+  while (p<ch->end){
+    n=covio_parse_line(&p,ch->end,v);
+    if (n<3) continue;
+    i=(int) v[0];
+    j=(int) v[1];
+    if (i>ch->imax) ch->imax=i;
+    if (j>ch->imax) ch->imax=j;
+    ch->Nrows++;
+    if (ch->ndata<=0) continue; //size scan only
+    if (i<0 || j<0 || i>=ch->ndata || j>=ch->ndata) continue;
+    if (n==3) covio_set(ch,ch->g,i,j,v[2]);
+    else if (ch->comp){
+      covio_set(ch,ch->g,i,j,v[8]);
+      if (ch->ng) covio_set(ch,ch->ng,i,j,v[9]);
+    }
+    else {
+      covio_set(ch,ch->g,i,j,v[n-2]);
+      if (ch->ng) covio_set(ch,ch->ng,i,j,v[n-1]);
+    }
+    if (ch->comp){
+      for (k=0;k<COVIO_NCOMP && 10+k<n; k++) covio_set(ch,ch->comp+k*ch->size,i,j,v[10+k]);
+    }
+  }
+  return NULL;
+}
+
+// maps the file, cuts it into Nthreads line-aligned chunks and runs covio_parse_chunk on each
+long covio_run(char *filename, int ndata, int packed, int symmetric, int Nthreads, double *g, double *ng, double *comp, int *imax)
+{
+  int fd,t;
+  struct stat st;
+  char *map;
+  const char *p;
+  long size,Nrows=0;
+  pthread_t thread[COVIO_MAXTHREADS];
+  covio_chunk ch[COVIO_MAXTHREADS];
+
+  fd=open(filename,O_RDONLY);
+  if (fd<0){
+    printf("read_cov_text: file %s not found.\nEXIT\n",filename);
+    exit(1);
+  }
+  fstat(fd,&st);
+  size=st.st_size;
+  if (size==0){
+    close(fd);
+    *imax=-1;
+    return 0;
+  }
+  map=mmap(NULL,size,PROT_READ,MAP_PRIVATE,fd,0);
+  close(fd);
+  if (map==MAP_FAILED){
+    printf("read_cov_text: could not map %s\nEXIT\n",filename);
+    exit(1);
+  }
+  madvise(map,size,MADV_SEQUENTIAL);
+  if (Nthreads<=0) Nthreads=(int) sysconf(_SC_NPROCESSORS_ONLN);
+  if (Nthreads<1) Nthreads=1;
+  if (Nthreads>COVIO_MAXTHREADS) Nthreads=COVIO_MAXTHREADS;
+  if (size<(1<<20)) Nthreads=1;
+
+  p=map;
+  for (t=0;t<Nthreads; t++){
+    ch[t].begin=p;
+    p=(t==Nthreads-1 ? map+size : map+size/Nthreads*(t+1));
+    while (p<map+size && p>ch[t].begin && p[-1]!='\n') p++;
+    if (p<ch[t].begin) p=ch[t].begin;
+    ch[t].end=p;
+    ch[t].ndata=ndata;
+    ch[t].packed=packed;
+    ch[t].symmetric=symmetric;
+    ch[t].g=g;
+    ch[t].ng=ng;
+    ch[t].comp=comp;
+    ch[t].size=(packed ? (long) ndata*(ndata+1)/2 : (long) ndata*ndata);
+    if (t>0 && pthread_create(&thread[t],NULL,covio_parse_chunk,&ch[t])!=0){
+      printf("read_cov_text: could not start thread %d\nEXIT\n",t);
+      exit(1);
+    }
+  }
+  covio_parse_chunk(&ch[0]);
+  *imax=ch[0].imax;
+  Nrows=ch[0].Nrows;
+  for (t=1;t<Nthreads; t++){
+    pthread_join(thread[t],NULL);
+    Nrows+=ch[t].Nrows;
+    if (ch[t].imax>*imax) *imax=ch[t].imax;
+  }
+  munmap(map,size);
+  return Nrows;
+}
+
+// number of data points in a text covariance, 1 + largest index
+int cov_text_ndata(char *filename)
+{
+  int imax;
+  covio_run(filename,0,0,0,0,NULL,NULL,NULL,&imax);
+  return imax+1;
+}
+
+// fills g (and ng if not NULL) from a text covariance or inverse covariance;
+// files with 3 columns go to g, otherwise the last two columns are c_g, c_ng.
+// g, ng hold ndata*ndata doubles (packed=0) or ndata*(ndata+1)/2 (packed=1) and are zeroed here;
+// symmetric=1 mirrors (i,j) to (j,i) for archives that only store one triangle of the block pairs.
+// Nthreads<=0 uses all online cores
+void read_cov_text(char *filename, int ndata, int packed, int symmetric, int Nthreads, double *g, double *ng)
+{
+  int imax;
+  long size,Nrows;
+
+  size=(packed ? (long) ndata*(ndata+1)/2 : (long) ndata*ndata);
+  memset(g,0,size*sizeof(double));
+  if (ng) memset(ng,0,size*sizeof(double));
+  Nrows=covio_run(filename,ndata,packed,symmetric,Nthreads,g,ng,NULL,&imax);
+  if (imax>=ndata){
+    printf("read_cov_text: %s has index %d, larger than ndata=%d\nEXIT\n",filename,imax,ndata);
+    exit(1);
+  }
+  printf("read_cov_text: %ld rows from %s\n",Nrows,filename);
+}
+
+int is_cov_container(char *filename)
+{
+  char magic[8];
+  FILE *F=fopen(filename,"rb");
+  if (F==NULL) return 0;
+  if (fread(magic,1,8,F)!=8) magic[0]='\0';
+  fclose(F);
+  return (memcmp(magic,COVIO_MAGIC,8)==0);
+}
+
+FILE *covio_open_container(char *filename, int *ndata, int *Narrays)
+{
+  FILE *F;
+  char magic[8];
+
+  F=fopen(filename,"rb");
+  if (F==NULL){
+    printf("read_cov_container: file %s not found.\nEXIT\n",filename);
+    exit(1);
+  }
+  if (fread(magic,1,8,F)!=8 || memcmp(magic,COVIO_MAGIC,8)!=0 || fread(ndata,sizeof(int),1,F)!=1 || fread(Narrays,sizeof(int),1,F)!=1){
+    printf("read_cov_container: %s is not a covariance container\nEXIT\n",filename);
+    exit(1);
+  }
+  return F;
+}
+
+int cov_container_ndata(char *filename)
+{
+  int ndata,Narrays;
+  fclose(covio_open_container(filename,&ndata,&Narrays));
+  return ndata;
+}
+
+// returns the offset of array "name" in the file and its packing flag, -1 if absent
+long covio_find_array(char *filename, char *name, int *packed)
+{
+  FILE *F;
+  int ndata,Narrays,k,hdr[2];
+  char aname[16];
+  long size,offset=-1;
+
+  F=covio_open_container(filename,&ndata,&Narrays);
+  for (k=0;k<Narrays; k++){
+    if (fread(aname,1,16,F)!=16 || fread(hdr,sizeof(int),2,F)!=2) break;
+    size=(hdr[0] ? (long) ndata*(ndata+1)/2 : (long) ndata*ndata);
+    if (strncmp(aname,name,16)==0){
+      offset=ftell(F);
+      *packed=hdr[0];
+      break;
+    }
+    fseek(F,size*sizeof(double),SEEK_CUR);
+  }
+  fclose(F);
+  return offset;
+}
+
+int cov_container_has(char *filename, char *name)
+{
+  int packed;
+  return (covio_find_array(filename,name,&packed) >= 0);
+}
+
+// copies array "name" into out, in the storage (dense or packed) it was written with, returns the packed flag
+int read_cov_container(char *filename, char *name, double *out)
+{
+  FILE *F;
+  int ndata,packed;
+  long offset,size;
+
+  offset=covio_find_array(filename,name,&packed);
+  if (offset<0){
+    printf("read_cov_container: array %s not found in %s\nEXIT\n",name,filename);
+    exit(1);
+  }
+  ndata=cov_container_ndata(filename);
+  size=(packed ? (long) ndata*(ndata+1)/2 : (long) ndata*ndata);
+  F=fopen(filename,"rb");
+  fseek(F,offset,SEEK_SET);
+  if (fread(out,sizeof(double),size,F)!=(size_t) size){
+    printf("read_cov_container: %s is truncated\nEXIT\n",filename);
+    exit(1);
+  }
+  fclose(F);
+  return packed;
+}
+
+// packed lower triangle in M[0..ndata*(ndata+1)/2-1] -> symmetric dense ndata x ndata matrix in place
+// (M holds ndata*ndata doubles; elements are moved from the end, so no packed value is overwritten before it is read)
+void unpack_cov(double *M, int ndata)
+{
+  long i,j;
+  for (i=ndata-1;i>=0; i--){
+    for (j=i;j>=0; j--) M[i*ndata+j]=M[i*(i+1)/2+j];
+  }
+  for (i=0;i<ndata; i++){
+    for (j=i+1;j<ndata; j++) M[i*ndata+j]=M[j*ndata+i];
+  }
+}
+
+// names: comma separated array names (<16 characters), arrays: the arrays back to back
+void write_cov_container(char *filename, int ndata, int packed, char *names, double *arrays)
+{
+  FILE *F;
+  int k,Narrays=1,hdr[2]={packed,0};
+  char aname[16],*c;
+  const char *s;
+  long size=(packed ? (long) ndata*(ndata+1)/2 : (long) ndata*ndata);
+
+  for (c=names; *c; c++) Narrays+=(*c==',');
+  F=fopen(filename,"wb");
+  if (F==NULL){
+    printf("write_cov_container: could not open %s\nEXIT\n",filename);
+    exit(1);
+  }
+  fwrite(COVIO_MAGIC,1,8,F);
+  fwrite(&ndata,sizeof(int),1,F);
+  fwrite(&Narrays,sizeof(int),1,F);
+  s=names;
+  for (k=0;k<Narrays; k++){
+    memset(aname,0,16);
+    for (c=aname; *s && *s!=',' && c<aname+15; ) *c++=*s++;
+    while (*s && *s!=',') s++;
+    if (*s==',') s++;
+    fwrite(aname,1,16,F);
+    fwrite(hdr,sizeof(int),2,F);
+    fwrite(arrays+k*size,sizeof(double),size,F);
+  }
+  fclose(F);
+}
+
+// text archive -> container with arrays "g" and "ng" (ng is zero for 3-column inverse files);
+// ndata<=0 takes the size from the largest index in the archive
+void convert_cov_archive(char *txtfile, char *binfile, int ndata, int packed, int Nthreads)
+{
+  double *M;
+  long size;
+
+  if (ndata<=0) ndata=cov_text_ndata(txtfile);
+  size=(packed ? (long) ndata*(ndata+1)/2 : (long) ndata*ndata);
+  M=malloc(2*size*sizeof(double));
+  if (M==NULL){
+    printf("convert_cov_archive: could not allocate %d x %d matrices\nEXIT\n",ndata,ndata);
+    exit(1);
+  }
+  read_cov_text(txtfile,ndata,packed,1,Nthreads,M,M+size);
+  write_cov_container(binfile,ndata,packed,"g,ng",M);
+  free(M);
+  printf("convert_cov_archive: %s -> %s (ndata=%d)\n",txtfile,binfile,ndata);
+}
+// component archive -> arrays g, ng and the COVIO_NCOMP components back to back (each ndata*ndata or packed),
+// zeroed here; (i,j) is mirrored to (j,i) as for the concatenated archives
+void read_cov_components(char *filename, int ndata, int packed, int Nthreads, double *arrays)
+{
+  int imax;
+  long size,Nrows;
+
+  size=(packed ? (long) ndata*(ndata+1)/2 : (long) ndata*ndata);
+  memset(arrays,0,(COVIO_NCOMP+2)*size*sizeof(double));
+  Nrows=covio_run(filename,ndata,packed,1,Nthreads,arrays,arrays+size,arrays+2*size,&imax);
+  if (imax>=ndata){
+    printf("read_cov_components: %s has index %d, larger than ndata=%d\nEXIT\n",filename,imax,ndata);
+    exit(1);
+  }
+  printf("read_cov_components: %ld rows from %s\n",Nrows,filename);
+}
+
+// component archive -> container with arrays "g", "ng" and COVIO_COMPONENTS
+void convert_cov_components(char *txtfile, char *binfile, int ndata, int packed, int Nthreads)
+{
+  double *M;
+  long size;
+
+  if (ndata<=0) ndata=cov_text_ndata(txtfile);
+  size=(packed ? (long) ndata*(ndata+1)/2 : (long) ndata*ndata);
+  M=malloc((COVIO_NCOMP+2)*size*sizeof(double));
+  if (M==NULL){
+    printf("convert_cov_components: could not allocate %d x %d matrices\nEXIT\n",ndata,ndata);
+    exit(1);
+  }
+  read_cov_components(txtfile,ndata,packed,Nthreads,M);
+  write_cov_container(binfile,ndata,packed,"g,ng," COVIO_COMPONENTS,M);
+  free(M);
+  printf("convert_cov_components: %s -> %s (ndata=%d)\n",txtfile,binfile,ndata);
+}
+#undef COVIO_MAXCOL
+#undef COVIO_MAXTHREADS
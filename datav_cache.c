@@ -0,0 +1,240 @@
+// LRU cache of the probe blocks of the model data vector (shear, ggl, clustering, clusterN, clusterWL)
+// each block is keyed only on the parameters it depends on, so a Fisher stencil or sampler step in a
+// nuisance parameter recomputes only the blocks of that parameter (e.g. a lens bias step reuses shear
+// and the cluster blocks, a mass-observable step reuses the three 2pt blocks)
+// the cache is disabled until init_datav_cache is called with a positive memory budget
+// every init that changes the model (survey, binning, n(z), tomography, precision, Limber grid, band powers,
+// IA, clusters, probes) calls clear_datav_cache
+
+#define DATAV_CACHE_NKEY 72
+#define DATAV_CACHE_NBLOCK 5
+
+typedef struct datav_cache_entry {
+  double key[DATAV_CACHE_NKEY];
+  unsigned long hash;
+  double *datav;
+  int N;
+  struct datav_cache_entry *prev, *next; // LRU list, head = most recently used
+  struct datav_cache_entry *hnext; // hash bucket chain
+}datav_cache_entry;
+
+typedef struct {
+  int Nbuckets;
+  int Nentries;
+  long hits;
+  long misses;
+  double memory_MB;
+  double bytes, max_bytes;
+  datav_cache_entry **bucket;
+  datav_cache_entry *head, *tail;
+}datav_cache_para;
+
+datav_cache_para datav_cache = {0, 0, 0, 0, 0.0, 0.0, 0.0, NULL, NULL, NULL};
+
+void init_datav_cache(double memory_MB);
+void clear_datav_cache(void);
+int datav_cache_lookup(int b, double *datav, int N);
+void datav_cache_store(int b, double *datav, int N);
+long get_datav_cache_hits(void);
+long get_datav_cache_misses(void);
+
+// parameter state that determines block b (0 shear, 1 ggl, 2 clustering, 3 clusterN, 4 clusterWL) of N elements
+void datav_cache_key(int b, int N, double *key)
+{
+  int i,n=0;
+  memset(key,0,DATAV_CACHE_NKEY*sizeof(double));
+  key[n++]=(double) b;
+  key[n++]=(double) N;
+  key[n++]=(double) limber.Na;
+  key[n++]=(double) limber.Nsub;
+  key[n++]=cosmology.Omega_m;
+  key[n++]=cosmology.sigma_8;
+  key[n++]=cosmology.n_spec;
+  key[n++]=cosmology.w0;
+  key[n++]=cosmology.wa;
+  key[n++]=cosmology.omb;
+  key[n++]=cosmology.h0;
+  key[n++]=cosmology.MGSigma;
+  key[n++]=cosmology.MGmu;
+  if (b==1 || b==2){
+    for (i=0;i<10; i++) key[n++]=gbias.b[i];
+    for (i=0;i<10; i++) key[n++]=nuisance.bias_zphot_clustering[i];
+    key[n++]=nuisance.sigma_zphot_clustering[0];
+  }
+  if (b==0 || b==1 || b==4){
+    for (i=0;i<10; i++) key[n++]=nuisance.bias_zphot_shear[i];
+    key[n++]=nuisance.sigma_zphot_shear[0];
+    for (i=0;i<10; i++) key[n++]=nuisance.shear_calibration_m[i];
+  }
+  if (b==0 || b==1){
+    key[n++]=nuisance.A_ia;
+    key[n++]=nuisance.beta_ia;
+    key[n++]=nuisance.eta_ia;
+    key[n++]=nuisance.eta_ia_highz;
+    key[n++]=nuisance.LF_alpha;
+    key[n++]=nuisance.LF_P;
+    key[n++]=nuisance.LF_Q;
+    key[n++]=nuisance.LF_red_alpha;
+    key[n++]=nuisance.LF_red_P;
+    key[n++]=nuisance.LF_red_Q;
+  }
+  if (b==3 || b==4){
+    key[n++]=nuisance.cluster_Mobs_lgN0;
+    key[n++]=nuisance.cluster_Mobs_alpha;
+    key[n++]=nuisance.cluster_Mobs_beta;
+    key[n++]=nuisance.cluster_Mobs_sigma0;
+    key[n++]=nuisance.cluster_Mobs_sigma_qm;
+    key[n++]=nuisance.cluster_Mobs_sigma_qz;
+  }
+  assert(n<=DATAV_CACHE_NKEY);
+}
+
+// FNV-1a over the raw bytes of the key
+unsigned long datav_cache_hash(double *key)
+{
+  unsigned long h=1469598103934665603UL;
+  unsigned char *c=(unsigned char *) key;
+  int i;
+  for (i=0;i<(int)(DATAV_CACHE_NKEY*sizeof(double)); i++){
+    h^=c[i];
+    h*=1099511628211UL;
+  }
+  return h;
+}
+
+void init_datav_cache(double memory_MB)
+{
+  double entry_size;
+
+  clear_datav_cache();
+  free(datav_cache.bucket);
+  datav_cache.bucket=NULL;
+  datav_cache.memory_MB=memory_MB;
+  datav_cache.max_bytes=memory_MB*1024.*1024.;
+  datav_cache.hits=datav_cache.misses=0;
+  if (memory_MB <= 0.0){
+    datav_cache.max_bytes=0.;
+    return;
+  }
+  if (like.Ndata <= 0){
+    printf("init_datav_cache: call after init_probes\nEXIT\n");
+    exit(1);
+  }
+  // hash table sized for blocks of average length
+  entry_size=sizeof(datav_cache_entry)+like.Ndata*sizeof(double)/DATAV_CACHE_NBLOCK;
+  datav_cache.Nbuckets=2*(int)(datav_cache.max_bytes/entry_size)+1;
+  datav_cache.bucket=calloc(datav_cache.Nbuckets,sizeof(datav_cache_entry*));
+  if (datav_cache.bucket==NULL){
+    printf("init_datav_cache: could not allocate hash table\nEXIT\n");
+    exit(1);
+  }
+  printf("data vector cache: %.1f MB for probe blocks of up to %d elements\n",memory_MB,like.Ndata);
+}
+
+void clear_datav_cache(void)
+{
+  datav_cache_entry *e=datav_cache.head,*next;
+  while (e!=NULL){
+    next=e->next;
+    free(e->datav);
+    free(e);
+    e=next;
+  }
+  datav_cache.head=datav_cache.tail=NULL;
+  datav_cache.Nentries=0;
+  datav_cache.bytes=0.;
+  if (datav_cache.bucket!=NULL) memset(datav_cache.bucket,0,datav_cache.Nbuckets*sizeof(datav_cache_entry*));
+}
+
+void datav_cache_unlink(datav_cache_entry *e)
+{
+  if (e->prev) e->prev->next=e->next;
+  else datav_cache.head=e->next;
+  if (e->next) e->next->prev=e->prev;
+  else datav_cache.tail=e->prev;
+  e->prev=e->next=NULL;
+}
+
+void datav_cache_push_front(datav_cache_entry *e)
+{
+  e->prev=NULL;
+  e->next=datav_cache.head;
+  if (datav_cache.head) datav_cache.head->prev=e;
+  datav_cache.head=e;
+  if (datav_cache.tail==NULL) datav_cache.tail=e;
+}
+
+// returns 1 and fills datav[0..N-1] if block b is cached for the current parameter state
+int datav_cache_lookup(int b, double *datav, int N)
+{
+  double key[DATAV_CACHE_NKEY];
+  unsigned long h;
+  datav_cache_entry *e;
+
+  if (datav_cache.bucket==NULL || N<=0) return 0;
+  datav_cache_key(b,N,key);
+  h=datav_cache_hash(key);
+  for (e=datav_cache.bucket[h % datav_cache.Nbuckets]; e!=NULL; e=e->hnext){
+    if (e->hash==h && memcmp(e->key,key,sizeof(key))==0 && e->N==N){
+      memcpy(datav,e->datav,N*sizeof(double));
+      datav_cache_unlink(e);
+      datav_cache_push_front(e);
+      datav_cache.hits++;
+      return 1;
+    }
+  }
+  datav_cache.misses++;
+  return 0;
+}
+
+void datav_cache_evict(void)
+{
+  datav_cache_entry *e=datav_cache.tail,**p;
+  if (e==NULL) return;
+  datav_cache_unlink(e);
+  for (p=&datav_cache.bucket[e->hash % datav_cache.Nbuckets]; *p!=NULL; p=&(*p)->hnext){
+    if (*p==e){
+      *p=e->hnext;
+      break;
+    }
+  }
+  datav_cache.bytes-=sizeof(datav_cache_entry)+e->N*sizeof(double);
+  free(e->datav);
+  free(e);
+  datav_cache.Nentries--;
+}
+
+// stores block b for the current parameter state, evicting the least recently used blocks if full
+void datav_cache_store(int b, double *datav, int N)
+{
+  datav_cache_entry *e;
+  double size=sizeof(datav_cache_entry)+N*sizeof(double);
+  int k;
+
+  if (datav_cache.bucket==NULL || N<=0 || size>datav_cache.max_bytes) return;
+  while (datav_cache.Nentries>0 && datav_cache.bytes+size>datav_cache.max_bytes) datav_cache_evict();
+  e=malloc(sizeof(datav_cache_entry));
+  if (e!=NULL) e->datav=malloc(N*sizeof(double));
+  if (e==NULL || e->datav==NULL){
+    printf("datav_cache_store: allocation failed, cache not updated\n");
+    free(e);
+    return;
+  }
+  datav_cache_key(b,N,e->key);
+  e->hash=datav_cache_hash(e->key);
+  e->N=N;
+  memcpy(e->datav,datav,N*sizeof(double));
+  k=e->hash % datav_cache.Nbuckets;
+  e->hnext=datav_cache.bucket[k];
+  datav_cache.bucket[k]=e;
+  datav_cache_push_front(e);
+  datav_cache.Nentries++;
+  datav_cache.bytes+=size;
+}
+
+long get_datav_cache_hits(void){
+  return datav_cache.hits;
+}
+long get_datav_cache_misses(void){
+  return datav_cache.misses;
+}
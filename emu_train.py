@@ -0,0 +1,79 @@
+import sys
+import os
+import numpy as np
+from cosmolike_libs import *
+
+# Trains the data vector emulator of emulator.c on exact data vectors over a parameter box.
+#
+# python emu_train.py <config .ini> <LSST_Y1|LSST_Y3|LSST_Y6|LSST_Y10> <box file> <N> <Npc> <order> <emulator file> [nproc]
+#   box file rows: parameter lo hi, names as in cosmolike_libs.py (omega_m, bias_0, source_z_bias_3, ...),
+#   all other parameters stay at the fiducial values of the survey year.
+#   N Latin hypercube points are evaluated with datav_batch in nproc forked workers and kept in
+#   <emulator file>.train (parameter vector and data vector per row); N = 0 refits the existing .train file.
+#   Npc principal components, polynomials of total degree <= order: order needs N well above the
+#   number of terms, (Npar+order)!/(Npar! order!).
+#
+# in the sampler: sample_main(..., emulator=<emulator file>, emu_check_every=1000, emu_tolerance=0.1)
+#   emu_tolerance is the largest Delta chi^2 between emulated and exact data vector (inverse covariance of the config)
+
+def fiducial_vector(survey):
+    icp = InputCosmologyParams.fiducial()
+    inp = InputNuisanceParams.fiducial(survey)
+    return icp.names()+inp.names(), np.array(icp.convert_to_vector()+inp.convert_to_vector())
+
+def read_box(filename, names):
+    lo = np.zeros(len(names))
+    hi = np.zeros(len(names))
+    for line in open(filename):
+        w = line.split()
+        if len(w) == 0 or w[0].startswith('#'):
+            continue
+        if w[0] not in names or float(w[2]) <= float(w[1]):
+            print("emu_train: invalid box row '%s'" % line.strip())
+            sys.exit(1)
+        k = names.index(w[0])
+        lo[k],hi[k] = float(w[1]),float(w[2])
+    return lo,hi
+
+def latin_hypercube(N, lo, hi, seed=1):
+    # one point per stratum of every varied parameter
+    rng = np.random.RandomState(seed)
+    varied = np.where(hi > lo)[0]
+    x = np.zeros((N,len(varied)))
+    for j in range(len(varied)):
+        x[:,j] = (rng.permutation(N)+rng.uniform(size=N))/N
+    return varied, lo[varied]+x*(hi[varied]-lo[varied])
+
+def as_pointer(a):
+    return a.ctypes.data_as(ctypes.POINTER(double))
+
+if __name__ == "__main__":
+    if len(sys.argv) not in [8,9]:
+        print("usage: python emu_train.py <config .ini> <LSST_Y1|LSST_Y3|LSST_Y6|LSST_Y10> <box file> <N> <Npc> <order> <emulator file> [nproc]")
+        sys.exit(1)
+    N,Npc,order = int(sys.argv[4]),int(sys.argv[5]),int(sys.argv[6])
+    emufile = sys.argv[7]
+    nproc = int(sys.argv[8]) if len(sys.argv) > 8 else 1
+    initfromconfig(sys.argv[1])
+    names,fid = fiducial_vector(sys.argv[2])
+    lo,hi = read_box(sys.argv[3],names)
+    ndata = getNdata()
+    if N > 0:
+        varied,x = latin_hypercube(N,lo,hi)
+        par = np.tile(fid,(N,1))
+        par[:,varied] = x
+        datav = np.zeros((N,ndata))
+        datavbatch(N,as_pointer(par),as_pointer(datav),nproc)
+        np.savetxt(emufile+'.train',np.hstack([par,datav]),header='%s %s: %d parameters, %d data points' % (sys.argv[1],sys.argv[2],len(names),ndata))
+    else:
+        if not os.path.exists(emufile+'.train'):
+            print("emu_train: N = 0 but no %s" % (emufile+'.train'))
+            sys.exit(1)
+        rows = np.atleast_2d(np.loadtxt(emufile+'.train'))
+        if rows.shape[1] != len(names)+ndata:
+            print("emu_train: %s has %d columns, expected %d" % (emufile+'.train',rows.shape[1],len(names)+ndata))
+            sys.exit(1)
+        N = rows.shape[0]
+        par = np.ascontiguousarray(rows[:,:len(names)])
+        datav = np.ascontiguousarray(rows[:,len(names):])
+    trainemulator(N,as_pointer(par),as_pointer(datav),as_pointer(lo),as_pointer(hi),Npc,order,emufile)
@@ -0,0 +1,408 @@
+// PCA + polynomial emulator of the model data vector, trained on exact data vectors over a parameter box
+// training: datav_batch evaluates the exact data vectors of N parameter vectors in forked workers,
+// train_emulator standardizes every data vector element, keeps the leading Npc principal components
+// of the training set and fits each PC amplitude with a polynomial of total degree <= order in the
+// varied parameters (rescaled to [-1,1] on the box); the result is written to an emulator file.
+// log_multi_like (model_data_vector) uses the emulator after init_emulator(file,check_every,tolerance) for parameter vectors
+// inside the box (the fixed parameters have to equal their training values), otherwise the exact model.
+// Every check_every-th emulated call is compared to the exact data vector; if the deviation in units of the
+// data errors, Delta chi^2 = (emu-exact)^T C^-1 (emu-exact), exceeds tolerance the emulator is switched off
+// and the exact model is used from then on. In log_like_batch the forked workers only emulate, the calls are
+// counted and the checks run in the parent (emu_batch_check), so counters and switch-off persist.
+// The emulated data vector enters the compressed or the full chi^2 alike, see log_multi_like.
+
+#define EMU_NPAR 67 // input_cosmo_params followed by input_nuisance_params, as in log_like_vector
+
+typedef struct {
+  int active;
+  int Ndata, Npar, Npc, order, Nterm;
+  int index[EMU_NPAR]; //position of the varied parameters in the parameter vector
+  double lo[EMU_NPAR], hi[EMU_NPAR]; //box of the varied parameters
+  double fixed[EMU_NPAR]; //training values of all parameters
+  int *powers; //[Nterm][Npar]
+  double *mean, *scale; //[Ndata]
+  double *pc; //[Npc][Ndata]
+  double *coef; //[Npc][Nterm]
+  double *exact; //[Ndata], work space of the accuracy check
+  int check_every;
+  double tolerance, max_error;
+  long calls, checks;
+}emulatorpara;
+
+emulatorpara emulator = {0, 0, 0, 0, 0, 0, {0}, {0.}, {0.}, {0.}, NULL, NULL, NULL, NULL, NULL, NULL, 0, 0., 0., 0, 0};
+
+int set_like_params(double *p);
+void set_data_all(likecontext *ctx, double *data);
+void datav_batch(int N, double *par, double *datav, int Nproc);
+void train_emulator(int N, double *par, double *datav, double *lo, double *hi, int Npc, int order, char *filename);
+void init_emulator(char *filename, int check_every, double tolerance);
+void emu_check(likecontext *ctx, double *pred);
+void emu_batch_check(int N, double *par, double *result, double *model, int Nproc);
+double log_like_vector(double *p);
+void log_like_batch(int N, double *par, double *result, int Nproc);
+
+// exact data vectors of the parameter vectors par[i*67..i*67+66] in datav[i*like.Ndata..], NAN for rejected parameters
+// forked workers as in log_like_batch, the first vector is evaluated in the calling process
+void datav_batch(int N, double *par, double *datav, int Nproc)
+{
+  int i,k,n,status,failed=0,Ndata=like.Ndata;
+  double *shared;
+  pid_t *pid;
+
+  if (N <= 0) return;
+  shared=mmap(NULL,N*Ndata*sizeof(double),PROT_READ|PROT_WRITE,MAP_SHARED|MAP_ANONYMOUS,-1,0);
+  if (shared==MAP_FAILED){
+    printf("datav_batch: mmap failed, evaluating serially\n");
+    shared=datav;
+    Nproc=1;
+  }
+  for (i=0;i<N*Ndata; i++) shared[i]=NAN;
+  if (set_like_params(par)) set_data_all(like_ctx,shared);
+  if (Nproc <= 1 || N == 1){
+    for (i=1;i<N; i++){
+      if (set_like_params(par+EMU_NPAR*i)) set_data_all(like_ctx,shared+i*Ndata);
+    }
+  }
+  else {
+    if (Nproc > N-1) Nproc=N-1;
+    pid=malloc(Nproc*sizeof(pid_t));
+    for (k=0;k<Nproc; k++){
+      pid[k]=fork();
+      if (pid[k]==0){
+        for (i=1+k;i<N; i+=Nproc){
+          if (set_like_params(par+EMU_NPAR*i)) set_data_all(like_ctx,shared+i*Ndata);
+        }
+        _exit(0);
+      }
+      if (pid[k]<0){
+        printf("datav_batch: fork failed, evaluating worker %d serially\n",k);
+        for (i=1+k;i<N; i+=Nproc){
+          if (set_like_params(par+EMU_NPAR*i)) set_data_all(like_ctx,shared+i*Ndata);
+        }
+      }
+    }
+    for (k=0;k<Nproc; k++){
+      if (pid[k]<=0) continue;
+      waitpid(pid[k],&status,0);
+      if (!WIFEXITED(status) || WEXITSTATUS(status)!=0) failed++;
+    }
+    if (failed) printf("datav_batch: %d workers failed, their data vectors are set to NAN\n",failed);
+    free(pid);
+  }
+  if (shared!=datav){
+    memcpy(datav,shared,N*Ndata*sizeof(double));
+    munmap(shared,N*Ndata*sizeof(double));
+  }
+  for (i=0,n=0;i<N; i++) if (isnan(datav[i*Ndata])) n++;
+  if (n) printf("datav_batch: %d of %d parameter vectors rejected\n",n,N);
+}
+
+// exponents of all monomials of total degree <= order in Npar variables, returns their number
+int emu_powers(int Npar, int order, int *powers)
+{
+  int k,deg=0,n=0,*e;
+  e=calloc(Npar+1,sizeof(int));
+  while (1){
+    if (powers) for (k=0;k<Npar; k++) powers[n*Npar+k]=e[k];
+    n++;
+    // next exponent vector in odometer order, skipping total degree > order
+    for (k=0;k<Npar; k++){
+      e[k]++; deg++;
+      if (deg<=order) break;
+      deg-=e[k];
+      e[k]=0;
+    }
+    if (k==Npar) break;
+  }
+  free(e);
+  return n;
+}
+
+// monomials f[Nterm] of the rescaled varied parameters of p
+void emu_basis(double *p, double *f)
+{
+  int t,k,m;
+  double x[EMU_NPAR];
+  for (k=0;k<emulator.Npar; k++) x[k]=2.*(p[emulator.index[k]]-emulator.lo[k])/(emulator.hi[k]-emulator.lo[k])-1.;
+  for (t=0;t<emulator.Nterm; t++){
+    f[t]=1.;
+    for (k=0;k<emulator.Npar; k++){
+      for (m=0;m<emulator.powers[t*emulator.Npar+k]; m++) f[t]*=x[k];
+    }
+  }
+}
+
+void emu_alloc(int Ndata, int Npar, int Npc, int order)
+{
+  free(emulator.powers); free(emulator.mean); free(emulator.scale);
+  free(emulator.pc); free(emulator.coef); free(emulator.exact);
+  emulator.Ndata=Ndata;
+  emulator.Npar=Npar;
+  emulator.Npc=Npc;
+  emulator.order=order;
+  emulator.Nterm=emu_powers(Npar,order,NULL);
+  emulator.powers=malloc(emulator.Nterm*(Npar+1)*sizeof(int));
+  emu_powers(Npar,order,emulator.powers);
+  emulator.mean=malloc(Ndata*sizeof(double));
+  emulator.scale=malloc(Ndata*sizeof(double));
+  emulator.pc=malloc(Npc*Ndata*sizeof(double));
+  emulator.coef=malloc(Npc*emulator.Nterm*sizeof(double));
+  emulator.exact=malloc(Ndata*sizeof(double));
+  if (emulator.exact==NULL){
+    printf("emu_alloc: allocation failed\nEXIT\n");
+    exit(1);
+  }
+}
+
+// emulated data vector of p, returns 0 (datav unchanged) if p is outside the training box
+int emu_data_vector(double *p, double *datav)
+{
+  int i,j,k,n;
+  double *f,c;
+  for (k=0,n=0;k<EMU_NPAR; k++){
+    if (n<emulator.Npar && emulator.index[n]==k){
+      if (p[k]<emulator.lo[n] || p[k]>emulator.hi[n]) return 0;
+      n++;
+    }
+    else if (fabs(p[k]-emulator.fixed[k])>1.e-10*fmax(1.,fabs(emulator.fixed[k]))) return 0;
+  }
+  f=malloc(emulator.Nterm*sizeof(double));
+  emu_basis(p,f);
+  for (i=0;i<emulator.Ndata; i++) datav[i]=0.;
+  for (j=0;j<emulator.Npc; j++){
+    for (k=0,c=0.;k<emulator.Nterm; k++) c+=emulator.coef[j*emulator.Nterm+k]*f[k];
+    for (i=0;i<emulator.Ndata; i++) datav[i]+=c*emulator.pc[j*emulator.Ndata+i];
+  }
+  for (i=0;i<emulator.Ndata; i++) datav[i]=emulator.mean[i]+emulator.scale[i]*datav[i];
+  free(f);
+  return 1;
+}
+
+// deviation of the emulated from the exact data vector in units of the data errors, Delta chi^2 with the inverse covariance
+double emu_error(double *emu, double *exact)
+{
+  int i,j;
+  double err=0.,*d;
+  d=malloc(emulator.Ndata*sizeof(double));
+  for (i=0;i<emulator.Ndata; i++) d[i]=emu[i]-exact[i];
+  for (i=0;i<emulator.Ndata; i++){
+    for (j=0;j<emulator.Ndata; j++) err+=d[i]*invcov_read(1,i,j)*d[j];
+  }
+  free(d);
+  return err;
+}
+
+void write_emulator(char *filename)
+{
+  int i,j,k;
+  FILE *F;
+  F=fopen(filename,"w");
+  if (F==NULL){
+    printf("write_emulator: could not open %s\nEXIT\n",filename);
+    exit(1);
+  }
+  fprintf(F,"emulator %d %d %d %d\n",emulator.Ndata,emulator.Npar,emulator.Npc,emulator.order);
+  for (k=0;k<emulator.Npar; k++) fprintf(F,"%d %.17e %.17e\n",emulator.index[k],emulator.lo[k],emulator.hi[k]);
+  for (k=0;k<EMU_NPAR; k++) fprintf(F,"%.17e\n",emulator.fixed[k]);
+  for (i=0;i<emulator.Ndata; i++) fprintf(F,"%.17e %.17e\n",emulator.mean[i],emulator.scale[i]);
+  for (j=0;j<emulator.Npc; j++){
+    for (i=0;i<emulator.Ndata; i++) fprintf(F,"%.17e\n",emulator.pc[j*emulator.Ndata+i]);
+    for (k=0;k<emulator.Nterm; k++) fprintf(F,"%.17e\n",emulator.coef[j*emulator.Nterm+k]);
+  }
+  fclose(F);
+}
+
+// fits the emulator to the exact data vectors datav[N][like.Ndata] at par[N][67] and writes it to filename
+// parameters with hi > lo are varied, all others must be the same in every training vector
+void train_emulator(int N, double *par, double *datav, double *lo, double *hi, int Npc, int order, char *filename)
+{
+  int i,j,k,n,t,Ngood=0,Npar=0,Ndata=like.Ndata,*good;
+  double *Y,*f,sum,var=0.,kept=0.,res=0.,err=-1.,*emu;
+  gsl_matrix *G,*V,*A;
+  gsl_vector *lambda,*tau,*b,*x,*r;
+  gsl_eigen_symmv_workspace *w;
+
+  good=malloc(N*sizeof(int));
+  for (n=0;n<N; n++) if (!isnan(datav[n*Ndata])) good[Ngood++]=n;
+  for (k=0;k<EMU_NPAR; k++) if (hi[k]>lo[k]) Npar++;
+  if (Ngood < 2 || Npc < 1){
+    printf("train_emulator: %d usable training vectors, %d components requested\nEXIT\n",Ngood,Npc);
+    exit(1);
+  }
+  if (Npc > Ngood) Npc=Ngood;
+  emu_alloc(Ndata,Npar,Npc,order);
+  if (emulator.Nterm > Ngood){
+    printf("train_emulator: %d polynomial terms of order %d in %d parameters need more than %d training vectors\nEXIT\n",emulator.Nterm,order,Npar,Ngood);
+    exit(1);
+  }
+  for (k=0,n=0;k<EMU_NPAR; k++){
+    emulator.fixed[k]=par[good[0]*EMU_NPAR+k];
+    if (hi[k]>lo[k]){
+      emulator.index[n]=k;
+      emulator.lo[n]=lo[k];
+      emulator.hi[n]=hi[k];
+      n++;
+    }
+  }
+  // standardized training set Y[Ngood][Ndata]
+  Y=malloc(Ngood*Ndata*sizeof(double));
+  for (i=0;i<Ndata; i++){
+    for (n=0,sum=0.;n<Ngood; n++) sum+=datav[good[n]*Ndata+i];
+    emulator.mean[i]=sum/Ngood;
+    for (n=0,sum=0.;n<Ngood; n++) sum+=pow(datav[good[n]*Ndata+i]-emulator.mean[i],2.);
+    emulator.scale[i]=(sum > 0. ? sqrt(sum/Ngood) : 1.);
+    for (n=0;n<Ngood; n++) Y[n*Ndata+i]=(datav[good[n]*Ndata+i]-emulator.mean[i])/emulator.scale[i];
+  }
+  // principal components from the eigenvectors of the Ngood x Ngood Gram matrix Y Y^T
+  G=gsl_matrix_alloc(Ngood,Ngood);
+  V=gsl_matrix_alloc(Ngood,Ngood);
+  lambda=gsl_vector_alloc(Ngood);
+  for (n=0;n<Ngood; n++){
+    for (t=n;t<Ngood; t++){
+      for (i=0,sum=0.;i<Ndata; i++) sum+=Y[n*Ndata+i]*Y[t*Ndata+i];
+      gsl_matrix_set(G,n,t,sum);
+      gsl_matrix_set(G,t,n,sum);
+    }
+  }
+  w=gsl_eigen_symmv_alloc(Ngood);
+  gsl_eigen_symmv(G,lambda,V,w);
+  gsl_eigen_symmv_free(w);
+  gsl_eigen_symmv_sort(lambda,V,GSL_EIGEN_SORT_VAL_DESC);
+  for (n=0;n<Ngood; n++) var+=fmax(gsl_vector_get(lambda,n),0.);
+  for (j=0;j<Npc; j++){
+    if (gsl_vector_get(lambda,j) <= 1.e-12*gsl_vector_get(lambda,0)) break;
+    kept+=gsl_vector_get(lambda,j);
+  }
+  emulator.Npc=Npc=j;
+  // PC j = Y^T v_j/sqrt(lambda_j), amplitude of training vector n = sqrt(lambda_j) v_nj
+  A=gsl_matrix_alloc(Ngood,emulator.Nterm);
+  tau=gsl_vector_alloc(emulator.Nterm);
+  b=gsl_vector_alloc(Ngood);
+  x=gsl_vector_alloc(emulator.Nterm);
+  r=gsl_vector_alloc(Ngood);
+  f=malloc(emulator.Nterm*sizeof(double));
+  for (n=0;n<Ngood; n++){
+    emu_basis(par+good[n]*EMU_NPAR,f);
+    for (t=0;t<emulator.Nterm; t++) gsl_matrix_set(A,n,t,f[t]);
+  }
+  gsl_linalg_QR_decomp(A,tau);
+  for (j=0;j<Npc; j++){
+    for (i=0;i<Ndata; i++){
+      for (n=0,sum=0.;n<Ngood; n++) sum+=Y[n*Ndata+i]*gsl_matrix_get(V,n,j);
+      emulator.pc[j*Ndata+i]=sum/sqrt(gsl_vector_get(lambda,j));
+    }
+    for (n=0;n<Ngood; n++) gsl_vector_set(b,n,sqrt(gsl_vector_get(lambda,j))*gsl_matrix_get(V,n,j));
+    gsl_linalg_QR_lssolve(A,tau,b,x,r);
+    for (t=0;t<emulator.Nterm; t++) emulator.coef[j*emulator.Nterm+t]=gsl_vector_get(x,t);
+    for (n=0;n<Ngood; n++) res+=pow(gsl_vector_get(r,n),2.);
+  }
+  // training error of the emulated data vectors, if a covariance is set
+  emu=malloc(Ndata*sizeof(double));
+  for (n=0;n<Ngood && strlen(like.INV_FILE) > 0; n++){
+    emu_data_vector(par+good[n]*EMU_NPAR,emu);
+    err=fmax(err,emu_error(emu,datav+good[n]*Ndata));
+  }
+  printf("train_emulator: %d training vectors, %d varied parameters, %d PCs (%.6f of the variance), %d terms of order %d\n",Ngood,Npar,Npc,(var > 0. ? kept/var : 1.),emulator.Nterm,order);
+  printf("train_emulator: rms fit residual %e (standardized units)\n",sqrt(res/(Ngood*Ndata)));
+  if (err >= 0.) printf("train_emulator: largest training error Delta chi^2 %e\n",err);
+  write_emulator(filename);
+  printf("train_emulator: written to %s\n",filename);
+  emulator.active=0;
+  free(emu); free(f); free(Y); free(good);
+  gsl_matrix_free(G); gsl_matrix_free(V); gsl_matrix_free(A);
+  gsl_vector_free(lambda); gsl_vector_free(tau); gsl_vector_free(b); gsl_vector_free(x); gsl_vector_free(r);
+}
+
+// reads an emulator file of train_emulator; check_every = 0 disables the accuracy check
+void init_emulator(char *filename, int check_every, double tolerance)
+{
+  int i,j,k,Ndata,Npar,Npc,order,n=0;
+  char tag[20];
+  FILE *F;
+  F=fopen(filename,"r");
+  if (F==NULL){
+    printf("init_emulator: could not open %s\nEXIT\n",filename);
+    exit(1);
+  }
+  if (fscanf(F,"%19s %d %d %d %d",tag,&Ndata,&Npar,&Npc,&order)!=5 || strcmp(tag,"emulator")!=0){
+    printf("init_emulator: %s is not an emulator file\nEXIT\n",filename);
+    exit(1);
+  }
+  if (Ndata!=like.Ndata){
+    printf("init_emulator: %s has %d data points, the likelihood %d\nEXIT\n",filename,Ndata,like.Ndata);
+    exit(1);
+  }
+  emu_alloc(Ndata,Npar,Npc,order);
+  for (k=0;k<Npar; k++) n+=fscanf(F,"%d %le %le",&emulator.index[k],&emulator.lo[k],&emulator.hi[k]);
+  for (k=0;k<EMU_NPAR; k++) n+=fscanf(F,"%le",&emulator.fixed[k]);
+  for (i=0;i<Ndata; i++) n+=fscanf(F,"%le %le",&emulator.mean[i],&emulator.scale[i]);
+  for (j=0;j<Npc; j++){
+    for (i=0;i<Ndata; i++) n+=fscanf(F,"%le",&emulator.pc[j*Ndata+i]);
+    for (k=0;k<emulator.Nterm; k++) n+=fscanf(F,"%le",&emulator.coef[j*emulator.Nterm+k]);
+  }
+  fclose(F);
+  if (n!=3*Npar+EMU_NPAR+2*Ndata+Npc*(Ndata+emulator.Nterm)){
+    printf("init_emulator: %s is truncated\nEXIT\n",filename);
+    exit(1);
+  }
+  emulator.check_every=check_every;
+  emulator.tolerance=tolerance;
+  emulator.max_error=0.;
+  emulator.calls=0;
+  emulator.checks=0;
+  emulator.active=1;
+  printf("init_emulator: %d varied parameters, %d PCs, order %d, exact check every %d calls, tolerance %e\n",Npar,Npc,order,check_every,tolerance);
+}
+
+// compares the emulated data vector pred with the exact one (left in emulator.exact), switches the emulator off above tolerance
+void emu_compare(likecontext *ctx, double *pred)
+{
+  double err;
+  set_data_all(ctx,emulator.exact);
+  err=emu_error(pred,emulator.exact);
+  emulator.checks++;
+  emulator.max_error=fmax(emulator.max_error,err);
+  if (err > emulator.tolerance){
+    printf("emulator: Delta chi^2 %e above tolerance %e after %ld calls, using the exact model\n",err,emulator.tolerance,emulator.calls);
+    emulator.active=0;
+  }
+}
+
+// counts an emulated data vector pred and compares every check_every-th one with the exact model (replacing pred)
+void emu_check(likecontext *ctx, double *pred)
+{
+  emulator.calls++;
+  if (emulator.check_every > 0 && emulator.calls%emulator.check_every==0){
+    emu_compare(ctx,pred);
+    memcpy(pred,emulator.exact,emulator.Ndata*sizeof(double));
+  }
+}
+
+// parent side of the check for the points log_like_batch workers emulated (bit 1 of model[i]): adds their calls
+// and runs the checks that fell due on the last emulated points; if the emulator is switched off all
+// emulated points of the batch are evaluated again with the exact model
+void emu_batch_check(int N, double *par, double *result, double *model, int Nproc)
+{
+  int i,n,due,*idx;
+  long calls0=emulator.calls;
+  double *pred,*subpar,*subres;
+
+  idx=malloc(N*sizeof(int));
+  for (i=0,n=0;i<N; i++) if ((int) model[i] & 1) idx[n++]=i;
+  emulator.calls+=n;
+  due=(emulator.check_every > 0 ? emulator.calls/emulator.check_every-calls0/emulator.check_every : 0);
+  pred=malloc(emulator.Ndata*sizeof(double));
+  for (i=n-1;i>=0 && due>0 && emulator.active; i--,due--){
+    if (set_like_params(par+EMU_NPAR*idx[i])==0 || emu_data_vector(par+EMU_NPAR*idx[i],pred)==0) continue;
+    emu_compare(like_ctx,pred);
+  }
+  if (!emulator.active && n > 0){
+    subpar=malloc(n*EMU_NPAR*sizeof(double));
+    subres=malloc(n*sizeof(double));
+    for (i=0;i<n; i++) memcpy(subpar+EMU_NPAR*i,par+EMU_NPAR*idx[i],EMU_NPAR*sizeof(double));
+    log_like_batch(n,subpar,subres,Nproc);
+    for (i=0;i<n; i++) result[idx[i]]=subres[i];
+    free(subpar); free(subres);
+  }
+  free(pred); free(idx);
+}
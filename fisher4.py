@@ -5,6 +5,7 @@ from numpy import linalg as LA
 import matplotlib.pyplot as plt
 import matplotlib.image as mpimg
 from cosmolike_libs import * 
+from fisher_combine import read_fisher, write_fisher, read_prior, combine
 
 write_datav = lib.write_vector_wrapper
 write_datav.argtypes = [ctypes.c_char_p,InputCosmologyParams, InputNuisanceParams]
@@ -30,17 +31,18 @@ def get_fisher_matrix(FM_params, invcov,flag, step_width = 1.0):
     cosmo_sigma = InputCosmologyParams().fiducial_sigma()
     cosmo_prior= InputCosmologyParams().prior_Fisher()
 
-    if flag=='LSST_Y1':
-        nuisance_fid = InputNuisanceParams().fiducial_Y1()                             
-    if flag=='LSST_Y3':
-        nuisance_fid = InputNuisanceParams().fiducial_Y3()                             
-    if flag=='LSST_Y6':
-        nuisance_fid = InputNuisanceParams().fiducial_Y6()                             
-    if flag=='LSST_Y10':    
-        nuisance_fid = InputNuisanceParams().fiducial_Y10()
+    # same survey-year fiducial as the sampler (sample_main), so FM_taylor expands around its starting point
+    nuisance_fid = InputNuisanceParams.fiducial(flag)
 
     nuisance_sigma = InputNuisanceParams().fiducial_sigma()
     nuisance_prior = InputNuisanceParams.prior_Fisher()
+    ##fiducial data vector and parameters for the Taylor expansion file, second derivatives along each parameter
+    derivs2 = np.zeros((npar,ndata))
+    steps = np.zeros(npar)
+    par_fid = cosmo_fid.convert_to_vector()+nuisance_fid.convert_to_vector()
+    par_names = InputCosmologyParams().names()+InputNuisanceParams().names()
+    write_datav(file1,cosmo_fid,nuisance_fid)
+    dv0 = np.genfromtxt(file1)[:,1]
     #for x in FM_params: print(getattr(cosmo_fid, x))
     ##Find Fisher Matrix
     for n,p in enumerate(FM_params):
@@ -98,6 +100,7 @@ def get_fisher_matrix(FM_params, invcov,flag, step_width = 1.0):
             getattr(np_var, pshort)[i]= p0+2.*dp
             write_datav(file1,cosmo_fid,np_var)
             dv_pp = np.genfromtxt(file1)[:,1]
+            getattr(np_var, pshort)[i]= p0
         else:
             np_var = nuisance_fid
             p0 = getattr(nuisance_fid,p)
@@ -120,47 +123,59 @@ def get_fisher_matrix(FM_params, invcov,flag, step_width = 1.0):
             setattr(np_var, p, p0+2.*dp)
             write_datav(file1,cosmo_fid,np_var)
             dv_pp = np.genfromtxt(file1)[:,1]
+            setattr(np_var, p, p0)
 
 
         #five point method for the first derivative
         derivs[n,:] = (-dv_pp +8.*dv_p -8.*dv_m+dv_mm)/(12.*dp)
+        derivs2[n,:] = (-dv_pp +16.*dv_p -30.*dv0 +16.*dv_m -dv_mm)/(12.*dp*dp)
+        steps[n] = dp
         if (np.sum(np.abs(derivs[n,:]))==0):
             print("derivate is zero\nEXIT!\n")
             exit(1)
-    #Matrix multiply the 
-    for i in range(0,npar):
-        for j in range(0,npar):
-            FM[i,j] = np.dot(np.dot(invcov,derivs[i,:]),derivs[j,:])
+    #derivatives at the fiducial point, used by init_data_compression for MOPED compression
+    np.savetxt("FM_derivs"+flag, np.column_stack((np.arange(ndata),derivs.T)), fmt='%d'+' %e'*npar, header=' '.join(FM_params))
+    #fiducial data vector with first and second derivatives, Taylor expansion model of taylor.c (init_taylor)
+    header = ' '.join(FM_params)+'\nindex: '+' '.join([str(par_names.index(p)) for p in FM_params])
+    header += '\nstep: '+' '.join(['%.17e' % x for x in steps])+'\nfiducial: '+' '.join(['%.17e' % x for x in par_fid])
+    header += '\nsurvey: '+flag
+    np.savetxt("FM_taylor"+flag, np.column_stack((np.arange(ndata),dv0,derivs.T,derivs2.T)), fmt='%d'+' %.10e'*(1+2*npar), header=header)
+    #F = D C^-1 D^T with C^-1 D^T formed once as a single (ndata x ndata)(ndata x npar) product
+    CinvD = np.dot(invcov,derivs.T)
+    FM = np.dot(derivs,CinvD)
+    FM = 0.5*(FM+FM.T)
     FM += np.diagflat(diag_prior_Fisher)
     return FM,derivs
 
-def FM_analyze(FM,FM_params):
-    n_cosmo = min(7,len(FM_params))
-    #print FM
-    FMinv= LA.inv(FM)
-    covDE=FMinv[np.ix_([3,4],[3,4])]
-    # for n in range(0,len(FM_params)):
-    #     print("sigma(%s) = %e (no sys: %e, umarg: %e)" % (FM_params[n],np.sqrt(FMinv[n,n]),np.sqrt(FMinv_cosmo[n,n]),1./np.sqrt(FM[n,n])))
-    #     print("sigma(%s) = %e (umarg: %e)" % (FM_params[n],np.sqrt(FMinv[n,n]),1./np.sqrt(FM[n,n])))
+def FM_summary(FM,FM_params,n_cosmo=7):
+    # everything derived from one inversion of FM: parameter covariance, marginalized errors,
+    # w0-wa FoM (0 if either is not varied) and the cosmology Fisher block marginalized over the rest
+    FMinv = LA.inv(FM)
+    n_cosmo = min(n_cosmo,len(FM_params))
+    summary = {'FMinv':FMinv, 'sigma':np.sqrt(np.diag(FMinv)), 'FoM':0.}
     ind_w0 = FM_params.index("w0") if "w0" in FM_params else -1 
     ind_wa = FM_params.index("wa") if "wa" in FM_params else -1 
     if ((ind_w0 > -1) & (ind_wa > -1)):
-        FOM = 1./np.sqrt(FMinv[ind_w0,ind_w0]*FMinv[ind_wa,ind_wa] -FMinv[ind_w0,ind_wa]*FMinv[ind_wa,ind_w0])
-        FOM2 = np.power(LA.det(LA.inv(covDE)),0.5)
-        print("FoM = %e %e %d %d" %(FOM,FOM2,ind_wa,ind_w0))
-    return FOM
+        covDE = FMinv[np.ix_([ind_w0,ind_wa],[ind_w0,ind_wa])]
+        summary['FoM'] = 1./np.sqrt(LA.det(covDE))
+    summary['cFM'] = LA.inv(FMinv[0:n_cosmo,0:n_cosmo])
+    return summary
+
+def FM_analyze(FM,FM_params):
+    s = FM_summary(FM,FM_params)
+    # for n in range(0,len(FM_params)):
+    #     print("sigma(%s) = %e (umarg: %e)" % (FM_params[n],s['sigma'][n],1./np.sqrt(FM[n,n])))
+    print("FoM = %e" %(s['FoM']))
+    return s['FoM']
  
 def read_invcov(cov_filename):
-    covfile = np.loadtxt(cov_filename.decode('UTF-8'))
-    ndata = int(np.max(covfile[:,0]))+1
-    invcov = np.zeros((ndata,ndata))
-    for i in range(0,covfile.shape[0]):
-        invcov[int(covfile[i,0]),int(covfile[i,1])]=covfile[i,2]
+    # text "i j value" file or binary covariance container, parsed by the library reader
+    invcov,_ = read_cov(cov_filename, symmetric=False)
     return invcov
 
-def init(file_source_z,file_lens_z,cov_file,Ntomo_lens,survey):
+def init(file_source_z,file_lens_z,cov_file,Ntomo_lens,survey,precision_tier="high"):
     initcosmo()
-    initfisherprecision()
+    initprecision(precision_tier)
     initbins(20,20.0,15000.0,3000.0,21.0,5,int(Ntomo_lens))
     initsurvey(survey)
     initgalaxies(file_source_z,file_lens_z,"gaussian","gaussian","SRD")
@@ -182,23 +197,11 @@ cov_file = "./cov/"+sys.argv[1]+"_area"+sys.argv[2]+"_ng"+sys.argv[3]+"_nl"+sys.
 # print datav_fid 
 # print cov_file 
 
-invcov = init(file_source_z,file_lens_z,cov_file,sys.argv[5],sys.argv[1])
+precision_tier = sys.argv[8] if len(sys.argv) > 8 else "high"
+invcov = init(file_source_z,file_lens_z,cov_file,sys.argv[5],sys.argv[1],precision_tier)
 
-if(sys.argv[1]=='LSST_Y1'):
-    MORPRIOR=np.zeros((3,3))
-    MORPRIOR=[[1302.77777778,1319.88833456,456.13561437],[1319.88833456,1725.21929159,590.65347498],[456.13561437,590.65347498,228.8004921]] 
-
-if(sys.argv[1]=='LSST_Y3'):
-    MORPRIOR=np.zeros((3,3))
-    MORPRIOR=[[1302.77777778,1319.88833456,456.13561437],[1319.88833456,1725.21929159,590.65347498],[456.13561437,590.65347498,228.8004921]] 
-
-if(sys.argv[1]=='LSST_Y6'):
-    MORPRIOR=np.zeros((3,3))
-    MORPRIOR=[[2622.22222222,2839.59646683,893.79987381],[2839.59646683,3454.43840371,1097.45127586],[893.79987381,1097.45127586,424.44951605]]  
-
-if(sys.argv[1]=='LSST_Y10'):
-    MORPRIOR=np.zeros((3,3))
-    MORPRIOR=[[2622.22222222,2839.59646683,893.79987381],[2839.59646683,3454.43840371,1097.45127586],[893.79987381,1097.45127586,424.44951605]] 
+# cluster mass-observable relation prior of the survey year, added by parameter name
+MORPRIOR = read_prior("MOR_"+sys.argv[1])
    
 flag=sys.argv[1]
 
@@ -213,21 +216,15 @@ for i in range(0,1):
     step_width=0.5+i*0.25
     #step_width=1.0
     FM,derivs = get_fisher_matrix(FM_params,invcov,flag,step_width = step_width)
-    Priormat=np.zeros((len(FM_params),len(FM_params))) 
-    PlanckBossJlaH0=np.zeros((7,7))
-
-    if(sys.argv[1]=='LSST_Y1'):
-        Priormat[19:22,19:22]=MORPRIOR
-    if(sys.argv[1]=='LSST_Y3'):
-        Priormat[21:24,21:24]=MORPRIOR
-    if(sys.argv[1]=='LSST_Y6'):
-        Priormat[23:26,23:26]=MORPRIOR
-    if(sys.argv[1]=='LSST_Y10'):
-        Priormat[24:27,24:27]=MORPRIOR
-   
-      
-    FM=FM+Priormat
-    FoM=FM_analyze(FM,FM_params)
+    # named Fisher matrix without external priors, input of fisher_combine.py
+    write_fisher("Fishers/FM_%s_area%s_ng%s_nl%s.txt"%(sys.argv[1],sys.argv[2],sys.argv[3],sys.argv[4]),FM_params,FM,{'survey':sys.argv[1]})
+    FM_LSST=FM
+    FM=combine(FM_params,FM_LSST,[MORPRIOR+(1.,)])
+    summary=FM_summary(FM,FM_params)
+    FoM=summary['FoM']
+    print("FoM = %e" %(FoM))
+    for n in range(0,len(FM_params)):
+        print("sigma(%s) = %e" % (FM_params[n],summary['sigma'][n]))
     f.write('\n' + 'mode= %s %s %s %s'%(sys.argv[1],sys.argv[2],sys.argv[3],sys.argv[4]))
     f.write('\n' + 'FoM(excl. S3 prior)=%e'%(FoM))
     
@@ -240,8 +237,7 @@ for i in range(0,1):
         h.write('%e]\n'%(FM[i,j]))
     h.write('\n')
     h.write('\n')
-    iF = LA.inv(FM)
-    cFM = LA.inv(iF[0:7,0:7])
+    cFM = summary['cFM']
     
     g.write('\n' + 'mode= %s %s %s %s'%(sys.argv[1],sys.argv[2],sys.argv[3],sys.argv[4]))
     for i in range(0,7):
@@ -253,32 +249,10 @@ for i in range(0,1):
     g.write('\n')
     g.write('\n')
 
-    PlanckBossJlaH0=np.array([[  8.52889541e+03,   9.34266060e-03,   2.21513407e+00,
-              1.85008170e+01,   6.12185662e+00,   1.17720010e+02,
-              5.30670581e+01],
-           [  9.34266060e-03,   3.34475078e+01,   3.79135616e-01,
-             -8.02192934e-02,   5.88736315e-02,  -8.69202865e+01,
-             -7.08029577e+00],
-           [  2.21513407e+00,   3.79135616e-01,   2.48739187e+02,
-             -7.46022981e+00,  -2.69922217e+00,  -1.19693897e+02,
-              4.78085262e+00],
-           [  1.85008170e+01,  -8.02192934e-02,  -7.46022981e+00,
-              8.42937127e+01,   1.68856256e+01,  -4.89063661e+01,
-             -8.77194357e+00],
-           [  6.12185662e+00,   5.88736315e-02,  -2.69922217e+00,
-              1.68856256e+01,   9.55489400e+00,   5.27704214e+00,
-             -1.38597499e+00],
-           [  1.17720010e+02,  -8.69202865e+01,  -1.19693897e+02,
-             -4.89063661e+01,   5.27704214e+00,   7.17777988e+04,
-              3.08491105e+03],
-           [  5.30670581e+01,  -7.08029577e+00,   4.78085262e+00,
-             -8.77194357e+00,  -1.38597499e+00,   3.08491105e+03,
-              5.32751808e+02]])
-
-    Priormat[0:7,0:7]=PlanckBossJlaH0
-
-    FM=FM+Priormat
-    FoM2=FM_analyze(FM,FM_params)
+    # stage III prior (Planck, BOSS, JLA, H0), see priors/stage3.txt
+    FM=combine(FM_params,FM_LSST,[MORPRIOR+(1.,),read_prior("stage3")+(1.,)])
+    FoM2=FM_summary(FM,FM_params)['FoM']
+    print("FoM (S3 prior) = %e" %(FoM2))
     f.write('\n' + 'FoM(incl. S3 prior)=%e\n'%(FoM2))
 
 f.close()
@@ -0,0 +1,119 @@
+import sys
+import os
+import numpy as np
+from numpy import linalg as LA
+
+# Combines Fisher matrices with named parameter axes: the fisher.py output (Fishers/FM_*.txt)
+# and the external priors of priors/*.txt, aligned by parameter name.
+#
+# python fisher_combine.py <combinations file> <output file> <Fisher files ...>
+#   every Fisher file (one per scenario) is combined with every row of the combinations file,
+#   the output has one line with FoM and marginalized errors per scenario and combination.
+#
+# combinations file rows: name prior[*weight] ... [fix=par1,par2,...]
+#   prior names refer to priors/<prior>.txt, {survey} is replaced by the survey of the scenario,
+#   '-' adds no prior, fix= removes parameters from the Fisher matrix before inverting.
+
+prior_dir = "priors"
+# priors/*.txt use the parameter names of priors.c, the Fisher matrices those of cosmolike_libs.py
+param_alias = {'Omega_m':'omega_m', 'omb':'omega_b'}
+cosmo_params = ['omega_m','sigma_8','n_s','w0','wa','omega_b','h0']
+
+def read_fisher(filename):
+    # matrix plus "# params: ..." and other "# key: value" header lines
+    params = []
+    info = {}
+    for line in open(filename):
+        if not line.startswith('#'):
+            continue
+        key,sep,value = line[1:].partition(':')
+        if not sep:
+            continue
+        if key.strip() == 'params':
+            params = [param_alias.get(p,p) for p in value.split()]
+        else:
+            info[key.strip()] = value.strip()
+    FM = np.atleast_2d(np.loadtxt(filename))
+    if FM.shape != (len(params),len(params)):
+        print("read_fisher: %s has a %dx%d matrix for %d parameters" % (filename,FM.shape[0],FM.shape[1],len(params)))
+        sys.exit(1)
+    return params,FM,info
+
+def write_fisher(filename,params,FM,info={}):
+    header = ''.join(['%s: %s\n' % (k,v) for k,v in sorted(info.items())])
+    np.savetxt(filename, FM, fmt='%.10e', header=header+'params: '+' '.join(params))
+
+def marginalize(params,FM,keep):
+    # Fisher matrix of the parameters keep, marginalized over all others
+    ind = [params.index(p) for p in keep]
+    return list(keep), LA.inv(LA.inv(FM)[np.ix_(ind,ind)])
+
+def fix(params,FM,fixed):
+    ind = [i for i,p in enumerate(params) if p not in fixed]
+    return [params[i] for i in ind], FM[np.ix_(ind,ind)]
+
+def combine(params,FM,fishers):
+    # adds weight*F of every (params,F,weight) in fishers to FM, aligned by name;
+    # parameters not in params are marginalized out of F first
+    FM = np.array(FM,dtype=float)
+    for p,F,w in fishers:
+        common = [x for x in p if x in params]
+        if len(common) == 0:
+            continue
+        if len(common) < len(p):
+            p,F = marginalize(p,F,common)
+        ind = [params.index(x) for x in p]
+        FM[np.ix_(ind,ind)] += w*F
+    return FM
+
+def fisher_summary(params,FM):
+    FMinv = LA.inv(FM)
+    sigma = np.sqrt(np.diag(FMinv))
+    FoM = 0.
+    if ('w0' in params) and ('wa' in params):
+        ind = [params.index('w0'),params.index('wa')]
+        FoM = 1./np.sqrt(LA.det(FMinv[np.ix_(ind,ind)]))
+    return FoM, dict(zip(params,sigma))
+
+def read_combinations(filename):
+    combinations = []
+    for line in open(filename):
+        tok = line.split('#')[0].split()
+        if len(tok) == 0:
+            continue
+        c = {'name':tok[0], 'priors':[], 'fix':[]}
+        for t in tok[1:]:
+            if t.startswith('fix='):
+                c['fix'] = t[4:].split(',')
+            elif t != '-':
+                name,sep,w = t.partition('*')
+                c['priors'].append((name, float(w) if sep else 1.))
+        combinations.append(c)
+    return combinations
+
+prior_cache = {}
+def read_prior(name):
+    if name not in prior_cache:
+        p,F,info = read_fisher(os.path.join(prior_dir,name+".txt"))
+        prior_cache[name] = (p,F)
+    return prior_cache[name]
+
+def combine_all(combinations,fisher_files,out_file):
+    out = open(out_file,'w')
+    out.write('# scenario combination FoM '+' '.join(['sigma(%s)' % p for p in cosmo_params])+'\n')
+    for filename in fisher_files:
+        params,FM,info = read_fisher(filename)
+        survey = info.get('survey','')
+        for c in combinations:
+            priors = [read_prior(name.replace('{survey}',survey))+(w,) for name,w in c['priors']]
+            p,F = fix(params,combine(params,FM,priors),c['fix'])
+            FoM,sigma = fisher_summary(p,F)
+            out.write('%s %s %e' % (os.path.basename(filename),c['name'],FoM))
+            out.write(''.join([' %e' % sigma.get(x,0.) for x in cosmo_params])+'\n')
+    out.close()
+
+if __name__ == "__main__":
+    if len(sys.argv) < 4:
+        print("usage: python fisher_combine.py <combinations file> <output file> <Fisher files ...>")
+        sys.exit(1)
+    combine_all(read_combinations(sys.argv[1]),sys.argv[3:],sys.argv[2])
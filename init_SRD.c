@@ -1,13 +1,20 @@
 double invcov_read(int READ, int ci, int cj);
 double data_read(int READ, int ci);
 void init_data_inv(char *INV_FILE, char *DATA_FILE);
+void init_data_compression(char *DERIV_FILE);
+double compressed_chisqr(double *pred);
+void init_precision(char *tier);
 void init_priors(char *cosmoPrior1, char *cosmoPrior2, char *cosmoPrior3, char *cosmoPrior4);
 void init_survey(char *surveyname);
 void init_galaxies(char *SOURCE_ZFILE, char *LENS_ZFILE, char *lensphotoz, char *sourcephotoz, char *galsample);
+void init_galaxies_parametric(double source_z0, double source_alpha, double lens_z0, double lens_alpha, double zmin, double zmax, char *lensphotoz, char *sourcephotoz, char *galsample);
 void init_cosmo();
 void init_cosmo_runmode(char *runmode);
 void init_binning_fourier(int Ncl, double lmin, double lmax, double lmax_shear, double Rmin_bias, int Ntomo_source,int Ntomo_lens);
 void init_probes(char *probes);
+void init_from_config(char *filename);
+void set_cluster_bins(int Nbin_default);
+void set_cluster_richness_bins();
 
 void set_lens_galaxies_LSST();
 
@@ -22,7 +29,70 @@ void set_equal_tomo_bins();
 void init_IA(char *model,char *lumfct);
 void init_HOD_rm();
 void init_Pdelta();
+void clear_datav_cache(void); //datav_cache.c
 
+// ell grids, model buffer, data, inverse covariance and probe offsets of the current likelihood configuration
+// built by init_probes from the current binning and probe selection, replacing any previous context
+// like_ctx is the context of log_multi_like and compute_data_vector; callers can create further contexts
+// (create_like_context, with their own data and invcov filled in, otherwise read from like.DATA_FILE and
+// like.INV_FILE) for the same configuration and pass them to log_like_context; MOPED compression is global.
+// The other derived state stays in its own globals and is reset by the
+// inits that invalidate it (MOPED compression, data vector cache, Limber grid, overlap/kmax and cluster count
+// tables), the NG covariance table (cov_ng_table.c) is built once per covariance run
+typedef struct {
+  int Ndata;
+  int Ncl;
+  int Ncl_Cluster;
+  double *ell;
+  double *ell_Cluster;
+  double *pred;
+  double *data; //read on first use from like.DATA_FILE
+  double **invcov; //read on first use from like.INV_FILE
+  int start[5]; //offsets of the shear, ggl, clustering, clusterN, clusterWL blocks, -1 if not included
+  int N[5]; //number of elements per block
+  int *probe; //index map: block of data point i (0..4, -1 outside the five blocks)
+  int *z1, *z2; //tomography bins (shear: z1,z2; ggl: zl,zs; clustering: zl,zl; clusterN: zc,-1; clusterWL: zc,zs)
+  int *nN; //richness bin, -1 for galaxy probes
+  int *nl; //ell bin in ell or ell_Cluster, -1 for clusterN
+}likecontext;
+
+char probe_names[5][20]={"shear","ggl","clustering","clusterN","clusterWL"};
+
+likecontext *like_ctx = NULL;
+
+// tomographic overlap and kmax acceptance, evaluated once during init instead of inside the
+// data vector and covariance loops; kmax uses the reference-cosmology distances of test_kmax
+typedef struct {
+  int Ncl;
+  int Nlens;
+  int zoverlap[10][10]; //test_zoverlap(zl,zs)
+  int zoverlap_c[10][10]; //test_zoverlap_c(zc,zs)
+  int **kmax; //test_kmax(ell[nl],zl) on the like.Ncl log-bin centers, [nl][zl]
+  double *ell; //the bin centers of kmax, [nl]
+}overlaptable;
+
+overlaptable overlap = {0, 0, {{0}}, {{0}}, NULL, NULL};
+
+void init_kmax_table();
+int kmax_table(int nl, int zl);
+int kmax_cut(int Ncl, double *ell, int nl, int zl);
+
+likecontext *create_like_context();
+void free_like_context(likecontext *ctx);
+void read_like_context_data(likecontext *ctx);
+double full_chisqr(likecontext *ctx, double *pred);
+void read_like_context_invcov(likecontext *ctx);
+void build_index_map(likecontext *ctx);
+void write_index_map(char *filename);
+int index_shear(int nz, int nl);
+int index_ggl(int nz, int nl);
+int index_clustering(int nz, int nl);
+int index_clusterN(int nzc, int nN);
+int index_cgl(int nz, int nN, int nl);
+int get_N_data(void);
+int get_probe_start(int k);
+int get_probe_N(int k);
+void get_index_map(int *probe, int *z1, int *z2, int *nN, int *nl, double *ell);
 
 
 int count_rows(char* filename,const char delimiter){
@@ -54,53 +124,518 @@ int count_rows(char* filename,const char delimiter){
 
 double invcov_read(int READ, int ci, int cj)
 {
-  int i,j,intspace;
-  static double **inv =0;
-
-  if(READ==0 || inv == 0){
-    inv   = create_double_matrix(0, like.Ndata-1, 0, like.Ndata-1);      
-    FILE *F;
-    F=fopen(like.INV_FILE,"r");
-    for (i=0;i<like.Ndata; i++){
-      for (j=0;j<like.Ndata; j++){
-       fscanf(F,"%d %d %le\n",&intspace,&intspace,&inv[i][j]);  
-     }
-   }
-   fclose(F);
-   printf("FINISHED READING COVARIANCE\n");
- }    
- return inv[ci][cj];
+  if (like_ctx == NULL) like_ctx = create_like_context();
+  if(READ==0 || like_ctx->invcov == NULL) read_like_context_invcov(like_ctx);
+  return like_ctx->invcov[ci][cj];
 }
 
 
 double data_read(int READ, int ci)
+{
+  if (like_ctx == NULL) like_ctx = create_like_context();
+  if(READ==0 || like_ctx->data == NULL) read_like_context_data(like_ctx);
+  return like_ctx->data[ci];
+}
+
+void init_kmax_table()
+{
+  int nl,zl;
+  double logdl,ell;
+
+  if (overlap.kmax != NULL){
+    for (nl=0;nl<overlap.Ncl; nl++) free(overlap.kmax[nl]);
+    free(overlap.kmax);
+    free(overlap.ell);
+  }
+  overlap.Ncl=like.Ncl;
+  overlap.Nlens=tomo.clustering_Nbin;
+  overlap.kmax=malloc(overlap.Ncl*sizeof(int*));
+  overlap.ell=malloc(overlap.Ncl*sizeof(double));
+  logdl=(log(like.lmax)-log(like.lmin))/like.Ncl;
+  for (nl=0;nl<overlap.Ncl; nl++){
+    overlap.kmax[nl]=malloc(overlap.Nlens*sizeof(int));
+    ell=exp(log(like.lmin)+(nl+0.5)*logdl);
+    overlap.ell[nl]=ell;
+    for (zl=0;zl<overlap.Nlens; zl++) overlap.kmax[nl][zl]=test_kmax(ell,zl);
+  }
+}
+
+int kmax_table(int nl, int zl)
+{
+  return overlap.kmax[nl][zl];
+}
+
+// kmax acceptance of ell[nl] for lens bin zl: the table if ell is the bin-center grid it was built on, test_kmax otherwise
+int kmax_cut(int Ncl, double *ell, int nl, int zl)
+{
+  if (Ncl == overlap.Ncl && overlap.ell != NULL && fabs(ell[nl]/overlap.ell[nl]-1.) < 1.e-10) return kmax_table(nl,zl);
+  return test_kmax(ell[nl],zl);
+}
+
+likecontext *create_like_context()
+{
+  int l,k;
+  double darg;
+  likecontext *ctx;
+
+  if (like.Ndata <= 0){
+    printf("create_like_context: like.Ndata=%d, call init_probes first\nEXIT\n",like.Ndata);
+    exit(1);
+  }
+  ctx = malloc(sizeof(likecontext));
+  ctx->Ndata = like.Ndata;
+  ctx->Ncl = like.Ncl;
+  ctx->Ncl_Cluster = Cluster.lbin;
+  ctx->pred = create_double_vector(0, ctx->Ndata-1);
+  ctx->ell = NULL;
+  ctx->ell_Cluster = NULL;
+  ctx->data = NULL;
+  ctx->invcov = NULL;
+  if (ctx->Ncl > 0){
+    ctx->ell = create_double_vector(0, ctx->Ncl-1);
+    darg=(log(like.lmax)-log(like.lmin))/like.Ncl;
+    for (l=0;l<like.Ncl;l++){
+      ctx->ell[l]=exp(log(like.lmin)+(l+0.5)*darg);
+    }
+  }
+  if (ctx->Ncl_Cluster > 0){
+    ctx->ell_Cluster = create_double_vector(0, ctx->Ncl_Cluster-1);
+    darg=(log(Cluster.l_max)-log(Cluster.l_min))/Cluster.lbin;
+    for (l=0;l<Cluster.lbin;l++){
+      ctx->ell_Cluster[l]=exp(log(Cluster.l_min)+(l+0.5)*darg);
+    }
+  }
+  ctx->N[0] = like.shear_shear*like.Ncl*tomo.shear_Npowerspectra;
+  ctx->N[1] = like.shear_pos*like.Ncl*tomo.ggl_Npowerspectra;
+  ctx->N[2] = like.pos_pos*like.Ncl*tomo.clustering_Npowerspectra;
+  ctx->N[3] = like.clusterN*tomo.cluster_Nbin*Cluster.N200_Nbin;
+  ctx->N[4] = like.clusterWL*tomo.cgl_Npowerspectra*Cluster.N200_Nbin*Cluster.lbin;
+  l = 0;
+  for (k=0;k<5; k++){
+    ctx->start[k] = (ctx->N[k] > 0 ? l : -1);
+    l += ctx->N[k];
+  }
+  build_index_map(ctx);
+  return ctx;
+}
+
+// per data point bookkeeping of the layout above, written next to data vectors and covariances
+void build_index_map(likecontext *ctx)
+{
+  int i,nz,nN,nl,k;
+
+  ctx->probe = calloc(ctx->Ndata,sizeof(int));
+  ctx->z1 = calloc(ctx->Ndata,sizeof(int));
+  ctx->z2 = calloc(ctx->Ndata,sizeof(int));
+  ctx->nN = calloc(ctx->Ndata,sizeof(int));
+  ctx->nl = calloc(ctx->Ndata,sizeof(int));
+  for (i=0;i<ctx->Ndata; i++) ctx->probe[i]=ctx->z1[i]=ctx->z2[i]=ctx->nN[i]=ctx->nl[i]=-1;
+  for (k=0;k<3; k++){
+    if (ctx->start[k] < 0) continue;
+    for (nz=0;nz<ctx->N[k]/ctx->Ncl; nz++){
+      for (nl=0;nl<ctx->Ncl; nl++){
+        i=ctx->start[k]+ctx->Ncl*nz+nl;
+        ctx->probe[i]=k;
+        ctx->z1[i]=(k==0 ? Z1(nz) : (k==1 ? ZL(nz) : nz));
+        ctx->z2[i]=(k==0 ? Z2(nz) : (k==1 ? ZS(nz) : nz));
+        ctx->nl[i]=nl;
+      }
+    }
+  }
+  if (ctx->start[3] >= 0){
+    for (nz=0;nz<tomo.cluster_Nbin; nz++){
+      for (nN=0;nN<Cluster.N200_Nbin; nN++){
+        i=ctx->start[3]+Cluster.N200_Nbin*nz+nN;
+        ctx->probe[i]=3;
+        ctx->z1[i]=nz;
+        ctx->nN[i]=nN;
+      }
+    }
+  }
+  if (ctx->start[4] >= 0){
+    for (nz=0;nz<tomo.cgl_Npowerspectra; nz++){
+      for (nN=0;nN<Cluster.N200_Nbin; nN++){
+        for (nl=0;nl<ctx->Ncl_Cluster; nl++){
+          i=ctx->start[4]+(nz*Cluster.N200_Nbin+nN)*ctx->Ncl_Cluster+nl;
+          ctx->probe[i]=4;
+          ctx->z1[i]=ZC(nz);
+          ctx->z2[i]=ZSC(nz);
+          ctx->nN[i]=nN;
+          ctx->nl[i]=nl;
+        }
+      }
+    }
+  }
+}
+
+int index_block(int k)
+{
+  if (like_ctx == NULL || like_ctx->start[k] < 0){
+    printf("index map: %s not part of the data vector, check init_probes\nEXIT\n",probe_names[k]);
+    exit(1);
+  }
+  return like_ctx->start[k];
+}
+
+int index_shear(int nz, int nl){
+  return index_block(0)+like_ctx->Ncl*nz+nl;
+}
+int index_ggl(int nz, int nl){
+  return index_block(1)+like_ctx->Ncl*nz+nl;
+}
+int index_clustering(int nz, int nl){
+  return index_block(2)+like_ctx->Ncl*nz+nl;
+}
+int index_clusterN(int nzc, int nN){
+  return index_block(3)+Cluster.N200_Nbin*nzc+nN;
+}
+int index_cgl(int nz, int nN, int nl){
+  return index_block(4)+(nz*Cluster.N200_Nbin+nN)*like_ctx->Ncl_Cluster+nl;
+}
+
+int get_N_data(void){
+  return like_ctx->Ndata;
+}
+int get_probe_start(int k){
+  return like_ctx->start[k];
+}
+int get_probe_N(int k){
+  return like_ctx->N[k];
+}
+
+// copies the index map into caller-provided arrays of length like.Ndata
+void get_index_map(int *probe, int *z1, int *z2, int *nN, int *nl, double *ell)
+{
+  int i;
+  for (i=0;i<like_ctx->Ndata; i++){
+    probe[i]=like_ctx->probe[i];
+    z1[i]=like_ctx->z1[i];
+    z2[i]=like_ctx->z2[i];
+    nN[i]=like_ctx->nN[i];
+    nl[i]=like_ctx->nl[i];
+    ell[i]=(nl[i] < 0 ? 0. : (probe[i]==4 ? like_ctx->ell_Cluster[nl[i]] : like_ctx->ell[nl[i]]));
+  }
+}
+
+// header: "# Ndata", one "# block name start N" line per block, then "i probe z1 z2 nN nl ell" per data point
+void write_index_map(char *filename)
+{
+  int i,k,*probe,*z1,*z2,*nN,*nl;
+  double *ell;
+  FILE *F;
+
+  F=fopen(filename,"w");
+  if (F == NULL){
+    printf("write_index_map: could not open %s\nEXIT\n",filename);
+    exit(1);
+  }
+  probe=malloc(like_ctx->Ndata*sizeof(int));
+  z1=malloc(like_ctx->Ndata*sizeof(int));
+  z2=malloc(like_ctx->Ndata*sizeof(int));
+  nN=malloc(like_ctx->Ndata*sizeof(int));
+  nl=malloc(like_ctx->Ndata*sizeof(int));
+  ell=malloc(like_ctx->Ndata*sizeof(double));
+  get_index_map(probe,z1,z2,nN,nl,ell);
+  fprintf(F,"# Ndata %d\n",like_ctx->Ndata);
+  for (k=0;k<5; k++) fprintf(F,"# block %s %d %d\n",probe_names[k],like_ctx->start[k],like_ctx->N[k]);
+  fprintf(F,"# i probe z1 z2 nN nl ell\n");
+  for (i=0;i<like_ctx->Ndata; i++){
+    fprintf(F,"%d %d %d %d %d %d %e\n",i,probe[i],z1[i],z2[i],nN[i],nl[i],ell[i]);
+  }
+  fclose(F);
+  free(probe); free(z1); free(z2); free(nN); free(nl); free(ell);
+}
+
+void free_like_context(likecontext *ctx)
+{
+  if (ctx == NULL) return;
+  free_double_vector(ctx->pred, 0, ctx->Ndata-1);
+  if (ctx->ell) free_double_vector(ctx->ell, 0, ctx->Ncl-1);
+  if (ctx->ell_Cluster) free_double_vector(ctx->ell_Cluster, 0, ctx->Ncl_Cluster-1);
+  if (ctx->data) free_double_vector(ctx->data, 0, ctx->Ndata-1);
+  if (ctx->invcov) free_double_matrix(ctx->invcov, 0, ctx->Ndata-1, 0, ctx->Ndata-1);
+  free(ctx->probe); free(ctx->z1); free(ctx->z2); free(ctx->nN); free(ctx->nl);
+  free(ctx);
+}
+
+void read_like_context_invcov(likecontext *ctx)
+{
+  int i;
+  double *M;
+
+  if (ctx->invcov == NULL) ctx->invcov = create_double_matrix(0, ctx->Ndata-1, 0, ctx->Ndata-1);
+  M = malloc((long) ctx->Ndata*ctx->Ndata*sizeof(double));
+  // binary covariance container (array "g") or "i j value" text file
+  if (is_cov_container(like.INV_FILE)){
+    if (cov_container_ndata(like.INV_FILE) != ctx->Ndata){
+      printf("read_like_context_invcov: %s has %d data points, like.Ndata=%d\nEXIT\n",like.INV_FILE,cov_container_ndata(like.INV_FILE),ctx->Ndata);
+      exit(1);
+    }
+    if (read_cov_container(like.INV_FILE,"g",M)) unpack_cov(M,ctx->Ndata);
+  }
+  else read_cov_text(like.INV_FILE,ctx->Ndata,0,0,0,M,NULL);
+  for (i=0;i<ctx->Ndata; i++) memcpy(ctx->invcov[i],M+(long) i*ctx->Ndata,ctx->Ndata*sizeof(double));
+  free(M);
+  printf("FINISHED READING COVARIANCE\n");
+}
+
+void read_like_context_data(likecontext *ctx)
 {
   int i,intspace;
-  static double *data = 0;
-  
-  if(READ==0 || data ==0){
-    data  = create_double_vector(0, like.Ndata-1);      
-    FILE *F;
-    F=fopen(like.DATA_FILE,"r");
-    for (i=0;i<like.Ndata; i++){  
-      fscanf(F,"%d %le\n",&intspace,&data[i]);
+  FILE *F;
+
+  F=fopen(like.DATA_FILE,"r");
+  if (F == NULL){
+    printf("read_like_context_data: file %s not found.\nEXIT\n",like.DATA_FILE);
+    exit(1);
+  }
+  if (ctx->data == NULL) ctx->data = create_double_vector(0, ctx->Ndata-1);
+  for (i=0;i<ctx->Ndata; i++){
+    fscanf(F,"%d %le\n",&intspace,&ctx->data[i]);
+  }
+  fclose(F);
+  printf("FINISHED READING DATA VECTOR\n");
+}
+
+typedef struct {
+  int Nparam;
+  int Ndata; //like.Ndata the compression was built for
+  double **b; //MOPED compression vectors b[a][i], a < Nparam, i < Ndata
+  double *data; //compressed data vector y_a = b_a.data
+  char FILE[500];
+}compressionpara;
+
+compressionpara compression = {0, 0, NULL, NULL, ""};
+
+// drops the compression, log_multi_like then uses the full chi^2 (full_chisqr) until init_data_compression is called again;
+// called when the data vector layout or the covariance changes
+void reset_data_compression()
+{
+  if (compression.Nparam > 0){
+    free_double_matrix(compression.b, 0, compression.Nparam-1, 0, compression.Ndata-1);
+    free_double_vector(compression.data, 0, compression.Nparam-1);
+    printf("data vector compression reset, call init_data_compression again\n");
+  }
+  compression.b = NULL;
+  compression.data = NULL;
+  compression.Nparam = compression.Ndata = 0;
+}
+
+// reads <INV_FILE>_moped if its header "# moped <Ndata> <Nparam> <derivs file>" matches, returns 1 on success
+int read_data_compression(char *DERIV_FILE)
+{
+  int a,i,n=0,Ndata,Nparam,intspace;
+  char deriv[500];
+  FILE *F;
+
+  F=fopen(compression.FILE,"r");
+  if (F == NULL) return 0;
+  if (fscanf(F,"# moped %d %d %499s\n",&Ndata,&Nparam,deriv) != 3 || Ndata != like.Ndata || Nparam < 1 || strcmp(deriv,DERIV_FILE) != 0){
+    printf("%s was built for another data vector or derivatives file, recomputing\n",compression.FILE);
+    fclose(F);
+    return 0;
+  }
+  compression.Nparam = Nparam;
+  compression.Ndata = Ndata;
+  compression.b = create_double_matrix(0, compression.Nparam-1, 0, like.Ndata-1);
+  for (a=0;a<compression.Nparam; a++){
+    for (i=0;i<like.Ndata; i++){
+      n+=fscanf(F,"%d %d %le\n",&intspace,&intspace,&compression.b[a][i]);
+    }
+  }
+  fclose(F);
+  if (n != 3*compression.Nparam*like.Ndata){
+    printf("init_data_compression: %s is truncated\nEXIT\n",compression.FILE);
+    exit(1);
+  }
+  printf("READ COMPRESSION MATRIX FROM %s\n",compression.FILE);
+  return 1;
+}
+
+// MOPED compression (Heavens, Jimenez & Lahav 2000): one statistic per parameter,
+// built from the data vector derivatives at the fiducial point and the inverse covariance.
+// The compression matrix is stored next to the inverse covariance as <INV_FILE>_moped
+// and read back from there if it was built for the same like.Ndata and derivatives file.
+void init_data_compression(char *DERIV_FILE)
+{
+  int a,q,i,j,n=0,intspace;
+  double norm,proj,**mu,**cinv_mu;
+  char line[5000],*p;
+  FILE *F;
+
+  printf("\n");
+  printf("---------------------------------------\n");
+  printf("Initializing data vector compression\n");
+  printf("---------------------------------------\n");
+
+  if (like.Ndata == 0){
+    printf("init_data_compression: call init_probes and init_data_inv first\nEXIT\n");
+    exit(1);
+  }
+  reset_data_compression();
+  sprintf(compression.FILE,"%s_moped",like.INV_FILE);
+
+  if (!read_data_compression(DERIV_FILE)){
+    F=fopen(DERIV_FILE,"r");
+    if (F == NULL){
+      printf("init_data_compression: file %s not found.\nEXIT\n",DERIV_FILE);
+      exit(1);
+    }
+    //header line "# name_1 ... name_Nparam" as written by get_fisher_matrix in fisher.py
+    if (fgets(line,sizeof line,F) == NULL || line[0] != '#'){
+      printf("init_data_compression: %s has no parameter header.\nEXIT\n",DERIV_FILE);
+      exit(1);
+    }
+    compression.Nparam = 0;
+    for (p=strtok(line+1," \t\n"); p != NULL; p=strtok(NULL," \t\n")) compression.Nparam++;
+
+    mu = create_double_matrix(0, compression.Nparam-1, 0, like.Ndata-1);
+    for (i=0;i<like.Ndata; i++){
+      n+=fscanf(F,"%d",&intspace);
+      for (a=0;a<compression.Nparam; a++) n+=fscanf(F,"%le",&mu[a][i]);
     }
     fclose(F);
-    printf("FINISHED READING DATA VECTOR\n");
-  }    
-  return data[ci];
+    if (n != like.Ndata*(1+compression.Nparam)){
+      printf("init_data_compression: %s does not have %d rows of %d columns\nEXIT\n",DERIV_FILE,like.Ndata,1+compression.Nparam);
+      exit(1);
+    }
+    compression.Ndata = like.Ndata;
+
+    cinv_mu = create_double_matrix(0, compression.Nparam-1, 0, like.Ndata-1);
+    for (a=0;a<compression.Nparam; a++){
+      for (i=0;i<like.Ndata; i++){
+        cinv_mu[a][i] = 0.;
+        for (j=0;j<like.Ndata; j++) cinv_mu[a][i] += invcov_read(1,i,j)*mu[a][j];
+      }
+    }
+    //Gram-Schmidt with respect to the covariance metric, so that the y_a are uncorrelated with unit variance
+    compression.b = create_double_matrix(0, compression.Nparam-1, 0, like.Ndata-1);
+    for (a=0;a<compression.Nparam; a++){
+      norm = 0.;
+      for (i=0;i<like.Ndata; i++){
+        compression.b[a][i] = cinv_mu[a][i];
+        norm += mu[a][i]*cinv_mu[a][i];
+      }
+      for (q=0;q<a; q++){
+        proj = 0.;
+        for (i=0;i<like.Ndata; i++) proj += mu[a][i]*compression.b[q][i];
+        for (i=0;i<like.Ndata; i++) compression.b[a][i] -= proj*compression.b[q][i];
+        norm -= proj*proj;
+      }
+      if (norm <= 0.){
+        printf("init_data_compression: derivative %d is degenerate with previous parameters\nEXIT\n",a);
+        exit(1);
+      }
+      for (i=0;i<like.Ndata; i++) compression.b[a][i] /= sqrt(norm);
+    }
+    free_double_matrix(mu,0, compression.Nparam-1, 0, like.Ndata-1);
+    free_double_matrix(cinv_mu,0, compression.Nparam-1, 0, like.Ndata-1);
+
+    F=fopen(compression.FILE,"w");
+    if (F == NULL){
+      printf("init_data_compression: could not write %s\nEXIT\n",compression.FILE);
+      exit(1);
+    }
+    fprintf(F,"# moped %d %d %s\n",like.Ndata,compression.Nparam,DERIV_FILE);
+    for (a=0;a<compression.Nparam; a++){
+      for (i=0;i<like.Ndata; i++) fprintf(F,"%d %d %le\n",a,i,compression.b[a][i]);
+    }
+    fclose(F);
+    printf("WROTE COMPRESSION MATRIX TO %s\n",compression.FILE);
+  }
+
+  compression.data = create_double_vector(0, compression.Nparam-1);
+  for (a=0;a<compression.Nparam; a++){
+    compression.data[a] = 0.;
+    for (i=0;i<like.Ndata; i++) compression.data[a] += compression.b[a][i]*data_read(1,i);
+  }
+  printf("Data vector compressed from %d to %d numbers\n",like.Ndata,compression.Nparam);
 }
 
-void init_fisher_precision()
+double compressed_chisqr(double *pred)
 {
+  int a,i;
+  double y,chisqr=0.;
+  for (a=0;a<compression.Nparam; a++){
+    y = 0.;
+    for (i=0;i<like.Ndata; i++) y += compression.b[a][i]*pred[i];
+    chisqr += (y-compression.data[a])*(y-compression.data[a]);
+  }
+  return chisqr;
+}
+
+// (pred-data) C^-1 (pred-data) with the data and inverse covariance of ctx, read from like.DATA_FILE and
+// like.INV_FILE on first use
+double full_chisqr(likecontext *ctx, double *pred)
+{
+  int i,j;
+  double *d,chisqr=0.;
+  if (ctx->data == NULL) read_like_context_data(ctx);
+  if (ctx->invcov == NULL) read_like_context_invcov(ctx);
+  d=malloc(ctx->Ndata*sizeof(double));
+  for (i=0;i<ctx->Ndata; i++) d[i]=pred[i]-ctx->data[i];
+  for (i=0;i<ctx->Ndata; i++){
+    for (j=0;j<ctx->Ndata; j++) chisqr+=d[i]*ctx->invcov[i][j]*d[j];
+  }
+  free(d);
+  return chisqr;
+}
+
+// named precision presets for look-up table sizes and integration tolerances
+// tolerance factors rescale the compiled-in precision.* values
+// must be called before the first theory evaluation, since tables are allocated on first use
+typedef struct {
+  char name[20];
+  int N_a;
+  int N_k_lin;
+  int N_k_nlin;
+  double tolerance_factor;
+  int N_limber; //a nodes of the batched Limber integrals, limber.c
+}precision_tier;
+
+precision_tier precision_tiers[3] = {
+  {"fast", 20, 500, 500, 10.0, 100},
+  {"standard", 100, 2000, 2000, 1.0, 250},
+  {"high", 200, 5000, 5000, 1.0, 500}
+};
+
+void init_precision(char *tier)
+{
+  static pre precision_default;
+  static int saved = 0;
+  int i,n=-1;
+  clear_datav_cache();
+
   printf("\n");
   printf("-------------------------------------------\n");
-  printf("Initializing Fisher matrix precision\n");
+  printf("Initializing precision: %s\n",tier);
   printf("-------------------------------------------\n");
-  Ntable.N_a=200;
-  Ntable.N_k_lin=5000;
-  Ntable.N_k_nlin=5000;
+  for (i=0;i<3; i++){
+    if (strcmp(tier,precision_tiers[i].name)==0) n=i;
+  }
+  if (n < 0){
+    printf("init_precision: tier %s not defined (fast, standard, high)\nEXIT\n",tier);
+    exit(1);
+  }
+  if (!saved){
+    precision_default = precision;
+    saved = 1;
+  }
+  Ntable.N_a=precision_tiers[n].N_a;
+  Ntable.N_k_lin=precision_tiers[n].N_k_lin;
+  Ntable.N_k_nlin=precision_tiers[n].N_k_nlin;
+  precision.low=precision_default.low*precision_tiers[n].tolerance_factor;
+  precision.medium=precision_default.medium*precision_tiers[n].tolerance_factor;
+  precision.high=precision_default.high*precision_tiers[n].tolerance_factor;
+  precision.insane=precision_default.insane*precision_tiers[n].tolerance_factor;
+  init_limber(precision_tiers[n].N_limber);
   printf("table.N_a=%d, table.N_k_lin=%d, table.N_k_nlin=%d\n",Ntable.N_a, Ntable.N_k_lin, Ntable.N_k_nlin);
+  printf("integration tolerances: %le %le %le %le\n",precision.low,precision.medium,precision.high,precision.insane);
+}
+
+void init_fisher_precision()
+{
+  init_precision("high");
 }
 
 
@@ -117,6 +652,7 @@ void init_cosmo()
 
 void init_cosmo_runmode(char *runmode)
 {
+  clear_datav_cache();
   printf("\n");
   printf("-------------------------------------------\n");
   printf("Initializing Standard Runmode/Cosmology\n");
@@ -129,6 +665,7 @@ void init_cosmo_runmode(char *runmode)
 
 void init_binning_fourier(int Ncl, double lmin, double lmax, double lmax_shear, double Rmin_bias, int Ntomo_source,int Ntomo_lens)
 {
+  clear_datav_cache();
   printf("-------------------------------------------\n");
   printf("Initializing Binning\n");
   printf("-------------------------------------------\n");
@@ -173,23 +710,19 @@ void init_priors(char *cosmoPrior1, char *cosmoPrior2, char *cosmoPrior3, char *
   if(strcmp(cosmoPrior1,"Planck15_BAO_H070p6_JLA_w0wa")==0)like.Aubourg_Planck_BAO_SN=1;
   if(strcmp(cosmoPrior3,"PhotoBAO")==0) like.BAO=1;
 
-  if(strcmp(cosmoPrior4,"stage3")==0) like.SRD=1;
-  if(strcmp(cosmoPrior4,"Y10_SN")==0) like.SRD=2;
-  if(strcmp(cosmoPrior4,"Y10_SL")==0) like.SRD=3;
-  if(strcmp(cosmoPrior4,"Y10_3x2")==0) like.SRD=4;
-  if(strcmp(cosmoPrior4,"Y10_CL")==0) like.SRD=5;
-  if(strcmp(cosmoPrior4,"Y10_ALL")==0) like.SRD=6;
-  
-  if(strcmp(cosmoPrior4,"Y1_SN")==0) like.SRD=7;
-  if(strcmp(cosmoPrior4,"Y1_SL")==0) like.SRD=8;
-  if(strcmp(cosmoPrior4,"Y1_3x2")==0) like.SRD=9;
-  if(strcmp(cosmoPrior4,"Y1_CL")==0) like.SRD=10;
-  if(strcmp(cosmoPrior4,"Y1_ALL")==0) like.SRD=11;
+  // external priors are named combinations of priors/combinations.txt, see priors.c
+  if (!prior_combination_exists(cosmoPrior4)){
+    printf("init_priors: prior %s not defined in %s/combinations.txt\nEXIT\n",cosmoPrior4,PRIOR_DIR);
+    exit(1);
+  }
+  init_prior_registry(cosmoPrior4);
+  like.SRD=(prior_registry.Nparam>0);
 }
 
 
 void init_survey(char *surveyname)
 {
+  clear_datav_cache();
   printf("\n");
   printf("-------------------------------\n");
   printf("Initializing Survey Parameters\n");
@@ -205,6 +738,7 @@ void init_survey(char *surveyname)
 
 void init_galaxies(char *SOURCE_ZFILE, char *LENS_ZFILE, char *lensphotoz, char *sourcephotoz, char *galsample)
 {
+  clear_datav_cache();
   printf("\n");
   printf("-----------------------------------\n");
   printf("Initializing galaxy samples\n");
@@ -227,8 +761,94 @@ void init_galaxies(char *SOURCE_ZFILE, char *LENS_ZFILE, char *lensphotoz, char
   if (strcmp(galsample,"source")==0) set_clphotoz_priors_source();
 }
 
+#define PARAMETRIC_ZDISTR_NBIN 2000
+
+// one in-memory file per sample, reused by later calls; temporary files of the mkstemp fallback are removed at exit
+typedef struct {
+  char name[50];
+  char path[500];
+  int fd;
+  int tmpfile;
+}parametric_zdistr_file;
+
+parametric_zdistr_file parametric_zdistr[2] = {{"source_zdistr", "", -1, 0}, {"lens_zdistr", "", -1, 0}};
+
+void parametric_zdistr_cleanup()
+{
+  int k;
+  for (k=0;k<2; k++){
+    if (parametric_zdistr[k].fd < 0) continue;
+    close(parametric_zdistr[k].fd);
+    if (parametric_zdistr[k].tmpfile) unlink(parametric_zdistr[k].path);
+    parametric_zdistr[k].fd=-1;
+  }
+}
+
+// tabulates the Smail-type n(z) ~ z^2 exp(-(z/z0)^alpha) on PARAMETRIC_ZDISTR_NBIN bins in [zmin,zmax]
+// in the "zlow zmid zhigh n" format of zdistris/, written to the in-memory file (memfd) of sample k (0 source,
+// 1 lens) whose /proc/self/fd path is returned in path; falls back to a temporary file if memfd is unavailable.
+// The core reads the file when the redshift tables are first used, so it stays open until exit.
+void write_parametric_zdistr(char *path, int k, double z0, double alpha, double zmin, double zmax)
+{
+  int i,fd;
+  double dz,z,norm=0.0,*nz;
+  parametric_zdistr_file *pz=&parametric_zdistr[k];
+  FILE *F;
+
+  if (z0 <= 0.0 || alpha <= 0.0 || zmax <= zmin || zmin < 0.0){
+    printf("write_parametric_zdistr: invalid model z0=%le alpha=%le zmin=%le zmax=%le\nEXIT\n",z0,alpha,zmin,zmax);
+    exit(1);
+  }
+  nz=create_double_vector(0,PARAMETRIC_ZDISTR_NBIN-1);
+  dz=(zmax-zmin)/(1.0*PARAMETRIC_ZDISTR_NBIN);
+  for (i=0;i<PARAMETRIC_ZDISTR_NBIN; i++){
+    z=zmin+(i+0.5)*dz;
+    nz[i]=z*z*exp(-pow(z/z0,alpha));
+    norm+=nz[i]*dz;
+  }
+  if (pz->fd < 0){
+    pz->fd=syscall(SYS_memfd_create,pz->name,0);
+    if (pz->fd >= 0) sprintf(pz->path,"/proc/self/fd/%d",pz->fd);
+    else {
+      sprintf(pz->path,"/tmp/%s_XXXXXX",pz->name);
+      pz->fd=mkstemp(pz->path);
+      if (pz->fd < 0){
+        printf("write_parametric_zdistr: could not create %s\nEXIT\n",pz->path);
+        exit(1);
+      }
+      pz->tmpfile=1;
+    }
+    atexit(parametric_zdistr_cleanup);
+  }
+  //rewritten from the start, the duplicate shares the offset and is closed by fclose
+  if (ftruncate(pz->fd,0) != 0 || lseek(pz->fd,0,SEEK_SET) != 0 || (fd=dup(pz->fd)) < 0 || (F=fdopen(fd,"w")) == NULL){
+    printf("write_parametric_zdistr: could not write %s\nEXIT\n",pz->path);
+    exit(1);
+  }
+  for (i=0;i<PARAMETRIC_ZDISTR_NBIN; i++){
+    fprintf(F,"%le %le %le %le\n",zmin+i*dz,zmin+(i+0.5)*dz,zmin+(i+1)*dz,nz[i]/norm);
+  }
+  fclose(F);
+  sprintf(path,"%s",pz->path);
+  free_double_vector(nz,0,PARAMETRIC_ZDISTR_NBIN-1);
+}
+
+// as init_galaxies, with source and lens n(z) given by (z0, alpha) instead of zdistris/ files
+// the redshift look-up tables are built on first use, so the model is fixed once per process
+void init_galaxies_parametric(double source_z0, double source_alpha, double lens_z0, double lens_alpha, double zmin, double zmax, char *lensphotoz, char *sourcephotoz, char *galsample)
+{
+  char source_path[500],lens_path[500];
+
+  write_parametric_zdistr(source_path,0,source_z0,source_alpha,zmin,zmax);
+  write_parametric_zdistr(lens_path,1,lens_z0,lens_alpha,zmin,zmax);
+  printf("parametric n(z): source z0=%le alpha=%le, lens z0=%le alpha=%le, %le < z < %le\n",source_z0,source_alpha,lens_z0,lens_alpha,zmin,zmax);
+  init_galaxies(source_path,lens_path,lensphotoz,sourcephotoz,galsample);
+}
+#undef PARAMETRIC_ZDISTR_NBIN
+
 void init_clusters()
 {
+  clear_datav_cache();
   printf("\n");
   printf("-----------------------------------\n");
   printf("Initializing clusters\n");
@@ -244,12 +864,16 @@ void init_clusters()
  
 void init_probes(char *probes)
 {
+  clear_datav_cache();
+  reset_data_compression(); //built for the previous data vector layout
   printf("\n");
   printf("------------------------------\n");
   printf("Initializing Probes\n");
   printf("------------------------------\n"); 
 
   sprintf(like.probes,"%s",probes);
+  like.shear_shear=like.shear_pos=like.pos_pos=like.clusterN=like.clusterWL=0;
+  like.gk=like.kk=like.ks=0;
   if(strcmp(probes,"clusterN")==0){
     like.Ndata=tomo.cluster_Nbin*Cluster.N200_Nbin;
     like.clusterN=1;
@@ -338,6 +962,9 @@ void init_probes(char *probes)
     printf("Initializing: kk, ks, ss\n");
   }
   printf("Total number of data points like.Ndata=%d\n",like.Ndata);
+  free_like_context(like_ctx);
+  like_ctx = create_like_context();
+  init_kmax_table();
 }
 
 
@@ -349,6 +976,7 @@ void init_data_inv(char *INV_FILE, char *DATA_FILE)
   printf("Initializing data vector and covariance\n");
   printf("---------------------------------------\n");
 
+  reset_data_compression(); //built for the previous covariance
   sprintf(like.INV_FILE,"%s",INV_FILE);
   printf("PATH TO INVCOV: %s\n",like.INV_FILE);
   sprintf(like.DATA_FILE,"%s",DATA_FILE);
@@ -357,6 +985,31 @@ void init_data_inv(char *INV_FILE, char *DATA_FILE)
   init=invcov_read(0,1,1);
 }
 
+// runs the init chain from a configuration file (see config.c)
+void init_from_config(char *filename)
+{
+  clear_datav_cache();
+  read_config(filename);
+  init_cosmo();
+  if (strlen(config.tier) > 0) init_precision(config.tier);
+  init_bandpower(config.bandpower);
+  init_binning_fourier(config.Ncl,config.lmin,config.lmax,config.lmax_shear,config.Rmin_bias,config.source_Nbin,config.lens_Nbin);
+  init_survey(config.survey);
+  if (config.area > 0.) survey.area=config.area;
+  if (config.n_source > 0.) survey.n_gal=config.n_source;
+  if (config.n_lens > 0.) survey.n_lens=config.n_lens;
+  init_tomography(config.source_binning,config.lens_binning);
+  set_tomo_range("lens",config.lens_zmin,config.lens_zmax);
+  if (strcmp(config.source_binning,"user")==0) set_tomo_edges("source",config.Nsource_edges,config.source_edges);
+  if (strcmp(config.lens_binning,"user")==0) set_tomo_edges("lens",config.Nlens_edges,config.lens_edges);
+  init_galaxies(config.source_zfile,config.lens_zfile,config.lens_photoz,config.source_photoz,config.galsample);
+  init_clusters();
+  init_IA(config.IA_model,config.IA_lumfct);
+  init_probes(config.probes);
+  init_priors(config.prior1,config.prior2,config.prior3,config.prior4);
+  if (strlen(config.datav_file) > 0) init_data_inv(config.invcov_file,config.datav_file);
+}
+
 void init_lens_sample(char *lensphotoz, char *galsample)
 {
   if(strcmp(lensphotoz,"none")==0) redshift.clustering_photoz=0;
@@ -407,60 +1060,13 @@ void init_source_sample(char *sourcephotoz)
 
 void set_equal_tomo_bins()
 {
-  int k,j;
-  double frac, zi;
-  
-  tomo.shear_Npowerspectra=(int) (tomo.shear_Nbin*(tomo.shear_Nbin+1)/2);
-  
-  zdistr_histo_1(0.1, NULL);
-  int zbins =2000;
-  double da = (redshift.shear_zdistrpar_zmax-redshift.shear_zdistrpar_zmin)/(1.0*zbins);
-  double *sum;
-  sum=create_double_vector(0, zbins);
-  
-  sum[0] = 0.0;
-  for (k = 0, zi = redshift.shear_zdistrpar_zmin; k<zbins; k++,zi+=da){
-    sum[k+1] = sum[k]+zdistr_histo_1(zi, NULL);
-  }
-  
-  tomo.shear_zmin[0] = redshift.shear_zdistrpar_zmin;
-  tomo.shear_zmax[tomo.shear_Nbin-1] = redshift.shear_zdistrpar_zmax;
-  printf("\n");
-  printf("Source Sample - Tomographic Bin limits:\n");
-  for(k=0;k<tomo.shear_Nbin-1;k++){
-    frac=(k+1.)/(1.*tomo.shear_Nbin)*sum[zbins-1];
-    j = 0;
-    while (sum[j]< frac){
-      j++;
-    }
-    tomo.shear_zmax[k] = redshift.shear_zdistrpar_zmin+j*da;
-    tomo.shear_zmin[k+1] = redshift.shear_zdistrpar_zmin+j*da;
-    printf("min=%le max=%le\n",tomo.shear_zmin[k],tomo.shear_zmax[k]);
-  }
-  printf("min=%le max=%le\n",tomo.shear_zmin[tomo.shear_Nbin-1],tomo.shear_zmax[tomo.shear_Nbin-1]);
-  printf("redshift.shear_zdistrpar_zmin=%le max=%le\n",redshift.shear_zdistrpar_zmin,redshift.shear_zdistrpar_zmax);
-  free_double_vector(sum,0,zbins);
+  set_source_tomo_bins();
 }
 
 void set_lens_galaxies_LSST()
 {
   int i,j,n;
-  double zmax=1.2;
-  double zmin=0.2;
-  double dtomo;
-  tomo.clustering_Npowerspectra = tomo.clustering_Nbin;
-  
-  dtomo=(zmax-zmin)/tomo.clustering_Nbin;
-
-  printf("\n");
-  printf("Lens Sample: LSST redmagic- Tomographic Bin limits:\n");
-  for (i =0; i < tomo.clustering_Nbin ; i++){
-    tomo.clustering_zmin[i] = zmin+i*dtomo;
-    tomo.clustering_zmax[i] = tomo.clustering_zmin[i]+dtomo;
-    printf("min=%le max=%le\n",tomo.clustering_zmin[i],tomo.clustering_zmax[i]);
-  }
-  tomo.clustering_zmax[tomo.clustering_Nbin-1] = zmax;
-  printf("\n");
+  set_lens_tomo_bins();
 
   printf("Setting Galaxy Bias using predefined values:\n");
   printf("In agreement with compute data vector routines:\n");
@@ -475,8 +1081,9 @@ void set_lens_galaxies_LSST()
   printf("%d %d\n",tomo.clustering_Nbin,tomo.shear_Nbin);
   for (i = 0; i < tomo.clustering_Nbin; i++){
     for(j = 0; j<tomo.shear_Nbin;j++){
-      n += test_zoverlap(i,j);
-      printf("GGL combinations zl=%d zs=%d accept=%d\n",i,j,test_zoverlap(i,j));
+      overlap.zoverlap[i][j] = test_zoverlap(i,j);
+      n += overlap.zoverlap[i][j];
+      printf("GGL combinations zl=%d zs=%d accept=%d\n",i,j,overlap.zoverlap[i][j]);
     }
   }
 
@@ -486,6 +1093,43 @@ void set_lens_galaxies_LSST()
 
 
 
+// cluster redshift bins from [clusters] z_edges, default: Nbin_default bins of width 0.2 starting at z=0.2
+void set_cluster_bins(int Nbin_default)
+{
+  int i;
+  double zedges_default[6] = {0.2,0.4,0.6,0.8,1.0,1.2};
+  if (config.Ncluster_zedges > 1){
+    tomo.cluster_Nbin = config.Ncluster_zedges-1;
+    for (i = 0; i < tomo.cluster_Nbin; i++){
+      tomo.cluster_zmin[i] = config.cluster_zedges[i];
+      tomo.cluster_zmax[i] = config.cluster_zedges[i+1];
+    }
+  }
+  else {
+    tomo.cluster_Nbin = Nbin_default; // number of cluster redshift bins
+    for (i = 0; i < tomo.cluster_Nbin; i++){
+      tomo.cluster_zmin[i] = zedges_default[i];
+      tomo.cluster_zmax[i] = zedges_default[i+1];
+    }
+  }
+}
+
+// richness bins from [clusters] richness_edges, default 20,30,45,70,120,220
+// note that bin boundaries need to be integers!
+void set_cluster_richness_bins()
+{
+  int i;
+  clear_datav_cache();
+  Cluster.N200_Nbin = config.Nrichness_edges-1;
+  Cluster.N200_min = config.richness_edges[0];
+  Cluster.N200_max = config.richness_edges[Cluster.N200_Nbin];
+  for (i = 0; i < Cluster.N200_Nbin; i++){
+    Cluster.N_min[i] = config.richness_edges[i];
+    Cluster.N_max[i] = config.richness_edges[i+1];
+  }
+  reset_cluster_counts();
+}
+
 void set_clusters_LSST_Y10(){
   int i,j;
   //N200->M relationship from Murata et al. (2018)
@@ -507,36 +1151,19 @@ void set_clusters_LSST_Y10(){
   nuisance.cluster_centering_sigma = 0;
   nuisance.cluster_centering_M_pivot = 1.e+14;
   printf("%e %e %e %e %e %e\n",nuisance.cluster_Mobs_lgN0, nuisance.cluster_Mobs_alpha, nuisance.cluster_Mobs_beta, nuisance.cluster_Mobs_sigma0,  nuisance.cluster_Mobs_sigma_qm, nuisance.cluster_Mobs_sigma_qz);
-  tomo.cluster_Nbin = 4; // number of cluster redshift bins
-  tomo.cluster_zmin[0] = 0.2;
-  tomo.cluster_zmax[0] = 0.4;
-  tomo.cluster_zmin[1] = 0.4;
-  tomo.cluster_zmax[1] = 0.6;
-  tomo.cluster_zmin[2] = 0.6;
-  tomo.cluster_zmax[2] = 0.8;
-  tomo.cluster_zmin[3] = 0.8;
-  tomo.cluster_zmax[3] = 1.0;
+  set_cluster_bins(4);
   tomo.cgl_Npowerspectra = 0;// number of cluster-lensing tomography combinations
   for (i = 0; i < tomo.cluster_Nbin; i++){
     for(j = 0; j<tomo.shear_Nbin;j++){
-      tomo.cgl_Npowerspectra += test_zoverlap_c(i,j);
+      overlap.zoverlap_c[i][j] = test_zoverlap_c(i,j);
+      tomo.cgl_Npowerspectra += overlap.zoverlap_c[i][j];
     }
   }
   
-  Cluster.N200_min = 20.;
-  Cluster.N200_max = 220.;
-  Cluster.N200_Nbin = 5;
   strcpy(Cluster.model,"Murata_etal_2018");
-  //upper bin boundaries - note that bin boundaries need to be integers!
-  int Nlist[5] = {30,45,70,120,Cluster.N200_max};
-  Cluster.N_min[0] = Cluster.N200_min;
-  Cluster.N_max[0] = Nlist[0];
-  for (i = 1; i < Cluster.N200_Nbin; i++){
-    Cluster.N_min[i] = Nlist[i-1];
-    Cluster.N_max[i] = Nlist[i];
-  }
- for (i = 0; i < Cluster.N200_Nbin; i++){
-    printf ("Richness bin %d: %e - %e, N(z = 0.3) = %e, N(z = 0.7) = %e\n", i,Cluster.N_min[i],Cluster.N_max[i],N_N200(0,i),N_N200(2,i));
+  set_cluster_richness_bins();
+  for (i = 0; i < Cluster.N200_Nbin; i++){
+    printf ("Richness bin %d: %e - %e, N(z = 0.3) = %e, N(z = 0.7) = %e\n", i,Cluster.N_min[i],Cluster.N_max[i],N_N200_table(0,i),N_N200_table(2,i));
   }
   printf("Clusters set to LSST Y10\n");
   printf("Clusters cgl_Npowerspectra=%d\n",tomo.cgl_Npowerspectra);
@@ -563,34 +1190,19 @@ void set_clusters_LSST_Y1(){
   nuisance.cluster_centering_sigma = 0;
   nuisance.cluster_centering_M_pivot = 1.e+14;
   printf("%e %e %e %e %e %e\n",nuisance.cluster_Mobs_lgN0, nuisance.cluster_Mobs_alpha, nuisance.cluster_Mobs_beta, nuisance.cluster_Mobs_sigma0,  nuisance.cluster_Mobs_sigma_qm, nuisance.cluster_Mobs_sigma_qz);
-  tomo.cluster_Nbin = 3; // number of cluster redshift bins
-  tomo.cluster_zmin[0] = 0.2;
-  tomo.cluster_zmax[0] = 0.4;
-  tomo.cluster_zmin[1] = 0.4;
-  tomo.cluster_zmax[1] = 0.6;
-  tomo.cluster_zmin[2] = 0.6;
-  tomo.cluster_zmax[2] = 0.8;
+  set_cluster_bins(3);
   tomo.cgl_Npowerspectra = 0;// number of cluster-lensing tomography combinations
   for (i = 0; i < tomo.cluster_Nbin; i++){
     for(j = 0; j<tomo.shear_Nbin;j++){
-      tomo.cgl_Npowerspectra += test_zoverlap_c(i,j);
+      overlap.zoverlap_c[i][j] = test_zoverlap_c(i,j);
+      tomo.cgl_Npowerspectra += overlap.zoverlap_c[i][j];
     }
   }
   
-  Cluster.N200_min = 20.;
-  Cluster.N200_max = 220.;
-  Cluster.N200_Nbin = 5;
   strcpy(Cluster.model,"Murata_etal_2018");
-  //upper bin boundaries - note that bin boundaries need to be integers!
-  int Nlist[5] = {30,45,70,120,Cluster.N200_max};
-  Cluster.N_min[0] = Cluster.N200_min;
-  Cluster.N_max[0] = Nlist[0];
-  for (i = 1; i < Cluster.N200_Nbin; i++){
-    Cluster.N_min[i] = Nlist[i-1];
-    Cluster.N_max[i] = Nlist[i];
-  }
- for (i = 0; i < Cluster.N200_Nbin; i++){
-    printf ("Richness bin %d: %e - %e, N(z = 0.3) = %e, N(z = 0.7) = %e\n", i,Cluster.N_min[i],Cluster.N_max[i],N_N200(0,i),N_N200(2,i));
+  set_cluster_richness_bins();
+  for (i = 0; i < Cluster.N200_Nbin; i++){
+    printf ("Richness bin %d: %e - %e, N(z = 0.3) = %e, N(z = 0.7) = %e\n", i,Cluster.N_min[i],Cluster.N_max[i],N_N200_table(0,i),N_N200_table(2,i));
   }
   printf("Clusters set to LSST Y1\n");
   printf("Clusters cgl_Npowerspectra=%d\n",tomo.cgl_Npowerspectra);
@@ -598,7 +1210,8 @@ void set_clusters_LSST_Y1(){
 
 
 void init_Pdelta(char *model,double nexp,double A_factor)
-{  
+{
+  clear_datav_cache();
   sprintf(pdeltaparams.runmode,"%s",model);
   pdeltaparams.DIFF_n=nexp;
   pdeltaparams.DIFF_A=A_factor;
@@ -606,7 +1219,8 @@ void init_Pdelta(char *model,double nexp,double A_factor)
 
 
 void init_IA(char *model,char *lumfct)
-{  
+{
+  clear_datav_cache();
   if(strcmp(lumfct,"GAMA")==0) set_LF_GAMA();
   else if(strcmp(lumfct,"DEEP2")==0) set_LF_DEEP2();
   else {
@@ -642,7 +1256,7 @@ void init_wlphotoz_stage4()
   printf("Source sample: stage 4 photoz uncertainty initialized\n");
   for (i=0;i<10; i++){
     nuisance.bias_zphot_shear[i]=0.0;
-    nuisance.sigma_zphot_shear[i]=0.05; 
+    nuisance.sigma_zphot_shear[i]=config.source_sigma_z; 
     printf("nuisance.bias_zphot_shear[%d]=%le\n",i,nuisance.bias_zphot_shear[i]);
     printf("nuisance.sigma_zphot_shear[%d]=%le\n",i,nuisance.sigma_zphot_shear[i]);
   }
@@ -655,7 +1269,7 @@ void init_clphotoz_LSST_SRD()
   printf("Galaxy sample LSST SRD photoz uncertainty initialized\n");
   for (i=0;i<10; i++){
     nuisance.bias_zphot_clustering[i]=0.0;
-    nuisance.sigma_zphot_clustering[i]=0.03; 
+    nuisance.sigma_zphot_clustering[i]=config.lens_sigma_z; 
     printf("nuisance.bias_zphot_clustering[%d]=%le\n",i,nuisance.bias_zphot_clustering[i]);
     printf("nuisance.sigma_zphot_clustering[%d]=%le\n",i,nuisance.sigma_zphot_clustering[i]);
   }  
@@ -1,5 +1,5 @@
 #!/usr/bin/python
-import sys
+import sys, os, ctypes
 import math, numpy as np
 import matplotlib.pyplot as plt
 import matplotlib.image as mpimg
@@ -13,6 +13,37 @@ data= ['datav/3x2pt_clusterN_clusterWL_LSST_Y1_area7.500000e+03_ng9.800000e+00_n
 outname=['Y1_area7.500000e+03_ng9.800000e+00_nl1.500000e+01','Y1_area1.300000e+04_ng1.210000e+01_nl2.000000e+01','Y1_area1.600000e+04_ng1.510000e+01_nl2.500000e+01','Y3_area1.000000e+04_ng1.510000e+01_nl2.500000e+01','Y3_area1.500000e+04_ng1.890000e+01_nl3.200000e+01','Y3_area2.000000e+04_ng2.350000e+01_nl4.100000e+01','Y6_area1.000000e+04_ng2.030000e+01_nl3.500000e+01','Y6_area1.500000e+04_ng2.350000e+01_nl4.100000e+01','Y6_area2.000000e+04_ng2.690000e+01_nl4.800000e+01','Y10_area1.000000e+04_ng2.690000e+01_nl4.800000e+01','Y10_area1.500000e+04_ng3.080000e+01_nl5.700000e+01','Y10_area2.000000e+04_ng3.500000e+01_nl6.700000e+01']
 
 
+# compiled multithreaded reader for the concatenated covariance archives (covio.c), numpy fallback
+try:
+	covlib = ctypes.cdll.LoadLibrary(os.path.join(os.path.dirname(os.path.abspath(__file__)),"like_fourier.so"))
+	covlib.read_cov_text.argtypes = [ctypes.c_char_p,ctypes.c_int,ctypes.c_int,ctypes.c_int,ctypes.c_int,ctypes.POINTER(ctypes.c_double),ctypes.POINTER(ctypes.c_double)]
+except OSError:
+	covlib = None
+
+def read_cov_archive(filename,ndata):
+	cov = np.zeros((ndata,ndata))
+	if covlib is not None:
+		ng = np.zeros((ndata,ndata))
+		covlib.read_cov_text(filename,ndata,0,1,0,cov.ctypes.data_as(ctypes.POINTER(ctypes.c_double)),ng.ctypes.data_as(ctypes.POINTER(ctypes.c_double)))
+		return cov+ng
+	covfile = np.genfromtxt(filename)
+	print ndata,int(np.max(covfile[:,0])+1)
+	for i in range(0,covfile.shape[0]):
+		cov[int(covfile[i,0]),int(covfile[i,1])] = covfile[i,8]+covfile[i,9]
+		cov[int(covfile[i,1]),int(covfile[i,0])] = covfile[i,8]+covfile[i,9]
+	return cov
+
+# block layout (start, size) from the index map written by like_fourier.c next to each data vector
+def read_index_map(filename):
+	blocks = {}
+	for line in open(filename):
+		w = line.split()
+		if (len(w) == 5 and w[1] == "block"):
+			blocks[w[2]] = (int(w[3]), int(w[4]))
+		if (len(w) == 3 and w[1] == "Ndata"):
+			blocks["Ndata"] = int(w[2])
+	return blocks
+
 
 for k in range(0,12):
 	#scenario Y10 20000 deg^2
@@ -152,6 +183,20 @@ for k in range(0,12):
 	ncluster = nlenscl*nrich 
 	n2ptcl=n2pt+ncluster
 	nclusterN_WL=ncluster+nrich*ngcl*nclgcl
+	nss = nshear*ncl
+	start_pos = (nshear+nggl)*ncl
+	npos = nlens*ncl
+
+	# the constants above are only used for data vectors written without an index map
+	if os.path.isfile(data[k]+".map"):
+		blocks = read_index_map(data[k]+".map")
+		ndata = blocks["Ndata"]
+		nss = blocks["shear"][1]
+		start_pos, npos = blocks["clustering"]
+		n2pt = blocks["clusterN"][0]
+		ncluster = blocks["clusterN"][1]
+		n2ptcl = n2pt+ncluster
+		nclusterN_WL = ncluster+blocks["clusterWL"][1]
 
   	datafile= np.genfromtxt(data[k])
   	mask = np.zeros(ndata)
@@ -160,14 +205,8 @@ for k in range(0,12):
 			mask[i]=1.0
 
   	
-  	covfile = np.genfromtxt(infile[k])
-	cov = np.zeros((ndata,ndata))
-
-	print ndata,n2pt,int(np.max(covfile[:,0])+1)
-
-	for i in range(0,covfile.shape[0]):
-	  	cov[int(covfile[i,0]),int(covfile[i,1])] = covfile[i,8]+covfile[i,9]
-	  	cov[int(covfile[i,1]),int(covfile[i,0])] = covfile[i,8]+covfile[i,9]
+	print ndata,n2pt
+	cov = read_cov_archive(infile[k],ndata)
 	 
 
 	cor = np.zeros((ndata,ndata))
@@ -186,29 +225,29 @@ for k in range(0,12):
 
 
 	# ############### invert shear covariance #################
-	inv = LA.inv(cov[0:nshear*ncl,0:nshear*ncl])
-	a = np.sort(LA.eigvals(cov[0:nshear*ncl,0:nshear*ncl]))
+	inv = LA.inv(cov[0:nss,0:nss])
+	a = np.sort(LA.eigvals(cov[0:nss,0:nss]))
 	print "min+max eigenvalues shear cov:"
 	print np.min(a), np.max(a)
 	outfile = "cov/"+outname[k]+"_shear_shear_inv"
 	f = open(outfile, "w")
-	for i in range(0,nshear*ncl):
+	for i in range(0,nss):
 		inv[i,i]=inv[i,i]*mask[i]
-	  	for j in range(0,nshear*ncl):
+	  	for j in range(0,nss):
 	  		f.write("%d %d %e\n" %(i,j, inv[i,j]))
 	f.close()
 
 	
 	# ############### invert clustering covariance #################
-	inv = LA.inv(cov[(nshear+nggl)*ncl:(nshear+nggl+nlens)*ncl,(nshear+nggl)*ncl:(nshear+nggl+nlens)*ncl])
-	a = np.sort(LA.eigvals(cov[(nshear+nggl)*ncl:(nshear+nggl+nlens)*ncl,(nshear+nggl)*ncl:(nshear+nggl+nlens)*ncl]))
+	inv = LA.inv(cov[start_pos:start_pos+npos,start_pos:start_pos+npos])
+	a = np.sort(LA.eigvals(cov[start_pos:start_pos+npos,start_pos:start_pos+npos]))
 	print "min+max eigenvalues clustering cov:"
 	print np.min(a), np.max(a)
 	outfile = "cov/"+outname[k]+"_pos_pos_inv"
 	f = open(outfile, "w")
-	for i in range(0,nlens*ncl):
-		inv[i,i]=inv[i,i]*mask[(nshear+nggl)*ncl+i]
-		for j in range(0,nlens*ncl):
+	for i in range(0,npos):
+		inv[i,i]=inv[i,i]*mask[start_pos+i]
+		for j in range(0,npos):
 	  		f.write("%d %d %e\n" %(i,j, inv[i,j]))
 	f.close()
 
@@ -7,6 +7,13 @@
 #include <assert.h>
 #include <time.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <pthread.h>
 
 #include <fftw3.h>
 
@@ -40,21 +47,41 @@
 #include "../cosmolike_core/theory/covariances_3D.c"
 #include "../cosmolike_core/theory/covariances_fourier.c"
 #include "../cosmolike_core/theory/covariances_cluster.c"
+#include "tomography.c"
+#include "priors.c"
+#include "limber.c"
+#include "cluster_counts.c"
+#include "cluster_lensing.c"
+#include "config.c"
+#include "covio.c"
 #include "init_SRD.c"
+#include "datav_cache.c"
+#include "emulator.c"
+#include "taylor.c"
 
 
 double C_shear_tomo_sys(double ell,int z1,int z2);
 double C_cgl_tomo_sys(double ell_Cluster,int zl,int nN, int zs);
 double C_gl_tomo_sys(double ell,int zl,int zs);
+void C_shear_tomo_sys_ell(int Ncl, double *ell, int z1, int z2, double *Cl);
+void C_gl_tomo_sys_ell(int Ncl, double *ell, int zl, int zs, double *Cl);
+void C_cl_tomo_ell(int Ncl, double *ell, int z1, int z2, double *Cl);
+void C_IA_lin_ell(int probe, int z1, int z2, double *Cl);
 void set_data_shear(int Ncl, double *ell, double *data, int start);
 void set_data_ggl(int Ncl, double *ell, double *data, int start);
 void set_data_clustering(int Ncl, double *ell, double *data, int start);
 void set_data_cluster_N(double *data, int start);
 void set_data_cgl(double *ell_Cluster, double *data, int start);
+void set_data_all(likecontext *ctx, double *data);
 void compute_data_vector(char *details, double OMM, double S8, double NS, double W0,double WA, double OMB, double H0, double MGSigma, double MGmu, double B1, double B2, double B3, double B4,double B5, double B6, double B7, double B8, double B9, double B10, double SP1, double SP2, double SP3, double SP4, double SP5, double SP6, double SP7, double SP8, double SP9, double SP10, double SPS1, double CP1, double CP2, double CP3, double CP4, double CP5, double CP6, double CP7, double CP8, double CP9, double CP10, double CPS1, double M1, double M2, double M3, double M4, double M5, double M6, double M7, double M8, double M9, double M10, double A_ia, double beta_ia, double eta_ia, double eta_ia_highz, double LF_alpha, double LF_P, double LF_Q, double LF_red_alpha, double LF_red_P, double LF_red_Q, double mass_obs_norm, double mass_obs_slope, double mass_z_slope, double mass_obs_scatter_norm, double mass_obs_scatter_mass_slope, double mass_obs_scatter_z_slope);
 double log_multi_like(double OMM, double S8, double NS, double W0,double WA, double OMB, double H0, double MGSigma, double MGmu, double B1, double B2, double B3, double B4,double B5, double B6, double B7, double B8, double B9, double B10, double SP1, double SP2, double SP3, double SP4, double SP5, double SP6, double SP7, double SP8, double SP9, double SP10, double SPS1, double CP1, double CP2, double CP3, double CP4, double CP5, double CP6, double CP7, double CP8, double CP9, double CP10, double CPS1, double M1, double M2, double M3, double M4, double M5, double M6, double M7, double M8, double M9, double M10, double A_ia, double beta_ia, double eta_ia, double eta_ia_highz, double LF_alpha, double LF_P, double LF_Q, double LF_red_alpha, double LF_red_P, double LF_red_Q, double mass_obs_norm, double mass_obs_slope, double mass_z_slope, double mass_obs_scatter_norm, double mass_obs_scatter_mass_slope, double mass_obs_scatter_z_slope);
 double write_vector_wrapper(char *details, input_cosmo_params ic, input_nuisance_params in);
 double log_like_wrapper(input_cosmo_params ic, input_nuisance_params in);
+double log_like_vector(double *p);
+double log_like_context(likecontext *ctx, double *p);
+void log_like_batch(int N, double *par, double *result, int Nproc);
+double check_limber(char *tier);
+double check_cluster_lensing();
 int get_N_tomo_shear(void);
 int get_N_tomo_clustering(void);
 int get_N_ggl(void);
@@ -111,14 +138,69 @@ double C_cgl_tomo_sys(double ell_Cluster, int zl,int nN, int zs)
 return C;
 }      
 
+// adds the IA==2 linear-alignment terms (0: II+GI of shear, 1: gI of ggl) on the ell rows of the Limber grid,
+// bin-averaged with the same weights as the Limber part in band-power mode;
+// the shear calibration factors do not depend on ell and can multiply the bin average
+void C_IA_lin_ell(int probe, int z1, int z2, double *Cl)
+{
+  int i,s,Nsub=(limber.Nsub > 0 ? limber.Nsub : 1);
+  double l;
+  for (i = 0; i < limber.Ncl; i++){
+    for (s = 0; s < Nsub; s++){
+      l=limber.ell[i*Nsub+s];
+      Cl[i] += limber.bw[i*Nsub+s]*(probe==0 ? C_II_lin_nointerp(l,z1,z2)+C_GI_lin_nointerp(l,z1,z2) : C_gI_lin_nointerp(l,z1,z2));
+    }
+  }
+}
+
+// all ell of one tomography pair, batched when limber_setup was called for these ell (see limber.c)
+void C_shear_tomo_sys_ell(int Ncl, double *ell, int z1, int z2, double *Cl)
+{
+  int i;
+  if (!limber.ready || Ncl!=limber.Ncl){
+    for (i = 0; i < Ncl; i++) Cl[i] = C_shear_tomo_sys(ell[i],z1,z2);
+    return;
+  }
+  limber_C_shear(z1,z2,Cl);
+  if(like.IA==2) C_IA_lin_ell(0,z1,z2,Cl);
+  for (i = 0; i < Ncl; i++){
+    if(like.shearcalib==1) Cl[i] *=(1.0+nuisance.shear_calibration_m[z1])*(1.0+nuisance.shear_calibration_m[z2]);
+  }
+}
+
+void C_gl_tomo_sys_ell(int Ncl, double *ell, int zl, int zs, double *Cl)
+{
+  int i;
+  if (!limber.ready || Ncl!=limber.Ncl){
+    for (i = 0; i < Ncl; i++) Cl[i] = C_gl_tomo_sys(ell[i],zl,zs);
+    return;
+  }
+  limber_C_gl(zl,zs,Cl);
+  if(like.IA==2) C_IA_lin_ell(1,zl,zs,Cl);
+  for (i = 0; i < Ncl; i++){
+    if(like.shearcalib==1) Cl[i] *=(1.0+nuisance.shear_calibration_m[zs]);
+  }
+}
+
+void C_cl_tomo_ell(int Ncl, double *ell, int z1, int z2, double *Cl)
+{
+  int i;
+  if (!limber.ready || Ncl!=limber.Ncl){
+    for (i = 0; i < Ncl; i++) Cl[i] = C_cl_tomo_nointerp(ell[i],z1,z2);
+    return;
+  }
+  limber_C_cl(z1,z2,Cl);
+}
+
 void set_data_shear(int Ncl, double *ell, double *data, int start)
 {
   int i,z1,z2,nz;
-  double a;
+  double Cl[Ncl];
   for (nz = 0; nz < tomo.shear_Npowerspectra; nz++){
     z1 = Z1(nz); z2 = Z2(nz);
+    C_shear_tomo_sys_ell(Ncl,ell,z1,z2,Cl);
     for (i = 0; i < Ncl; i++){
-      if (ell[i]<like.lmax_shear){ data[Ncl*nz+i] = C_shear_tomo_sys(ell[i],z1,z2);}
+      if (ell[i]<like.lmax_shear){ data[Ncl*nz+i] = Cl[i];}
       else {data[Ncl*nz+i] = 0.;}
     }
   }
@@ -127,11 +209,13 @@ void set_data_shear(int Ncl, double *ell, double *data, int start)
 void set_data_ggl(int Ncl, double *ell, double *data, int start)
 {
   int i, zl,zs,nz;  
+  double Cl[Ncl];
   for (nz = 0; nz < tomo.ggl_Npowerspectra; nz++){
     zl = ZL(nz); zs = ZS(nz);
+    C_gl_tomo_sys_ell(Ncl,ell,zl,zs,Cl);
     for (i = 0; i < Ncl; i++){
-      if (test_kmax(ell[i],zl)){
-        data[start+(Ncl*nz)+i] = C_gl_tomo_sys(ell[i],zl,zs);
+      if (kmax_cut(Ncl,ell,i,zl)){
+        data[start+(Ncl*nz)+i] = Cl[i];
       }
       else{
         data[start+(Ncl*nz)+i] = 0.;
@@ -142,10 +226,12 @@ void set_data_ggl(int Ncl, double *ell, double *data, int start)
 
 void set_data_clustering(int Ncl, double *ell, double *data, int start){
   int i, nz;
+  double Cl[Ncl];
   for (nz = 0; nz < tomo.clustering_Npowerspectra; nz++){
     //printf("%d %e %e\n",nz, gbias.b[nz][1],pf_photoz(gbias.b[nz][1],nz));
+    C_cl_tomo_ell(Ncl,ell,nz,nz,Cl);
     for (i = 0; i < Ncl; i++){
-      if (test_kmax(ell[i],nz)){data[start+(Ncl*nz)+i] = C_cl_tomo_nointerp(ell[i],nz,nz);}
+      if (kmax_cut(Ncl,ell,i,nz)){data[start+(Ncl*nz)+i] = Cl[i];}
       else{data[start+(Ncl*nz)+i] = 0.;}
       //printf("%d %d %le %le\n",nz,nz,ell[i],data[Ncl*(tomo.shear_Npowerspectra+tomo.ggl_Npowerspectra + nz)+i]);
     }
@@ -156,7 +242,7 @@ void set_data_cluster_N(double *data, int start){
   int nN, nz;
   for (nz = 0; nz < tomo.cluster_Nbin; nz++){
     for (nN = 0; nN < Cluster.N200_Nbin; nN++){
-      data[start+Cluster.N200_Nbin*nz+nN] = N_N200(nz, nN);
+      data[start+Cluster.N200_Nbin*nz+nN] = N_N200_table(nz, nN);
     }
   }
 }
@@ -165,18 +251,38 @@ void set_data_cluster_N(double *data, int start){
 void set_data_cgl(double *ell_Cluster, double *data, int start)
 {
   int zl,zs,nN,nz,i,j;
+  double Cl[Cluster.lbin];
+  cluster_lensing_setup(Cluster.lbin,ell_Cluster);
   for(nN = 0; nN < Cluster.N200_Nbin; nN++){
     for (nz = 0; nz < tomo.cgl_Npowerspectra; nz++){
       zl = ZC(nz); zs = ZSC(nz);
+      C_cgl_tomo_ell(Cluster.lbin,zl,nN,zs,Cl);
       for (i = 0; i < Cluster.lbin; i++){
         j = start;
         j += (nz*Cluster.N200_Nbin+nN)*Cluster.lbin +i;
-        data[j] = C_cgl_tomo_sys(ell_Cluster[i],zl,nN,zs);
+        data[j] = Cl[i];
+        if(like.shearcalib==1) data[j] *=(1.0+nuisance.shear_calibration_m[zs]);
       }
     }
   }
 }
 
+void set_data_all(likecontext *ctx, double *data)
+{
+  int b,hit[5];
+  // blocks are looked up separately, a nuisance step only recomputes the blocks that depend on it
+  for (b=0;b<5; b++) hit[b]=(ctx->start[b] < 0 || datav_cache_lookup(b, data+ctx->start[b], ctx->N[b]));
+  if(!hit[0] || !hit[1] || !hit[2]) limber_setup(ctx->Ncl, ctx->ell);
+  if(!hit[0]) set_data_shear(ctx->Ncl, ctx->ell, data, ctx->start[0]);
+  if(!hit[1]) set_data_ggl(ctx->Ncl, ctx->ell, data, ctx->start[1]);
+  if(!hit[2]) set_data_clustering(ctx->Ncl, ctx->ell, data, ctx->start[2]);
+  if(!hit[3]) set_data_cluster_N(data, ctx->start[3]);
+  if(!hit[4]) set_data_cgl(ctx->ell_Cluster, data, ctx->start[4]);
+  limber.ready=0;
+  for (b=0;b<5; b++){
+    if (!hit[b]) datav_cache_store(b, data+ctx->start[b], ctx->N[b]);
+  }
+}
 
 int set_cosmology_params(double OMM, double S8, double NS, double W0,double WA, double OMB, double H0, double MGSigma, double MGmu)
 {
@@ -330,194 +436,6 @@ int set_nuisance_gbias(double B1, double B2, double B3, double B4,double B5, dou
 
 
 
-double log_L_SRD_SN_Y1_RENEE() // computed from /Users/teifler/Dropbox/cosmolike_store/LSSTawakens/ReneeSNChains/lsst_y1_jan29_nostarts_varyM_oldomb_rand.txt
-{
-  double log_L = 0.;
-  double param_diff[4];
-  //double inv[4][4]={{3.79965832e+03,-1.67422234e+01, 1.49107053e+03, 2.03605752e+02},{ -1.67422234e+01, 4.73633438e+02,-2.97547647e+00,-2.21008677e-01},{1.49107053e+03,-2.97547647e+00, 7.06767724e+02, 7.78147349e+01},{2.03605752e+02,-2.21008677e-01, 7.78147349e+01, 1.20866157e+01}};
-
-  // double inv[4][4]={{2.54176679e+03,2.52990975e+01,8.90935426e+02,1.36402504e+02},{2.52990975e+01,4.81470268e+02,1.01904094e+01,6.95186662e-01},{8.90935426e+02,1.01904094e+01,4.02864434e+02,4.60275519e+01},{1.36402504e+02,6.95186662e-01,4.60275519e+01,8.41721305e+00}};
-
-  double inv[4][4]={{2.92724944e+03,-2.18583441e+01, 1.31758412e+03, 1.57579361e+02},
- {-2.18583441e+01, 4.63427974e+02,-1.59603150e+01,-8.00922379e-01},
- {1.31758412e+03,-1.59603150e+01, 7.22127857e+02, 6.67792329e+01},
- {1.57579361e+02,-8.00922379e-01, 6.67792329e+01, 9.71021170e+00}};
-  param_diff[0] = cosmology.Omega_m-0.3156; 
-  param_diff[1] = cosmology.h0-0.6727; 
-  param_diff[2] = cosmology.w0+1.0;  
-  param_diff[3] = cosmology.wa;
- 
-  log_L = -0.5*do_matrix_mult_invcov(4,inv,param_diff);
-  return log_L;
- }
-
-double log_L_SRD_SN_Y10_RENEE() // computed from /Users/teifler/Dropbox/cosmolike_store/LSSTawakens/ReneeSNChains/lsst_y10_jan29_nostarts_varyM_oldomb_rand.txt
-{
-  double log_L = 0.;
-  double param_diff[4];
-  
-double inv[4][4]={{1.13549508e+04,-7.56474778e+01,7.30717358e+03,5.90184798e+02},
- { -7.56474778e+01,4.91930625e+02,-4.39988764e+01,-7.28574193e+00},
- {7.30717358e+03,-4.39988764e+01,5.38324084e+03,3.24899498e+02},
- {5.90184798e+02,-7.28574193e+00,3.24899498e+02,3.84274454e+01}};
-
-
-  param_diff[0] = cosmology.Omega_m-0.3156; 
-  param_diff[1] = cosmology.h0-0.6727; 
-  param_diff[2] = cosmology.w0+1.0; 
-  param_diff[3] = cosmology.wa; 
-
-  log_L = -0.5*do_matrix_mult_invcov(4,inv, param_diff);
-  return log_L;
- }
-
-
-
-
-double log_L_SRD_SL_Y1_TOM() // computed from /Users/teifler/Dropbox/cosmolike_store/LSSTawakens/TomSLChains/SL_LSSTY1.txt
-{
-  double log_L = 0.;
-  double param_diff[4];
-  double inv[4][4]={{9.57953440e+01,1.90114212e+01,1.13561665e+00,2.33866782e+02},{1.90114212e+01,1.31631828e+01,-1.88534652e-02,1.45671419e+02},{1.13561665e+00,-1.88534652e-02,6.29296427e-01,-6.10433226e+00},{2.33866782e+02,1.45671419e+02,-6.10433226e+00,2.71769694e+03}};
-
-  param_diff[0] = cosmology.Omega_m-0.3156; 
-  param_diff[1] = cosmology.w0+1.0; 
-  param_diff[2] = cosmology.wa; 
-  param_diff[3] = cosmology.h0-0.6727; 
-  
-  log_L = -0.5*do_matrix_mult_invcov(4,inv, param_diff);
-  return log_L;
- }
-
-double log_L_SRD_SL_Y10_TOM() // computed from /Users/teifler/Dropbox/cosmolike_store/LSSTawakens/TomSLChains/SL_LSSTY10.txt
-{
-  double log_L = 0.;
-  double param_diff[4];
-  double inv[4][4]={{2.44407663e+02,1.31525702e+02,1.62494864e+01,1.03889766e+03},{1.31525702e+02,1.90748959e+02,8.03881315e+00,1.99392208e+03},{1.62494864e+01,8.03881315e+00,2.23917868e+00,-6.64709076e+00},{1.03889766e+03,1.99392208e+03,-6.64709076e+00,3.31389425e+04}};
-
-
-  param_diff[0] = cosmology.Omega_m-0.3156; 
-  param_diff[1] = cosmology.w0+1.0; 
-  param_diff[2] = cosmology.wa; 
-  param_diff[3] = cosmology.h0-0.6727; 
-  
-  log_L = -0.5*do_matrix_mult_invcov(4,inv, param_diff);
-  return log_L;
- }
-
-
-double log_L_SRD_LSST_Y1_clusters() // // including MOR for Y1, see fisher.py
-{
-  double log_L = 0.;
-  double param_diff[7];
-  double inv[7][7]={{3.858101e+04, 3.588867e+04, 2.231543e+03, -9.737292e+02, -2.076847e+02, -1.567836e+03, 5.165868e+02},{3.588867e+04, 4.046241e+04, 2.204910e+03, -4.306084e+02, -1.921012e+02, -1.153062e+03, 4.146891e+02},{2.231543e+03, 2.204910e+03, 4.640472e+02, -3.849041e+01, -1.164098e+01, -2.997845e+02, 8.606974e+01},{-9.737292e+02, -4.306084e+02, -3.849041e+01, 1.057829e+02, 1.234460e+01, 3.159550e+01, -1.021792e+01},{-2.076847e+02, -1.921012e+02, -1.164098e+01, 1.234460e+01, 3.965104e+00, 6.461167e+00, -2.324549e+00},{-1.567836e+03, -1.153062e+03, -2.997845e+02, 3.159550e+01, 6.461167e+00, 9.845550e+04, -2.104350e+02},{5.165868e+02, 4.146891e+02, 8.606974e+01, -1.021792e+01, -2.324549e+00, -2.104350e+02, 2.121782e+02}};
-
-
-  param_diff[0] = cosmology.Omega_m-0.3156; 
-  param_diff[1] = cosmology.sigma_8-0.831;
-  param_diff[2] = cosmology.n_spec-0.9645; 
-  param_diff[3] = cosmology.w0+1.0; 
-  param_diff[4] = cosmology.wa; 
-  param_diff[5] = cosmology.omb-0.0491685; 
-  param_diff[6] = cosmology.h0-0.6727; 
-  
-  log_L = -0.5*do_matrix_mult_invcov(7,inv, param_diff);
-  return log_L;
- }
-
-double log_L_SRD_LSST_Y10_clusters() // including MOR for Y10, see fisher.py
-{
-  double log_L = 0.;
-  double param_diff[7];
-  double inv[7][7]={{8.011883e+04, 7.501415e+04, 4.972257e+03, -1.009514e+03, -2.332928e+02, -4.035026e+03, 1.280726e+03},{7.501415e+04, 9.212235e+04, 5.029562e+03, 1.256229e+03, -8.904458e+00, -3.884022e+03, 1.236633e+03},{4.972257e+03, 5.029562e+03, 8.996244e+02, -1.335280e+01, -1.271912e+01, -9.151661e+02, 2.624954e+02},{-1.009514e+03, 1.256229e+03, -1.335280e+01, 3.943470e+02, 5.659304e+01, -3.776163e+01, 7.168167e+00},{-2.332928e+02, -8.904458e+00, -1.271912e+01, 5.659304e+01, 1.167193e+01, 4.161086e+00, -1.872393e+00},{-4.035026e+03, -3.884022e+03, -9.151661e+02, -3.776163e+01, 4.161086e+00, 1.000908e+05, -6.424232e+02},{1.280726e+03, 1.236633e+03, 2.624954e+02, 7.168167e+00, -1.872393e+00, -6.424232e+02, 3.273443e+02}};
-
-  param_diff[0] = cosmology.Omega_m-0.3156; 
-  param_diff[1] = cosmology.sigma_8-0.831;
-  param_diff[2] = cosmology.n_spec-0.9645; 
-  param_diff[3] = cosmology.w0+1.0; 
-  param_diff[4] = cosmology.wa; 
-  param_diff[5] = cosmology.omb-0.0491685; 
-  param_diff[6] = cosmology.h0-0.6727; 
-  
-  log_L = -0.5*do_matrix_mult_invcov(7,inv, param_diff);
-  return log_L;
- }
-
-double log_L_SRD_stage3_exceptw0wa() 
-{
-  double log_L = 0.;
-  double param_diff[7];
-  double inv[7][7]={{8.52388933e+03,-2.38254882e-03,4.32405053e+00,0.00000000e+00,0.00000000e+00,1.22554260e+02,5.48470403e+01},{-2.38254882e-03,3.34465215e+01,3.86664237e-01,0.00000000e+00,0.00000000e+00,-8.71498515e+01,-7.09315084e+00},{4.32405053e+00,3.86664237e-01,2.47843770e+02,0.00000000e+00,0.00000000e+00,-1.21079947e+02,4.07696833e+00},{0.00000000e+00,0.00000000e+00,0.00000000e+00,0.00000000e+00,0.00000000e+00,0.00000000e+00,0.00000000e+00},{0.00000000e+00,0.00000000e+00,0.00000000e+00,0.00000000e+00,0.00000000e+00,0.00000000e+00,0.00000000e+00},{1.22554260e+02,-8.71498515e+01,-1.21079947e+02,-0.00000000e+00,-0.00000000e+00,7.17126110e+04,3.07891510e+03},{5.48470403e+01,-7.09315084e+00,4.07696833e+00,0.00000000e+00,0.00000000e+00,3.07891510e+03,5.31816639e+02}};
-
-  param_diff[0] = cosmology.Omega_m-0.3156; 
-  param_diff[1] = cosmology.sigma_8-0.831;
-  param_diff[2] = cosmology.n_spec-0.9645; 
-  param_diff[3] = cosmology.w0+1.0; 
-  param_diff[4] = cosmology.wa; 
-  param_diff[5] = cosmology.omb-0.0491685; 
-  param_diff[6] = cosmology.h0-0.6727; 
-  
-  log_L = -0.5*do_matrix_mult_invcov(7,inv, param_diff);
-  return log_L;
- }
-
-double log_L_SRD_stage3() 
-{
-  double log_L = 0.;
-  double param_diff[7];
-  double inv[7][7]={{8.52889541e+03,9.34266060e-03,2.21513407e+00,1.85008170e+01,6.12185662e+00,1.17720010e+02,5.30670581e+01},{9.34266060e-03,3.34475078e+01,3.79135616e-01,-8.02192934e-02,5.88736315e-02,-8.69202865e+01,-7.08029577e+00},{2.21513407e+00,3.79135616e-01,2.48739187e+02,-7.46022981e+00,-2.69922217e+00,-1.19693897e+02,4.78085262e+00},{1.85008170e+01,-8.02192934e-02,-7.46022981e+00,8.42937127e+01,1.68856256e+01,-4.89063661e+01,-8.77194357e+00},{6.12185662e+00,5.88736315e-02,-2.69922217e+00,1.68856256e+01,9.55489400e+00,5.27704214e+00,-1.38597499e+00},{1.17720010e+02,-8.69202865e+01,-1.19693897e+02,-4.89063661e+01,5.27704214e+00,7.17777988e+04,3.08491105e+03},{5.30670581e+01,-7.08029577e+00,4.78085262e+00,-8.77194357e+00,-1.38597499e+00,3.08491105e+03,5.32751808e+02}};
-
-  param_diff[0] = cosmology.Omega_m-0.3156; 
-  param_diff[1] = cosmology.sigma_8-0.831;
-  param_diff[2] = cosmology.n_spec-0.9645; 
-  param_diff[3] = cosmology.w0+1.0; 
-  param_diff[4] = cosmology.wa; 
-  param_diff[5] = cosmology.omb-0.0491685; 
-  param_diff[6] = cosmology.h0-0.6727; 
-  
-  log_L = -0.5*do_matrix_mult_invcov(7,inv, param_diff);
-  return log_L;
- }
-
-
-double log_L_SRD_LSST_Y1_3x2pt() 
-{
-  double log_L = 0.;
-  double param_diff[7];
-  double inv[7][7]={{6.461019e+05, 4.105098e+05, 9.063469e+04, -2.968463e+04, -6.656297e+03, -3.266829e+05, 7.947019e+04},{4.105098e+05, 3.102396e+05, 4.061214e+04, -2.051833e+04, -5.069455e+03, -1.156574e+05, 2.911602e+04},{9.063469e+04, 4.061214e+04, 3.652491e+04, -1.033492e+03, -1.571074e+02, -9.436089e+04, 2.396154e+04},{-2.968463e+04, -2.051833e+04, -1.033492e+03, 2.081364e+03, 4.721662e+02, 7.414854e+03, -1.864708e+03},{-6.656297e+03, -5.069455e+03, -1.571074e+02, 4.721662e+02, 1.200287e+02, 1.340576e+03, -3.293614e+02},{-3.266829e+05, -1.156574e+05, -9.436089e+04, 7.414854e+03, 1.340576e+03, 5.388793e+05, -9.884641e+04},{7.947019e+04, 2.911602e+04, 2.396154e+04, -1.864708e+03, -3.293614e+02, -9.884641e+04, 2.373400e+04}};
-
-
-  param_diff[0] = cosmology.Omega_m-0.3156; 
-  param_diff[1] = cosmology.sigma_8-0.831;
-  param_diff[2] = cosmology.n_spec-0.9645; 
-  param_diff[3] = cosmology.w0+1.0; 
-  param_diff[4] = cosmology.wa; 
-  param_diff[5] = cosmology.omb-0.0491685; 
-  param_diff[6] = cosmology.h0-0.6727; 
-  
-  log_L = -0.5*do_matrix_mult_invcov(7,inv, param_diff);
-  return log_L;
- }
-
-
-double log_L_SRD_LSST_Y10_3x2pt() 
-{
-  double log_L = 0.;
-  double param_diff[7];
-  double inv[7][7]={{1.732125e+06, 1.363116e+06, 2.420885e+05, -6.384395e+04, -1.991510e+04, -7.567872e+05, 1.858361e+05},{1.363116e+06, 1.196537e+06, 1.469326e+05, -5.148233e+04, -1.796618e+04, -4.526364e+05, 1.126267e+05},{2.420885e+05, 1.469326e+05, 1.011204e+05, -1.370858e+03, -4.391526e+02, -2.001808e+05, 5.228884e+04},{-6.384395e+04, -5.148233e+04, -1.370858e+03, 4.153843e+03, 1.137490e+03, 1.286287e+04, -3.253747e+03},{-1.991510e+04, -1.796618e+04, -4.391526e+02, 1.137490e+03, 3.720224e+02, 4.198170e+03, -1.020253e+03},{-7.567872e+05, -4.526364e+05, -2.001808e+05, 1.286287e+04, 4.198170e+03, 8.507285e+05, -1.685201e+05},{1.858361e+05, 1.126267e+05, 5.228884e+04, -3.253747e+03, -1.020253e+03, -1.685201e+05, 4.064231e+04}};
-
-  param_diff[0] = cosmology.Omega_m-0.3156; 
-  param_diff[1] = cosmology.sigma_8-0.831;
-  param_diff[2] = cosmology.n_spec-0.9645; 
-  param_diff[3] = cosmology.w0+1.0; 
-  param_diff[4] = cosmology.wa; 
-  param_diff[5] = cosmology.omb-0.0491685; 
-  param_diff[6] = cosmology.h0-0.6727; 
-  
-  log_L = -0.5*do_matrix_mult_invcov(7,inv, param_diff);
-  return log_L;
- }
-
 double log_L_DESI() 
 {
   double log_L = 0.;
@@ -575,53 +493,57 @@ double log_L_SRD_LSST_CL_EDUARDO() // values for scatter function are "arbitrary
 }
 
 
-double log_multi_like(double OMM, double S8, double NS, double W0,double WA, double OMB, double H0, double MGSigma, double MGmu, double B1, double B2, double B3, double B4,double B5, double B6, double B7, double B8, double B9, double B10, double SP1, double SP2, double SP3, double SP4, double SP5, double SP6, double SP7, double SP8, double SP9, double SP10, double SPS1, double CP1, double CP2, double CP3, double CP4, double CP5, double CP6, double CP7, double CP8, double CP9, double CP10, double CPS1, double M1, double M2, double M3, double M4, double M5, double M6, double M7, double M8, double M9, double M10, double A_ia, double beta_ia, double eta_ia, double eta_ia_highz, double LF_alpha, double LF_P, double LF_Q, double LF_red_alpha, double LF_red_P, double LF_red_Q, double mass_obs_norm, double mass_obs_slope, double mass_z_slope, double mass_obs_scatter_norm, double mass_obs_scatter_mass_slope, double mass_obs_scatter_z_slope)
+// sets cosmology and nuisance parameters from a parameter vector ordered as in log_like_vector, 0 if out of bounds
+int set_like_params(double *p)
 {
-  int i,j,k,m=0,l;
-  static double *pred;
-  static double *ell;
-  static double *ell_Cluster;
-  static double darg;
-  double chisqr,a,log_L_prior=0.0, log_L_GRS=0.0;
-  
-  if(ell==0){
-    pred= create_double_vector(0, like.Ndata-1);
-    ell= create_double_vector(0, like.Ncl-1);
-    darg=(log(like.lmax)-log(like.lmin))/like.Ncl;
-    for (l=0;l<like.Ncl;l++){
-      ell[l]=exp(log(like.lmin)+(l+0.5)*darg);
-    }
-    ell_Cluster= create_double_vector(0, Cluster.lbin-1);
-    darg=(log(Cluster.l_max)-log(Cluster.l_min))/Cluster.lbin;
-    for (l=0;l<Cluster.lbin;l++){
-      ell_Cluster[l]=exp(log(Cluster.l_min)+(l+0.5)*darg);
-    }
-  }
-  if (set_cosmology_params(OMM,S8,NS,W0,WA,OMB,H0,MGSigma,MGmu)==0){
+  if (set_cosmology_params(p[0],p[1],p[2],p[3],p[4],p[5],p[6],p[7],p[8])==0){
     printf("Cosmology out of bounds\n");
-    return -1.0e8;
+    return 0;
   }
-  set_nuisance_shear_calib(M1,M2,M3,M4,M5,M6,M7,M8,M9,M10);
-  if (set_nuisance_shear_photoz(SP1,SP2,SP3,SP4,SP5,SP6,SP7,SP8,SP9,SP10,SPS1)==0){
+  set_nuisance_shear_calib(p[41],p[42],p[43],p[44],p[45],p[46],p[47],p[48],p[49],p[50]);
+  if (set_nuisance_shear_photoz(p[19],p[20],p[21],p[22],p[23],p[24],p[25],p[26],p[27],p[28],p[29])==0){
     printf("Shear photo-z sigma too small\n");
-    return -1.0e8;
+    return 0;
   }
-  if (set_nuisance_clustering_photoz(CP1,CP2,CP3,CP4,CP5,CP6,CP7,CP8,CP9,CP10,CPS1)==0){
+  if (set_nuisance_clustering_photoz(p[30],p[31],p[32],p[33],p[34],p[35],p[36],p[37],p[38],p[39],p[40])==0){
     printf("Clustering photo-z sigma too small\n");
-    return -1.0e8;
+    return 0;
   }
-  if (set_nuisance_ia(A_ia,beta_ia,eta_ia,eta_ia_highz,LF_alpha,LF_P,LF_Q,LF_red_alpha,LF_red_P,LF_red_Q)==0){
+  if (set_nuisance_ia(p[51],p[52],p[53],p[54],p[55],p[56],p[57],p[58],p[59],p[60])==0){
     printf("IA parameters out of bounds\n");
-    return -1.0e8; 
+    return 0;
   }
-  if (set_nuisance_gbias(B1,B2,B3,B4,B5,B6,B7,B8,B9,B10)==0){
+  if (set_nuisance_gbias(p[9],p[10],p[11],p[12],p[13],p[14],p[15],p[16],p[17],p[18])==0){
     printf("Bias out of bounds\n");
-    return -1.0e8;
+    return 0;
   }
-  if (set_nuisance_cluster_Mobs(mass_obs_norm, mass_obs_slope, mass_z_slope, mass_obs_scatter_norm, mass_obs_scatter_mass_slope, mass_obs_scatter_z_slope)==0){
+  if (set_nuisance_cluster_Mobs(p[61],p[62],p[63],p[64],p[65],p[66])==0){
     printf("Mobs out of bounds\n");
-    return -1.0e8;
+    return 0;
   }
+  return 1;
+}
+
+// model data vector of p (set_like_params already applied): Taylor expansion near the fiducial point (taylor.c),
+// emulator inside its training box (emulator.c), full model otherwise
+void model_data_vector(likecontext *ctx, double *p, double *pred)
+{
+  if (taylor.active && taylor_data_vector(p,pred)) return;
+  if (emulator.active && emu_data_vector(p,pred)){
+    emu_check(ctx,pred);
+    return;
+  }
+  set_data_all(ctx,pred);
+}
+
+// log-likelihood of the parameter vector p with the data, inverse covariance and model buffer of ctx;
+// a caller can hold its own context (create_like_context) for another data vector or covariance of the same
+// configuration, the cosmology, survey and tomography settings stay global
+double log_like_context(likecontext *ctx, double *p)
+{
+  double chisqr,log_L_prior=0.0;
+  
+  if (set_like_params(p)==0) return -1.0e8;
        
   //printf("like %le %le %le %le %le %le %le %le\n",cosmology.Omega_m, cosmology.Omega_v,cosmology.sigma_8,cosmology.n_spec,cosmology.w0,cosmology.wa,cosmology.omb,cosmology.h0); 
   // printf("like %le %le %le %le\n",gbias.b[0][0], gbias.b[1][0], gbias.b[2][0], gbias.b[3][0]);    
@@ -648,17 +570,7 @@ double log_multi_like(double OMM, double S8, double NS, double W0,double WA, dou
   
   // log_L_prior+=log_L_DESI();
 
-  if(like.SRD==1 || like.SRD==6 || like.SRD==11) log_L_prior+=log_L_SRD_stage3();
-  if(like.SRD==2 || like.SRD==6) log_L_prior+=1/(1+0.7*0.7)*log_L_SRD_SN_Y10_RENEE();
-  if(like.SRD==3 || like.SRD==6) log_L_prior+=1/(1+0.62*0.62)*log_L_SRD_SL_Y10_TOM();
-  if(like.SRD==4 || like.SRD==6) log_L_prior+=14202.63/18000.0*1/(1+0.62*0.62)*log_L_SRD_LSST_Y10_3x2pt(); 
-  if(like.SRD==5 || like.SRD==6) log_L_prior+=14202.63/18000.0*1/(1+0.62*0.62)*log_L_SRD_LSST_Y10_clusters(); 
-   
-  
-  if(like.SRD==7 || like.SRD==11) log_L_prior+=1/(1+0.7*0.7)*log_L_SRD_SN_Y1_RENEE();
-  if(like.SRD==8 || like.SRD==11) log_L_prior+=1/(1+0.62*0.62)*log_L_SRD_SL_Y1_TOM();
-  if(like.SRD==9 || like.SRD==11) log_L_prior+=11808.28/18000.0*1/(1+0.62*0.62)*log_L_SRD_LSST_Y1_3x2pt(); 
-  if(like.SRD==10 || like.SRD==11) log_L_prior+=11808.28/18000.0*1/(1+0.62*0.62)*log_L_SRD_LSST_Y1_clusters(); 
+  if(like.SRD) log_L_prior+=log_L_prior_registry();
   
   // printf("%d %d %d %d\n",like.BAO,like.wlphotoz,like.clphotoz,like.shearcalib);
   // printf("logl %le %le %le %le\n",log_L_shear_calib(),log_L_wlphotoz(),log_L_clphotoz(),log_L_clusterMobs());
@@ -683,48 +595,34 @@ double log_multi_like(double OMM, double S8, double NS, double W0,double WA, dou
   // if(like.clusterWL==1){
   //   set_data_cgl(ell_Cluster,pred, start);
   // }
-  chisqr=0.0;
-  // for (i=0; i<like.Ndata; i++){
-  //   for (j=0; j<like.Ndata; j++){
-  //     a=(pred[i]-data_read(1,i))*invcov_read(1,i,j)*(pred[j]-data_read(1,j));
-  //     chisqr=chisqr+a;
-  //   }
-  //  //  if (fabs(data_read(1,i)/pred[i]-1.0) >1.e-4){
-  //  // printf("%d %le %le %le\n",i,data_read(1,i),pred[i],data_read(1,i)/pred[i]);
-  //  //  }
-  // }
-  // if (chisqr<0.0){
-  //   printf("errror: chisqr < 0\n");
-  // }
-  // if (chisqr<-1.0) exit(EXIT_FAILURE);
-  
+  model_data_vector(ctx, p, ctx->pred);
+  //compressed likelihood: cost independent of like.Ndata once pred is computed
+  if(compression.Nparam > 0) chisqr=compressed_chisqr(ctx->pred);
+  else chisqr=full_chisqr(ctx,ctx->pred);
+  if (chisqr<0.0){
+    printf("error: chisqr < 0\n");
+  }
   return -0.5*chisqr+log_L_prior;
 }
 
+double log_multi_like(double OMM, double S8, double NS, double W0,double WA, double OMB, double H0, double MGSigma, double MGmu, double B1, double B2, double B3, double B4,double B5, double B6, double B7, double B8, double B9, double B10, double SP1, double SP2, double SP3, double SP4, double SP5, double SP6, double SP7, double SP8, double SP9, double SP10, double SPS1, double CP1, double CP2, double CP3, double CP4, double CP5, double CP6, double CP7, double CP8, double CP9, double CP10, double CPS1, double M1, double M2, double M3, double M4, double M5, double M6, double M7, double M8, double M9, double M10, double A_ia, double beta_ia, double eta_ia, double eta_ia_highz, double LF_alpha, double LF_P, double LF_Q, double LF_red_alpha, double LF_red_P, double LF_red_Q, double mass_obs_norm, double mass_obs_slope, double mass_z_slope, double mass_obs_scatter_norm, double mass_obs_scatter_mass_slope, double mass_obs_scatter_z_slope)
+{
+  double p[EMU_NPAR]={OMM,S8,NS,W0,WA,OMB,H0,MGSigma,MGmu,B1,B2,B3,B4,B5,B6,B7,B8,B9,B10,
+    SP1,SP2,SP3,SP4,SP5,SP6,SP7,SP8,SP9,SP10,SPS1,CP1,CP2,CP3,CP4,CP5,CP6,CP7,CP8,CP9,CP10,CPS1,
+    M1,M2,M3,M4,M5,M6,M7,M8,M9,M10,A_ia,beta_ia,eta_ia,eta_ia_highz,
+    LF_alpha,LF_P,LF_Q,LF_red_alpha,LF_red_P,LF_red_Q,
+    mass_obs_norm,mass_obs_slope,mass_z_slope,mass_obs_scatter_norm,mass_obs_scatter_mass_slope,mass_obs_scatter_z_slope};
+  
+  return log_like_context(like_ctx,p);
+}
+
 
 void compute_data_vector(char *details, double OMM, double S8, double NS, double W0,double WA, double OMB, double H0, double MGSigma, double MGmu, double B1, double B2, double B3, double B4,double B5, double B6, double B7, double B8, double B9, double B10, double SP1, double SP2, double SP3, double SP4, double SP5, double SP6, double SP7, double SP8, double SP9, double SP10, double SPS1, double CP1, double CP2, double CP3, double CP4, double CP5, double CP6, double CP7, double CP8, double CP9, double CP10, double CPS1, double M1, double M2, double M3, double M4, double M5, double M6, double M7, double M8, double M9, double M10, double A_ia, double beta_ia, double eta_ia, double eta_ia_highz, double LF_alpha, double LF_P, double LF_Q, double LF_red_alpha, double LF_red_P, double LF_red_Q, double mass_obs_norm, double mass_obs_slope, double mass_z_slope, double mass_obs_scatter_norm, double mass_obs_scatter_mass_slope, double mass_obs_scatter_z_slope)
 {
     
-  int i,j,k,m=0,l;
-  static double *pred;
-  static double *ell;
-  static double *ell_Cluster;
-  static double darg;
-  double chisqr,a,log_L_prior=0.0;
+  int i;
+  likecontext *ctx=like_ctx;
   
-  if(ell==0){
-    pred= create_double_vector(0, like.Ndata-1);
-    ell= create_double_vector(0, like.Ncl-1);
-    darg=(log(like.lmax)-log(like.lmin))/like.Ncl;
-    for (l=0;l<like.Ncl;l++){
-      ell[l]=exp(log(like.lmin)+(l+0.5)*darg);
-    }
-    ell_Cluster= create_double_vector(0, Cluster.lbin-1);
-    darg=(log(Cluster.l_max)-log(Cluster.l_min))/Cluster.lbin;
-    for (l=0;l<Cluster.lbin;l++){
-      ell_Cluster[l]=exp(log(Cluster.l_min)+(l+0.5)*darg);    
-    }
-  }
 // for (l=0;l<like.Ncl;l++){
 //   printf("%d %le\n",i,ell[l]);
 // }
@@ -736,29 +634,7 @@ void compute_data_vector(char *details, double OMM, double S8, double NS, double
   set_nuisance_gbias(B1,B2,B3,B4,B5,B6,B7,B8,B9,B10);
   set_nuisance_cluster_Mobs(mass_obs_norm, mass_obs_slope, mass_z_slope, mass_obs_scatter_norm, mass_obs_scatter_mass_slope, mass_obs_scatter_z_slope);
   
-  int start=0;  
-  if(like.shear_shear==1) {
-    set_data_shear(like.Ncl, ell, pred, start);
-    start=start+like.Ncl*tomo.shear_Npowerspectra;
-  }
-  if(like.shear_pos==1){
-    //printf("ggl\n");
-    set_data_ggl(like.Ncl, ell, pred, start);
-    start=start+like.Ncl*tomo.ggl_Npowerspectra;
-  } 
-  if(like.pos_pos==1){
-    //printf("clustering\n");
-    set_data_clustering(like.Ncl,ell,pred, start);
-    start=start+like.Ncl*tomo.clustering_Npowerspectra;
-  }
-
-  if(like.clusterN==1){ 
-    set_data_cluster_N(pred,start);
-    start= start+tomo.cluster_Nbin*Cluster.N200_Nbin;
-  }
-  if(like.clusterWL==1){
-    set_data_cgl(ell_Cluster,pred, start);
-  }
+  set_data_all(ctx, ctx->pred);
   FILE *F;
   char filename[300];
   if (strstr(details,"FM") != NULL){
@@ -767,10 +643,12 @@ void compute_data_vector(char *details, double OMM, double S8, double NS, double
   else {sprintf(filename,"datav/%s_%s",like.probes,details);}
   F=fopen(filename,"w");
   for (i=0;i<like.Ndata; i++){  
-    fprintf(F,"%d %le\n",i,pred[i]);
-    //printf("%d %le\n",i,pred[i]);
+    fprintf(F,"%d %le\n",i,ctx->pred[i]);
+    //printf("%d %le\n",i,ctx->pred[i]);
   }
   fclose(F);
+  strcat(filename,".map");
+  write_index_map(filename);
 }
 
 double write_vector_wrapper(char *details, input_cosmo_params ic, input_nuisance_params in)
@@ -812,12 +690,104 @@ double log_like_wrapper(input_cosmo_params ic, input_nuisance_params in)
   return like;
 }
 
- int main(int argc, char** argv)
+// parameter vector ordered as input_cosmo_params followed by input_nuisance_params (67 values)
+double log_like_vector(double *p)
+{
+  return log_multi_like(p[0],p[1],p[2],p[3],p[4],p[5],p[6],p[7],p[8],
+    p[9],p[10],p[11],p[12],p[13],p[14],p[15],p[16],p[17],p[18],
+    p[19],p[20],p[21],p[22],p[23],p[24],p[25],p[26],p[27],p[28],p[29],
+    p[30],p[31],p[32],p[33],p[34],p[35],p[36],p[37],p[38],p[39],p[40],
+    p[41],p[42],p[43],p[44],p[45],p[46],p[47],p[48],p[49],p[50],
+    p[51],p[52],p[53],p[54],
+    p[55],p[56],p[57],p[58],p[59],p[60],
+    p[61],p[62],p[63],p[64],p[65],p[66]);
+}
+
+// evaluates N parameter vectors par[i*67..i*67+66] and writes the log-likelihoods to result
+// the library state (cosmology, nuisance, look-up tables) is global, so calls cannot run in threads;
+// instead Nproc forked workers each take every Nproc-th vector and write into a shared buffer.
+// The first vector is evaluated in the calling process so that all look-up tables are
+// built once and shared copy-on-write by the workers.
+// Workers flag the model used for each point, the emulator accuracy check (emu_batch_check) and the
+// Taylor expansion counters run in the parent.
+void log_like_batch(int N, double *par, double *result, int Nproc)
+{
+  int i,k,status,failed=0;
+  long calls,tcalls,tfallbacks;
+  double *shared,*model;
+  pid_t *pid;
+
+  if (N <= 0) return;
+  result[0]=log_like_vector(par);
+  if (Nproc <= 1 || N == 1){
+    for (i=1;i<N; i++) result[i]=log_like_vector(par+67*i);
+    return;
+  }
+  if (Nproc > N-1) Nproc=N-1;
+  shared=mmap(NULL,2*N*sizeof(double),PROT_READ|PROT_WRITE,MAP_SHARED|MAP_ANONYMOUS,-1,0);
+  if (shared==MAP_FAILED){
+    printf("log_like_batch: mmap failed, evaluating serially\n");
+    for (i=1;i<N; i++) result[i]=log_like_vector(par+67*i);
+    return;
+  }
+  model=shared+N;
+  for (i=0;i<N; i++){
+    shared[i]=-1.0e8;
+    model[i]=0.;
+  }
+  pid=malloc(Nproc*sizeof(pid_t));
+  for (k=0;k<Nproc; k++){
+    pid[k]=fork();
+    if (pid[k]==0){
+      emulator.check_every=0; //counted and checked in the parent
+      for (i=1+k;i<N; i+=Nproc){
+        calls=emulator.calls;
+        tcalls=taylor.calls;
+        tfallbacks=taylor.fallbacks;
+        shared[i]=log_like_vector(par+67*i);
+        // 1: emulated, 2: Taylor expansion tried, 4: outside its trust region
+        model[i]=(emulator.calls > calls)+2*(taylor.calls > tcalls)+4*(taylor.fallbacks > tfallbacks);
+      }
+      _exit(0);
+    }
+    if (pid[k]<0){
+      printf("log_like_batch: fork failed, evaluating worker %d serially\n",k);
+      for (i=1+k;i<N; i+=Nproc) shared[i]=log_like_vector(par+67*i);
+    }
+  }
+  for (k=0;k<Nproc; k++){
+    if (pid[k]<=0) continue;
+    waitpid(pid[k],&status,0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status)!=0) failed++;
+  }
+  if (failed) printf("log_like_batch: %d workers failed, their points are set to -1e8\n",failed);
+  for (i=1;i<N; i++){
+    result[i]=shared[i];
+    taylor.calls+=(((int) model[i] & 2) != 0);
+    taylor.fallbacks+=(((int) model[i] & 4) != 0);
+  }
+  emu_batch_check(N,par,result,model,Nproc);
+  free(pid);
+  munmap(shared,2*N*sizeof(double));
+}
+
+// data vector at the SRD fiducial parameters of the given survey year, photo-z scatter from [survey] source_sigma_z/lens_sigma_z
+void compute_fiducial_data_vector(char *designation, char *details)
 {
-  int hit=atoi(argv[1]);
-  char filename[500],arg1[400],arg2[400];
-  int t;
-  t=hit;
+  if(strcmp(designation,"LSST_Y1") == 0) compute_data_vector(details,0.3156,0.831,0.9645,-1.,0.,0.0491685,0.6727,0.,0.,1.413566e+00,1.567919e+00,1.731037e+00,1.900583e+00,2.074809e+00,1.413566e+00,1.567919e+00,1.731037e+00,1.900583e+00,2.074809e+00,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,config.source_sigma_z,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,config.lens_sigma_z,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,5.92,1.1,-0.47,0.0,0.0,0.0,0.0,0.0,0.0,0.0,3.207,0.993,0.0,0.456,0.0,0.0);
+  else if(strcmp(designation,"LSST_Y3") == 0) compute_data_vector(details,0.3156,0.831,0.9645,-1.,0.,0.0491685,0.6727,0.,0.,1.392398e+00,1.500535e+00,1.613747e+00,1.731037e+00,1.851600e+00,1.974761e+00,2.100003e+00,1.731037e+00,1.900583e+00,2.074809e+00,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,config.source_sigma_z,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,config.lens_sigma_z,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,5.92,1.1,-0.47,0.0,0.0,0.0,0.0,0.0,0.0,0.0,3.207,0.993,0.0,0.456,0.0,0.0);
+  else if(strcmp(designation,"LSST_Y6") == 0) compute_data_vector(details,0.3156,0.831,0.9645,-1.,0.,0.0491685,0.6727,0.,0.,1.380752e+00,1.463865e+00,1.550281e+00,1.639495e+00,1.731037e+00,1.824565e+00,1.919738e+00,2.016299e+00,2.114025e+00,2.074809e+00,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,config.source_sigma_z,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,config.lens_sigma_z,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,5.92,1.1,-0.47,0.0,0.0,0.0,0.0,0.0,0.0,0.0,3.207,0.993,0.0,0.456,0.0,0.0);
+  else if(strcmp(designation,"LSST_Y10") == 0) compute_data_vector(details,0.3156,0.831,0.9645,-1.,0.,0.0491685,0.6727,0.,0.,1.376695e+00,1.451179e+00,1.528404e+00,1.607983e+00,1.689579e+00,1.772899e+00,1.857700e+00,1.943754e+00,2.030887e+00,2.118943e+00,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,config.source_sigma_z,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,config.lens_sigma_z,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,5.92,1.1,-0.47,0.0,0.0,0.0,0.0,0.0,0.0,0.0,3.207,0.993,0.0,0.456,0.0,0.0);
+  else {
+    printf("compute_fiducial_data_vector: no fiducial parameters for %s\nEXIT\n",designation);
+    exit(1);
+  }
+}
+
+// runs the SRD scenario t at the given precision tier, writes datav/<probes>_<filename><suffix>
+void compute_scenario_data_vector(int t, char *tier, char *suffix, char *filename)
+{
+  char arg1[400],arg2[400],details[600];
   double area_table[12]={7500.0,13000.0,16000.0,10000.0,15000.0,20000.0,10000.0,15000.0,20000.0,10000.0,15000.0,20000.0};
   double nsource_table[12]={9.8,12.1,15.1,15.1,18.9,23.5,20.3,23.5,26.9,26.9,30.8,35.0};
   double nlens_table[12]={15.0,20.0,25.0,25.0,32.0,41.0,35.0,41.0,48.0,48.0,57.0,67.0};
@@ -828,7 +798,7 @@ double log_like_wrapper(input_cosmo_params ic, input_nuisance_params in)
   int Ntomo_lens[12]={5,5,5,7,7,7,9,9,9,10,10,10};
 
   init_cosmo();
-  init_fisher_precision();
+  init_precision(tier);
   init_binning_fourier(20,20.0,15000.0,3000.0,21.0,5,Ntomo_lens[t]);
   init_survey(survey_designation[t]);
   sprintf(arg1,"zdistris/%s",source_zfile[t]);
@@ -840,13 +810,199 @@ double log_like_wrapper(input_cosmo_params ic, input_nuisance_params in)
   init_priors("none","none","none","none");
   
   sprintf(filename,"%s_area%le_ng%le_nl%le",survey_designation[t],area_table[t],nsource_table[t],nlens_table[t]);
-  if(strstr(survey_designation[t],"LSST_Y1") != NULL) compute_data_vector(filename,0.3156,0.831,0.9645,-1.,0.,0.0491685,0.6727,0.,0.,1.413566e+00,1.567919e+00,1.731037e+00,1.900583e+00,2.074809e+00,1.413566e+00,1.567919e+00,1.731037e+00,1.900583e+00,2.074809e+00,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.05,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.03,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,5.92,1.1,-0.47,0.0,0.0,0.0,0.0,0.0,0.0,0.0,3.207,0.993,0.0,0.456,0.0,0.0);
+  sprintf(details,"%s%s",filename,suffix);
+  compute_fiducial_data_vector(survey_designation[t],details);
+}
 
-  if(strstr(survey_designation[t],"LSST_Y3") != NULL) compute_data_vector(filename,0.3156,0.831,0.9645,-1.,0.,0.0491685,0.6727,0.,0.,1.392398e+00,1.500535e+00,1.613747e+00,1.731037e+00,1.851600e+00,1.974761e+00,2.100003e+00,1.731037e+00,1.900583e+00,2.074809e+00,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.05,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.03,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,5.92,1.1,-0.47,0.0,0.0,0.0,0.0,0.0,0.0,0.0,3.207,0.993,0.0,0.456,0.0,0.0);
+// compares the data vectors of one scenario computed at two precision tiers
+// tier1 runs in a forked child so that both start from freshly allocated look-up tables
+void validate_precision(int t, char *tier1, char *tier2)
+{
+  char filename[500],suffix1[100],suffix2[100],file1[1000],file2[1000];
+  char block_name[5][20]={"shear","ggl","clustering","clusterN","clusterWL"};
+  int i,k,n,status;
+  double *d1,*d2,diff,maxdiff;
+  FILE *F;
+  pid_t pid;
+
+  sprintf(suffix1,"_%s",tier1);
+  sprintf(suffix2,"_%s",tier2);
+  pid=fork();
+  if (pid < 0){
+    printf("validate_precision: fork failed\nEXIT\n");
+    exit(1);
+  }
+  if (pid == 0){
+    compute_scenario_data_vector(t,tier1,suffix1,filename);
+    _exit(0);
+  }
+  waitpid(pid,&status,0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0){
+    printf("validate_precision: computation with tier %s failed\nEXIT\n",tier1);
+    exit(1);
+  }
+  compute_scenario_data_vector(t,tier2,suffix2,filename);
+  sprintf(file1,"datav/%s_%s%s",like.probes,filename,suffix1);
+  sprintf(file2,"datav/%s_%s%s",like.probes,filename,suffix2);
+
+  d1=create_double_vector(0,like.Ndata-1);
+  d2=create_double_vector(0,like.Ndata-1);
+  F=fopen(file1,"r");
+  if (F==NULL){printf("validate_precision: could not open %s\nEXIT\n",file1); exit(1);}
+  for (i=0;i<like.Ndata; i++) fscanf(F,"%d %le\n",&n,&d1[i]);
+  fclose(F);
+  F=fopen(file2,"r");
+  if (F==NULL){printf("validate_precision: could not open %s\nEXIT\n",file2); exit(1);}
+  for (i=0;i<like.Ndata; i++) fscanf(F,"%d %le\n",&n,&d2[i]);
+  fclose(F);
+
+  printf("\n");
+  printf("-------------------------------------------\n");
+  printf("Precision validation %s vs %s\n",tier1,tier2);
+  printf("-------------------------------------------\n");
+  for (k=0;k<5; k++){
+    if (like_ctx->N[k]==0) continue;
+    maxdiff=0.0;
+    for (i=like_ctx->start[k];i<like_ctx->start[k]+like_ctx->N[k]; i++){
+      if (d2[i]!=0.0){
+        diff=fabs(d1[i]/d2[i]-1.0);
+        if (diff > maxdiff) maxdiff=diff;
+      }
+    }
+    printf("%s: %d elements, max fractional difference %le\n",block_name[k],like_ctx->N[k],maxdiff);
+  }
+  free_double_vector(d1,0,like.Ndata-1);
+  free_double_vector(d2,0,like.Ndata-1);
+}
+
+// largest fractional deviation of the batched Limber spectra (limber.c) from the per-ell integrals of
+// cosmolike_core, over all ell bins and tomography pairs kept in the data vector, for the current parameters
+#define LIMBER_TOL 1.e-3
+double check_limber(char *tier)
+{
+  int i,nz,z1,z2,Nsub=limber.Nsub,Ncl=like_ctx->Ncl;
+  double *ell=like_ctx->ell,Cl[Ncl],dev[3]={0.,0.,0.};
 
-  if(strstr(survey_designation[t],"LSST_Y6") != NULL) compute_data_vector(filename,0.3156,0.831,0.9645,-1.,0.,0.0491685,0.6727,0.,0.,1.380752e+00,1.463865e+00,1.550281e+00,1.639495e+00,1.731037e+00,1.824565e+00,1.919738e+00,2.016299e+00,2.114025e+00,2.074809e+00,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.05,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.03,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,5.92,1.1,-0.47,0.0,0.0,0.0,0.0,0.0,0.0,0.0,3.207,0.993,0.0,0.456,0.0,0.0);
+  init_bandpower(0); // bin centres, as the per-ell integrals
+  limber_setup(Ncl,ell);
+  for (nz = 0; nz < tomo.shear_Npowerspectra; nz++){
+    z1 = Z1(nz); z2 = Z2(nz);
+    C_shear_tomo_sys_ell(Ncl,ell,z1,z2,Cl);
+    for (i = 0; i < Ncl; i++) dev[0]=fmax(dev[0],fabs(Cl[i]/C_shear_tomo_sys(ell[i],z1,z2)-1.));
+  }
+  for (nz = 0; nz < tomo.ggl_Npowerspectra; nz++){
+    z1 = ZL(nz); z2 = ZS(nz);
+    C_gl_tomo_sys_ell(Ncl,ell,z1,z2,Cl);
+    for (i = 0; i < Ncl; i++) if (kmax_cut(Ncl,ell,i,z1)) dev[1]=fmax(dev[1],fabs(Cl[i]/C_gl_tomo_sys(ell[i],z1,z2)-1.));
+  }
+  for (nz = 0; nz < tomo.clustering_Npowerspectra; nz++){
+    C_cl_tomo_ell(Ncl,ell,nz,nz,Cl);
+    for (i = 0; i < Ncl; i++) if (kmax_cut(Ncl,ell,i,nz)) dev[2]=fmax(dev[2],fabs(Cl[i]/C_cl_tomo_nointerp(ell[i],nz,nz)-1.));
+  }
+  init_bandpower(Nsub);
+  printf("Limber %s (Na=%d): max fractional deviation from the per-ell integrals: shear %le ggl %le clustering %le\n",tier,limber.Na,dev[0],dev[1],dev[2]);
+  for (i=0;i<3; i++) if (dev[i] > LIMBER_TOL) printf("check_limber: %s deviation above %.0e, raise limber.Na\n",probe_names[i],LIMBER_TOL);
+  return fmax(dev[0],fmax(dev[1],dev[2]));
+}
+
+// check_limber for scenario t at every precision tier, each in a forked child
+// so that every tier starts from freshly allocated look-up tables
+void validate_limber(int t)
+{
+  char tiers[3][20]={"fast","standard","high"},filename[500],suffix[100];
+  int k,status;
+  pid_t pid;
 
-  if(strstr(survey_designation[t],"LSST_Y10") != NULL) compute_data_vector(filename,0.3156,0.831,0.9645,-1.,0.,0.0491685,0.6727,0.,0.,1.376695e+00,1.451179e+00,1.528404e+00,1.607983e+00,1.689579e+00,1.772899e+00,1.857700e+00,1.943754e+00,2.030887e+00,2.118943e+00,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.05,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.03,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,0.0,5.92,1.1,-0.47,0.0,0.0,0.0,0.0,0.0,0.0,0.0,3.207,0.993,0.0,0.456,0.0,0.0);
+  for (k=0;k<3; k++){
+    fflush(stdout);
+    pid=fork();
+    if (pid < 0){
+      printf("validate_limber: fork failed\nEXIT\n");
+      exit(1);
+    }
+    if (pid == 0){
+      sprintf(suffix,"_%s",tiers[k]);
+      compute_scenario_data_vector(t,tiers[k],suffix,filename);
+      check_limber(tiers[k]);
+      fflush(stdout);
+      _exit(0);
+    }
+    waitpid(pid,&status,0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0){
+      printf("validate_limber: tier %s failed\nEXIT\n",tiers[k]);
+      exit(1);
+    }
+  }
+}
+
+// largest fractional deviation of the cluster lensing spectra of the data vector (cluster_lensing.c) from the
+// cosmolike_core C_cgl_tomo_sys used by the cgl covariance, over all (richness bin, zc, zs, ell_Cluster)
+#define CLUSTER_LENSING_TOL 5.e-2
+double check_cluster_lensing()
+{
+  int i,nz,nN,zl,zs,Nl=like_ctx->Ncl_Cluster;
+  double *ell=like_ctx->ell_Cluster,Cl[Nl],Cc,dev,maxdev=0.;
+
+  cluster_lensing_setup(Nl,ell);
+  for (nN = 0; nN < Cluster.N200_Nbin; nN++){
+    for (nz = 0; nz < tomo.cgl_Npowerspectra; nz++){
+      zl = ZC(nz); zs = ZSC(nz);
+      C_cgl_tomo_ell(Nl,zl,nN,zs,Cl);
+      for (i = 0; i < Nl; i++){
+        if(like.shearcalib==1) Cl[i] *=(1.0+nuisance.shear_calibration_m[zs]);
+        Cc=C_cgl_tomo_sys(ell[i],zl,nN,zs);
+        dev=(Cc != 0. ? fabs(Cl[i]/Cc-1.) : fabs(Cl[i]));
+        if (dev > maxdev) maxdev=dev;
+        printf("cluster z bin %d, richness bin %d, source bin %d, ell %e: table %e, C_cgl_tomo_sys %e, deviation %e\n",zl,nN,zs,ell[i],Cl[i],Cc,dev);
+      }
+    }
+  }
+  if (maxdev > CLUSTER_LENSING_TOL) printf("check_cluster_lensing: WARNING table deviates from C_cgl_tomo_sys by %e > %e\n",maxdev,CLUSTER_LENSING_TOL);
+  return maxdev;
+}
+
+// cluster count and cluster lensing tables (cluster_counts.c, cluster_lensing.c) against the cosmolike_core
+// N_N200 and C_cgl_tomo_sys of the cluster covariance, for scenario t at its fiducial point
+void validate_clusters(int t)
+{
+  char filename[500];
+  compute_scenario_data_vector(t,"high","",filename);
+  check_cluster_counts();
+  check_cluster_lensing();
+}
+
+// usage: ./like_fourier <scenario> [fast|standard|high]
+//        ./like_fourier <scenario> validate_limber
+//        ./like_fourier <scenario> validate_clusters
+//        ./like_fourier <scenario> validate <tier1> <tier2>
+//        ./like_fourier <config.ini>
+ int main(int argc, char** argv)
+{
+  int hit=atoi(argv[1]);
+  char filename[500];
+  int t;
+  t=hit;
+  if (strstr(argv[1],".ini") != NULL){
+    init_precision("high");
+    init_from_config(argv[1]);
+    sprintf(filename,"%s_area%le_ng%le_nl%le",config.survey,survey.area,survey.n_gal,survey.n_lens);
+    compute_fiducial_data_vector(config.survey,filename);
+    return 0;
+  }
+  if (argc > 4 && strcmp(argv[2],"validate")==0){
+    validate_precision(t,argv[3],argv[4]);
+    return 0;
+  }
+  if (argc > 2 && strcmp(argv[2],"validate_limber")==0){
+    validate_limber(t);
+    return 0;
+  }
+  if (argc > 2 && strcmp(argv[2],"validate_clusters")==0){
+    validate_clusters(t);
+    return 0;
+  }
+  if (argc > 2) compute_scenario_data_vector(t,argv[2],"",filename);
+  else compute_scenario_data_vector(t,"high","",filename);
   return 0;
 }
 
@@ -0,0 +1,200 @@
+// batched Limber integrals for the shear, ggl and clustering spectra
+// all ell bins of all tomography pairs are integrated on one fixed grid in a:
+// Pdelta((ell+0.5)/f_K,a) is evaluated once per (ell,a) node and shared by every pair and probe,
+// the lensing, IA and galaxy kernels once per (bin,a) node, so each C(ell) is a weighted sum over the grid
+// same integrands and integration limits as C_shear_tomo_nointerp, C_shear_shear_IA, C_gl_tomo_nointerp,
+// C_ggl_IA and C_cl_tomo_nointerp; kernels are set to zero outside each bin's integration range
+// limber.Na=0 switches back to the per-ell integration of cosmolike_core
+// band-power mode (init_bandpower, Nsub>0): spectra are evaluated at Nsub sub-bin centres in log ell per ell bin,
+// all sharing the same grid, and averaged over each bin with (2 ell+1) mode weights; ell bins are logarithmic
+// the IA==2 terms added in like_fourier.c (C_IA_lin_ell) are averaged over the same sub-bins
+// limber_setup has to be called after every parameter change, set_data_all does this for the data vector
+
+typedef struct {
+  int Na; //quadrature nodes in a, set by init_precision or init_limber
+  int Ncl;
+  int Nsub; //ell sub-bins per bin for bin-averaged spectra, 0: bin centre
+  int Nell; //rows of Pk, Ncl or Ncl*Nsub
+  int ready; //grid computed for the current parameters
+  double amin;
+  double *ell; //[Nell]
+  double *bw; //bin-average weights of the Pk rows, [Nell]
+  double *a, *w; //nodes, trapezoid weight x dchi_da/f_K^2, [Na]
+  double *Pk; //Pdelta((ell+0.5)/f_K,a), [Nell][Na]
+  double *Wk; //W_kappa of the source bins, [shear_Nbin][Na]
+  double *Ws; //NLA amplitude x W_source x hoverh0 of the source bins, [shear_Nbin][Na]
+  double *Wg; //W_gal of the lens bins, [clustering_Nbin][Na]
+}limbergrid;
+
+limbergrid limber = {250, 0, 0, 0, 0, 0., NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
+
+void init_limber(int Na);
+void init_bandpower(int Nsub);
+void limber_setup(int Ncl, double *ell);
+void limber_C_shear(int z1, int z2, double *Cl);
+void limber_C_gl(int zl, int zs, double *Cl);
+void limber_C_cl(int z1, int z2, double *Cl);
+void clear_datav_cache(void); //datav_cache.c
+
+void limber_free()
+{
+  free(limber.ell); free(limber.bw); free(limber.a); free(limber.w); free(limber.Pk);
+  free(limber.Wk); free(limber.Ws); free(limber.Wg);
+  limber.ell=limber.bw=limber.a=limber.w=limber.Pk=limber.Wk=limber.Ws=limber.Wg=NULL;
+  limber.Ncl=limber.Nell=0;
+  limber.ready=0;
+}
+
+void init_limber(int Na)
+{
+  clear_datav_cache();
+  limber_free();
+  limber.Na=Na;
+  printf("Limber integration: %s\n",(Na > 0 ? "batched over ell" : "per ell (cosmolike_core)"));
+}
+
+void init_bandpower(int Nsub)
+{
+  clear_datav_cache();
+  limber_free();
+  limber.Nsub=Nsub;
+  if (Nsub > 0 && limber.Na==0) printf("Band powers: need the batched Limber integration, init_limber(0) evaluates bin centres\n");
+  else if (Nsub > 0) printf("Band powers: spectra averaged over %d sub-bins per ell bin\n",Nsub);
+  else printf("Band powers: off, spectra at the ell bin centres\n");
+}
+
+void limber_alloc(int Ncl)
+{
+  int Na=limber.Na;
+  limber_free();
+  limber.Ncl=Ncl;
+  limber.Nell=(limber.Nsub > 0 ? Ncl*limber.Nsub : Ncl);
+  limber.ell=malloc(limber.Nell*sizeof(double));
+  limber.bw=malloc(limber.Nell*sizeof(double));
+  limber.a=malloc(Na*sizeof(double));
+  limber.w=malloc(Na*sizeof(double));
+  limber.Pk=malloc(limber.Nell*Na*sizeof(double));
+  limber.Wk=calloc(10*Na,sizeof(double));
+  limber.Ws=calloc(10*Na,sizeof(double));
+  limber.Wg=calloc(10*Na,sizeof(double));
+  if (limber.Wg==NULL){
+    printf("limber_alloc: allocation failed\nEXIT\n");
+    exit(1);
+  }
+}
+
+// amplitude of the NLA term in int_for_C_shear_shear_IA and int_for_C_ggl_IA
+double limber_IA_norm(double a)
+{
+  return A_IA_Joachimi(a)*cosmology.Omega_m*nuisance.c1rhocrit_ia*growfac(0.9999)/growfac(a);
+}
+
+void limber_setup(int Ncl, double *ell)
+{
+  int i,j,n,s,Na=limber.Na,Nsub=limber.Nsub;
+  double amin=0.99999,amax=0.99999,a,fK,da,dlog,l,norm;
+
+  limber.ready=0;
+  if (Na==0) return;
+  if (Ncl!=limber.Ncl || limber.a==NULL) limber_alloc(Ncl);
+  if (Nsub==0){
+    for (i=0;i<Ncl; i++){
+      limber.ell[i]=ell[i];
+      limber.bw[i]=1.;
+    }
+  }
+  else {
+    dlog=(Ncl > 1 ? log(ell[1]/ell[0]) : log(like.lmax/like.lmin));
+    for (i=0;i<Ncl; i++){
+      norm=0.;
+      for (s=0;s<Nsub; s++){
+        l=ell[i]*exp(dlog*((s+0.5)/Nsub-0.5));
+        limber.ell[i*Nsub+s]=l;
+        limber.bw[i*Nsub+s]=(2.*l+1.)*l; // (2 ell+1) d ell per d ln ell
+        norm+=limber.bw[i*Nsub+s];
+      }
+      for (s=0;s<Nsub; s++) limber.bw[i*Nsub+s]/=norm;
+    }
+  }
+
+  for (n=0;n<tomo.shear_Nbin; n++) amin=fmin(amin,amin_source(n));
+  for (n=0;n<tomo.clustering_Nbin; n++) amin=fmin(amin,amin_lens(n));
+  limber.amin=amin;
+  da=(amax-amin)/(Na-1.);
+  for (j=0;j<Na; j++){
+    a=amin+j*da;
+    fK=f_K(chi(a));
+    limber.a[j]=a;
+    limber.w[j]=((j==0 || j==Na-1) ? 0.5*da : da)*dchi_da(a)/(fK*fK);
+    for (i=0;i<limber.Nell; i++) limber.Pk[i*Na+j]=Pdelta((limber.ell[i]+0.5)/fK,a);
+    for (n=0;n<tomo.shear_Nbin; n++){
+      limber.Wk[n*Na+j]=limber.Ws[n*Na+j]=0.;
+      if (a < amin_source(n)) continue;
+      limber.Wk[n*Na+j]=W_kappa(a,fK,(double)n);
+      if (like.IA==1) limber.Ws[n*Na+j]=limber_IA_norm(a)*W_source(a,(double)n)*hoverh0(a);
+    }
+    for (n=0;n<tomo.clustering_Nbin; n++){
+      limber.Wg[n*Na+j]=0.;
+      if (a < amin_lens(n) || a > amax_lens(n)) continue;
+      limber.Wg[n*Na+j]=W_gal(a,(double)n);
+    }
+  }
+  limber.ready=1;
+}
+
+// C(ell) = sum_a w(a) K1(a) K2(a) P(ell,a) for all rows of the grid, averaged into the ell bins
+void limber_sum(double *K1, double *K2, double *Cl)
+{
+  int i,j,s,Na=limber.Na,Nsub=(limber.Nsub > 0 ? limber.Nsub : 1);
+  double *K,*P,C;
+  K=malloc(Na*sizeof(double));
+  for (j=0;j<Na; j++) K[j]=limber.w[j]*K1[j]*K2[j];
+  for (i=0;i<limber.Ncl; i++){
+    Cl[i]=0.;
+    for (s=0;s<Nsub; s++){
+      P=limber.Pk+(i*Nsub+s)*Na;
+      C=0.;
+      for (j=0;j<Na; j++) C+=K[j]*P[j];
+      Cl[i]+=limber.bw[i*Nsub+s]*C;
+    }
+  }
+  free(K);
+}
+
+void limber_C_shear(int z1, int z2, double *Cl)
+{
+  int j,Na=limber.Na;
+  double *K1,*K2;
+  if (like.IA!=1){
+    limber_sum(limber.Wk+z1*Na,limber.Wk+z2*Na,Cl);
+    return;
+  }
+  // (W_kappa - NLA W_source) for both bins: GG, GI, IG and II in one sum
+  K1=malloc(2*Na*sizeof(double));
+  K2=K1+Na;
+  for (j=0;j<Na; j++){
+    K1[j]=limber.Wk[z1*Na+j]-limber.Ws[z1*Na+j];
+    K2[j]=limber.Wk[z2*Na+j]-limber.Ws[z2*Na+j];
+  }
+  limber_sum(K1,K2,Cl);
+  free(K1);
+}
+
+void limber_C_gl(int zl, int zs, double *Cl)
+{
+  int j,Na=limber.Na;
+  double *K;
+  if (like.IA!=1){
+    limber_sum(limber.Wg+zl*Na,limber.Wk+zs*Na,Cl);
+    return;
+  }
+  K=malloc(Na*sizeof(double));
+  for (j=0;j<Na; j++) K[j]=limber.Wk[zs*Na+j]-limber.Ws[zs*Na+j];
+  limber_sum(limber.Wg+zl*Na,K,Cl);
+  free(K);
+}
+
+void limber_C_cl(int z1, int z2, double *Cl)
+{
+  limber_sum(limber.Wg+z1*limber.Na,limber.Wg+z2*limber.Na,Cl);
+}
@@ -0,0 +1,177 @@
+// external Gaussian priors on the cosmological parameters, read from priors/ at init_priors time
+//   priors/combinations.txt  rows "name prior weight", rows with the same name are summed
+//   priors/<prior>.txt       "# params:" and "# fiducial:" header lines, followed by the Fisher (inverse covariance) matrix
+// all priors of a combination are added into one weighted precision matrix over the parameters they constrain,
+// so log_L_prior_registry costs a single quadratic form per likelihood call.
+// Adding a prior or changing a weight only touches the files.
+
+#define PRIOR_NPARAM 7
+#define PRIOR_DIR "priors"
+
+typedef struct {
+  char name[200];
+  int Nprior; //number of prior files combined
+  int Nparam; //number of constrained parameters
+  int index[PRIOR_NPARAM]; //position in prior_param_names
+  double fid[PRIOR_NPARAM];
+  double P[PRIOR_NPARAM][PRIOR_NPARAM]; //weighted sum of the prior Fisher matrices, [Nparam][Nparam]
+}priorregistry;
+
+priorregistry prior_registry = {"none", 0, 0, {0}, {0.}, {{0.}}};
+
+char prior_param_names[PRIOR_NPARAM][20]={"Omega_m","sigma_8","n_s","w0","wa","omb","h0"};
+
+int prior_combination_exists(char *name);
+void init_prior_registry(char *name);
+double log_L_prior_registry();
+
+double prior_param_value(int k)
+{
+  switch (k){
+    case 0: return cosmology.Omega_m;
+    case 1: return cosmology.sigma_8;
+    case 2: return cosmology.n_spec;
+    case 3: return cosmology.w0;
+    case 4: return cosmology.wa;
+    case 5: return cosmology.omb;
+    default: return cosmology.h0;
+  }
+}
+
+int prior_param_index(char *name)
+{
+  int k;
+  for (k=0;k<PRIOR_NPARAM; k++){
+    if (strcmp(name,prior_param_names[k])==0) return k;
+  }
+  printf("priors: parameter %s not defined\nEXIT\n",name);
+  exit(1);
+}
+
+// adds weight x the Fisher matrix in priors/<prior>.txt to the full PRIOR_NPARAM x PRIOR_NPARAM matrix P
+void add_prior_file(char *prior, double weight, double P[PRIOR_NPARAM][PRIOR_NPARAM], double *fid, int *set)
+{
+  char filename[500],line[2000],*tok;
+  int n=0,Nrow=0,k,idx[PRIOR_NPARAM];
+  double f[PRIOR_NPARAM];
+  FILE *F;
+
+  sprintf(filename,"%s/%s.txt",PRIOR_DIR,prior);
+  F=fopen(filename,"r");
+  if (F==NULL){
+    printf("priors: file %s not found\nEXIT\n",filename);
+    exit(1);
+  }
+  while (fgets(line,sizeof(line),F)!=NULL){
+    if (strncmp(line,"# params:",9)==0){
+      for (tok=strtok(line+9," \t\n"); tok!=NULL && n<PRIOR_NPARAM; tok=strtok(NULL," \t\n")) idx[n++]=prior_param_index(tok);
+      continue;
+    }
+    if (strncmp(line,"# fiducial:",11)==0){
+      k=0;
+      for (tok=strtok(line+11," \t\n"); tok!=NULL && k<PRIOR_NPARAM; tok=strtok(NULL," \t\n")) f[k++]=atof(tok);
+      if (k!=n){
+        printf("priors: %s has %d fiducial values for %d parameters\nEXIT\n",filename,k,n);
+        exit(1);
+      }
+      continue;
+    }
+    if (line[0]=='#' || strspn(line," \t\n")==strlen(line)) continue;
+    if (n==0 || Nrow>=n){
+      printf("priors: %s needs a '# params:' line and %d matrix rows\nEXIT\n",filename,n);
+      exit(1);
+    }
+    k=0;
+    for (tok=strtok(line," \t\n"); tok!=NULL && k<n; tok=strtok(NULL," \t\n")) P[idx[Nrow]][idx[k++]]+=weight*atof(tok);
+    Nrow++;
+  }
+  fclose(F);
+  if (Nrow!=n){
+    printf("priors: %s has %d rows for %d parameters\nEXIT\n",filename,Nrow,n);
+    exit(1);
+  }
+  // priors are combined around a common fiducial point
+  for (k=0;k<n; k++){
+    if (set[idx[k]] && fabs(fid[idx[k]]-f[k])>1.e-10){
+      printf("priors: %s fiducial %s=%e differs from %e of the other priors\nEXIT\n",filename,prior_param_names[idx[k]],f[k],fid[idx[k]]);
+      exit(1);
+    }
+    fid[idx[k]]=f[k];
+    set[idx[k]]=1;
+  }
+}
+
+int prior_combination_exists(char *name)
+{
+  char line[1000],cname[200];
+  int found=0;
+  FILE *F;
+
+  if (strcmp(name,"none")==0) return 1;
+  F=fopen(PRIOR_DIR "/combinations.txt","r");
+  if (F==NULL) return 0;
+  while (fgets(line,sizeof(line),F)!=NULL){
+    if (line[0]!='#' && sscanf(line,"%199s",cname)==1 && strcmp(cname,name)==0) found=1;
+  }
+  fclose(F);
+  return found;
+}
+
+void init_prior_registry(char *name)
+{
+  char line[1000],cname[200],prior[200];
+  double weight,P[PRIOR_NPARAM][PRIOR_NPARAM]={{0.}},fid[PRIOR_NPARAM]={0.};
+  int i,j,set[PRIOR_NPARAM]={0};
+  FILE *F;
+
+  memset(&prior_registry,0,sizeof(priorregistry));
+  sprintf(prior_registry.name,"%s",name);
+  if (strcmp(name,"none")==0) return;
+  F=fopen(PRIOR_DIR "/combinations.txt","r");
+  if (F==NULL){
+    printf("priors: %s/combinations.txt not found\nEXIT\n",PRIOR_DIR);
+    exit(1);
+  }
+  while (fgets(line,sizeof(line),F)!=NULL){
+    if (line[0]=='#' || sscanf(line,"%199s %199s %le",cname,prior,&weight)!=3) continue;
+    if (strcmp(cname,name)!=0) continue;
+    add_prior_file(prior,weight,P,fid,set);
+    prior_registry.Nprior++;
+    printf("prior %s: adding %s with weight %e\n",name,prior,weight);
+  }
+  fclose(F);
+  if (prior_registry.Nprior==0){
+    printf("priors: combination %s not defined in %s/combinations.txt\nEXIT\n",name,PRIOR_DIR);
+    exit(1);
+  }
+  // keep only the constrained parameters
+  for (i=0;i<PRIOR_NPARAM; i++){
+    for (j=0;j<PRIOR_NPARAM; j++){
+      if (P[i][j]!=0.){
+        prior_registry.index[prior_registry.Nparam]=i;
+        prior_registry.fid[prior_registry.Nparam]=fid[i];
+        prior_registry.Nparam++;
+        break;
+      }
+    }
+  }
+  for (i=0;i<prior_registry.Nparam; i++){
+    for (j=0;j<prior_registry.Nparam; j++){
+      prior_registry.P[i][j]=P[prior_registry.index[i]][prior_registry.index[j]];
+    }
+  }
+}
+
+double log_L_prior_registry()
+{
+  double d[PRIOR_NPARAM],chisqr=0.;
+  int i,j;
+
+  if (prior_registry.Nparam==0) return 0.;
+  for (i=0;i<prior_registry.Nparam; i++) d[i]=prior_param_value(prior_registry.index[i])-prior_registry.fid[i];
+  for (i=0;i<prior_registry.Nparam; i++){
+    chisqr+=prior_registry.P[i][i]*d[i]*d[i];
+    for (j=i+1;j<prior_registry.Nparam; j++) chisqr+=2.*prior_registry.P[i][j]*d[i]*d[j];
+  }
+  return -0.5*chisqr;
+}
@@ -0,0 +1,56 @@
+import sys
+import re
+import numpy as np
+
+# Synthesizes the 3x2pt covariance of another survey area and source/lens density from one run
+# with [output] cov_components = 1 (compute_covariances_fourier.c writes covparallel/comp_<survey.name>_*).
+#
+# cat covparallel/comp_<survey.name>* > cov/comp_<survey.name>
+# python rescale_cov.py <component archive> <output archive> <area> <n_source> <n_lens> [<area_ref> <n_source_ref> <n_lens_ref>]
+#   the reference values default to the _area.._ng.._nl.. tag of survey.name in the archive name,
+#   the output has the usual "i j ell1 ell2 z1 z2 z3 z4 c_g c_ng" rows.
+#
+# Gaussian part: c_g = (A_ref/A) sum_k G_k (n_source_ref/n_source)^p_k (n_lens_ref/n_lens)^q_k over the
+# noise-order components of cov_g_table.c, exact as long as the n(z) shapes are unchanged.
+# Non-Gaussian part: c_ng = (A_ref/A) (cNG + SSC), exact for the connected term, for the SSC term it assumes
+# survey_variance scales as 1/area (same footprint shape).
+# Cluster blocks depend on the cluster counts and are not part of the component archive.
+
+# powers of (n_source_ref/n_source, n_lens_ref/n_lens) of the G_TABLE_NCOMP components
+noise_powers = [(0,0),(1,0),(0,1),(2,0),(0,2),(1,1)]
+
+def reference_from_name(filename):
+    m = re.search(r'_area([0-9.e+-]+)_ng([0-9.e+-]+)_nl([0-9.e+-]+)',filename)
+    if m is None:
+        print("rescale_cov: no _area.._ng.._nl.. tag in %s, give the reference values" % filename)
+        sys.exit(1)
+    return [float(x) for x in m.groups()]
+
+def rescale(comp,area,n_source,n_lens,area_ref,n_source_ref,n_lens_ref):
+    # comp: rows of the component archive, returns rows "i j ell1 ell2 z1 z2 z3 z4 c_g c_ng"
+    # columns: 10 archive columns, the Gaussian components, connected NG and SSC
+    if comp.shape[1] != 10+len(noise_powers)+2:
+        print("rescale_cov: expected %d columns, found %d" % (10+len(noise_powers)+2,comp.shape[1]))
+        sys.exit(1)
+    rs = n_source_ref/n_source
+    rl = n_lens_ref/n_lens
+    out = np.array(comp[:,:10])
+    out[:,8] = 0.
+    for k,(p,q) in enumerate(noise_powers):
+        out[:,8] += comp[:,10+k]*rs**p*rl**q
+    out[:,8] *= area_ref/area
+    out[:,9] = comp[:,9]*area_ref/area
+    return out
+
+if __name__ == "__main__":
+    if len(sys.argv) not in [6,9]:
+        print("usage: python rescale_cov.py <component archive> <output archive> <area> <n_source> <n_lens> [<area_ref> <n_source_ref> <n_lens_ref>]")
+        sys.exit(1)
+    if len(sys.argv) == 9:
+        ref = [float(x) for x in sys.argv[6:9]]
+    else:
+        ref = reference_from_name(sys.argv[1])
+    comp = np.atleast_2d(np.loadtxt(sys.argv[1]))
+    out = rescale(comp,float(sys.argv[3]),float(sys.argv[4]),float(sys.argv[5]),*ref)
+    np.savetxt(sys.argv[2],out,fmt=['%d','%d','%e','%e','%d','%d','%d','%d','%e','%e'])
+    print("rescale_cov: %d rows from area %e, n_source %e, n_lens %e to area %s, n_source %s, n_lens %s" % (out.shape[0],ref[0],ref[1],ref[2],sys.argv[3],sys.argv[4],sys.argv[5]))
@@ -0,0 +1,132 @@
+// linear (or diagonal quadratic) response model of the data vector around the fiducial point
+// fisher.py writes FM_taylor<survey>: the fiducial data vector d0 and, for every Fisher parameter k,
+// the five-point derivatives d1_k and d2_k (second derivative along k, no mixed terms) with step dp_k.
+// After init_taylor(file,order,trust_radius), model_data_vector returns
+//   d0 + sum_k d1_k dx_k (+ 0.5 d2_k dx_k^2 for order 2),  dx_k = p_k - p0_k,
+// as long as sqrt(sum_k (dx_k/dp_k)^2) <= trust_radius and all other parameters are at their fiducial values;
+// further from the fiducial point the full model is used.
+// The file records the survey year of its fiducial point ("# survey: LSST_Yx"), which has to match init_survey;
+// print_taylor_stats reports how often the expansion was used (log_like_batch adds the calls of its workers).
+// The expanded data vector enters the compressed or the full chi^2 alike, see log_multi_like.
+
+typedef struct {
+  int active, Ndata, Npar, order;
+  int index[EMU_NPAR]; //position of the expanded parameters in the parameter vector
+  double step[EMU_NPAR]; //derivative step dp of the expanded parameters
+  double fiducial[EMU_NPAR]; //fiducial parameter vector
+  double *d0; //[Ndata]
+  double *d1, *d2; //[Npar][Ndata]
+  double trust_radius;
+  long calls, fallbacks;
+}taylorpara;
+
+taylorpara taylor = {0, 0, 0, 0, {0}, {0.}, {0.}, NULL, NULL, NULL, 0., 0, 0};
+
+void init_taylor(char *filename, int order, double trust_radius);
+int taylor_data_vector(double *p, double *datav);
+void print_taylor_stats(void);
+
+// reads the header value list "# <key>: v_1 ... v_n" into v, returns n
+int taylor_header(FILE *F, char *key, double *v, int nmax)
+{
+  int n=0;
+  char line[20000],*s;
+  if (fgets(line,sizeof line,F)==NULL || line[0]!='#' || strstr(line,key)==NULL) return -1;
+  for (s=strtok(strchr(line,':')+1," \t\n"); s != NULL && n<nmax; s=strtok(NULL," \t\n")) v[n++]=atof(s);
+  return n;
+}
+
+void init_taylor(char *filename, int order, double trust_radius)
+{
+  int i,k,n,intspace,Npar=0;
+  double v[EMU_NPAR];
+  char line[20000],name[200],*s;
+  FILE *F;
+
+  F=fopen(filename,"r");
+  if (F==NULL){
+    printf("init_taylor: could not open %s\nEXIT\n",filename);
+    exit(1);
+  }
+  //"# name_1 ... name_Npar" as in FM_derivs, then index, step and fiducial header lines
+  if (fgets(line,sizeof line,F)==NULL || line[0]!='#'){
+    printf("init_taylor: %s has no parameter header\nEXIT\n",filename);
+    exit(1);
+  }
+  for (s=strtok(line+1," \t\n"); s != NULL; s=strtok(NULL," \t\n")) Npar++;
+  if (Npar==0 || Npar>EMU_NPAR || taylor_header(F,"index:",v,EMU_NPAR)!=Npar){
+    printf("init_taylor: %s has no parameter header\nEXIT\n",filename);
+    exit(1);
+  }
+  for (k=0;k<Npar; k++) taylor.index[k]=(int) v[k];
+  if (taylor_header(F,"step:",taylor.step,EMU_NPAR)!=Npar || taylor_header(F,"fiducial:",taylor.fiducial,EMU_NPAR)!=EMU_NPAR){
+    printf("init_taylor: %s has no step or fiducial header\nEXIT\n",filename);
+    exit(1);
+  }
+  if (fgets(line,sizeof line,F)==NULL || sscanf(line,"# survey: %199s",name)!=1){
+    printf("init_taylor: %s has no survey header\nEXIT\n",filename);
+    exit(1);
+  }
+  if (strcmp(name,survey.name)!=0){
+    printf("init_taylor: %s expands around the %s fiducial point, the survey is %s\nEXIT\n",filename,name,survey.name);
+    exit(1);
+  }
+  free(taylor.d0); free(taylor.d1); free(taylor.d2);
+  taylor.Ndata=like.Ndata;
+  taylor.Npar=Npar;
+  taylor.d0=malloc(like.Ndata*sizeof(double));
+  taylor.d1=malloc(Npar*like.Ndata*sizeof(double));
+  taylor.d2=malloc(Npar*like.Ndata*sizeof(double));
+  for (i=0,n=0;i<like.Ndata; i++){
+    n+=fscanf(F,"%d %le",&intspace,&taylor.d0[i]);
+    for (k=0;k<Npar; k++) n+=fscanf(F,"%le",&taylor.d1[k*like.Ndata+i]);
+    for (k=0;k<Npar; k++) n+=fscanf(F,"%le",&taylor.d2[k*like.Ndata+i]);
+  }
+  fclose(F);
+  if (n!=like.Ndata*(2+2*Npar)){
+    printf("init_taylor: %s does not have %d rows of %d columns\nEXIT\n",filename,like.Ndata,2+2*Npar);
+    exit(1);
+  }
+  taylor.order=(order > 1 ? 2 : 1);
+  taylor.trust_radius=trust_radius;
+  taylor.calls=0;
+  taylor.fallbacks=0;
+  taylor.active=1;
+  printf("init_taylor: order %d expansion in %d parameters, trust radius %e steps\n",taylor.order,Npar,trust_radius);
+}
+
+// Taylor data vector of p, returns 0 (datav unchanged) outside the trust region
+int taylor_data_vector(double *p, double *datav)
+{
+  int i,k,n;
+  double dx[EMU_NPAR],r2=0.,*d;
+  taylor.calls++;
+  for (k=0;k<EMU_NPAR; k++){
+    for (n=0;n<taylor.Npar && taylor.index[n]!=k; n++);
+    if (n<taylor.Npar){
+      dx[n]=p[k]-taylor.fiducial[k];
+      r2+=pow(dx[n]/taylor.step[n],2.);
+    }
+    else if (fabs(p[k]-taylor.fiducial[k])>1.e-10*fmax(1.,fabs(taylor.fiducial[k]))) r2=HUGE_VAL;
+  }
+  if (r2 > taylor.trust_radius*taylor.trust_radius){
+    taylor.fallbacks++;
+    return 0;
+  }
+  for (i=0;i<taylor.Ndata; i++) datav[i]=taylor.d0[i];
+  for (n=0;n<taylor.Npar; n++){
+    d=taylor.d1+n*taylor.Ndata;
+    for (i=0;i<taylor.Ndata; i++) datav[i]+=d[i]*dx[n];
+    if (taylor.order==2){
+      d=taylor.d2+n*taylor.Ndata;
+      for (i=0;i<taylor.Ndata; i++) datav[i]+=0.5*d[i]*dx[n]*dx[n];
+    }
+  }
+  return 1;
+}
+
+void print_taylor_stats(void)
+{
+  if (taylor.active && taylor.calls==0) printf("taylor: expansion set up but never called by the likelihood, check the likelihood setup\n");
+  printf("taylor: %ld calls, %ld (%.1f%%) outside the trust region evaluated with the full model\n",taylor.calls,taylor.fallbacks,(taylor.calls > 0 ? 100.*taylor.fallbacks/taylor.calls : 0.));
+}
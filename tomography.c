@@ -0,0 +1,216 @@
+// tomographic bin edges for the source and lens samples
+// modes: "equal_number" - equal galaxy number per bin from the n(z) CDF
+//        "equal_width"  - equal width in z between zmin and zmax
+//        "user"         - edges set with set_tomo_edges
+// defaults reproduce the SRD setup: equal-number source bins, equal-width lens bins in 0.2 < z < 1.2
+// init_tomography/set_tomo_edges must be called before init_galaxies
+
+#define TOMO_EQUAL_NUMBER 0
+#define TOMO_EQUAL_WIDTH 1
+#define TOMO_USER 2
+#define TOMO_NCDF 5000
+
+typedef struct {
+  int source_mode;
+  int lens_mode;
+  double source_zmin, source_zmax; //equal-width range, <0: full n(z) range
+  double lens_zmin, lens_zmax;
+  int source_Nedges, lens_Nedges; //number of user edges
+  double source_edges[11];
+  double lens_edges[11];
+}tomographypara;
+
+tomographypara tomography = {TOMO_EQUAL_NUMBER, TOMO_EQUAL_WIDTH, -1., -1., 0.2, 1.2, 0, 0, {0.}, {0.}};
+
+void init_tomography(char *source_mode, char *lens_mode);
+void set_tomo_edges(char *sample, int Nedges, double *edges);
+void set_tomo_range(char *sample, double zmin, double zmax);
+void tomo_edges_equal_number(double (*nz)(double, void*), double zmin, double zmax, int Nbin, double *zlow, double *zhigh);
+void set_source_tomo_bins();
+void set_lens_tomo_bins();
+void clear_datav_cache(void); //datav_cache.c
+
+int tomo_mode(char *mode)
+{
+  if (strcmp(mode,"equal_number")==0) return TOMO_EQUAL_NUMBER;
+  if (strcmp(mode,"equal_width")==0) return TOMO_EQUAL_WIDTH;
+  if (strcmp(mode,"user")==0) return TOMO_USER;
+  printf("tomography: binning mode %s not defined (equal_number, equal_width, user)\nEXIT\n",mode);
+  exit(1);
+}
+
+void init_tomography(char *source_mode, char *lens_mode)
+{
+  clear_datav_cache();
+  tomography.source_mode=tomo_mode(source_mode);
+  tomography.lens_mode=tomo_mode(lens_mode);
+  printf("Tomography: source bins %s, lens bins %s\n",source_mode,lens_mode);
+}
+
+void set_tomo_edges(char *sample, int Nedges, double *edges)
+{
+  int i;
+  clear_datav_cache();
+  if (Nedges < 2 || Nedges > 11){
+    printf("set_tomo_edges: %d edges given, need 2..11\nEXIT\n",Nedges);
+    exit(1);
+  }
+  for (i=1;i<Nedges; i++){
+    if (edges[i] <= edges[i-1]){
+      printf("set_tomo_edges: edges must be increasing\nEXIT\n");
+      exit(1);
+    }
+  }
+  if (strcmp(sample,"source")==0){
+    tomography.source_mode=TOMO_USER;
+    tomography.source_Nedges=Nedges;
+    for (i=0;i<Nedges; i++) tomography.source_edges[i]=edges[i];
+  }
+  else if (strcmp(sample,"lens")==0){
+    tomography.lens_mode=TOMO_USER;
+    tomography.lens_Nedges=Nedges;
+    for (i=0;i<Nedges; i++) tomography.lens_edges[i]=edges[i];
+  }
+  else {
+    printf("set_tomo_edges: sample %s not defined (source, lens)\nEXIT\n",sample);
+    exit(1);
+  }
+}
+
+// range for equal-width binning
+void set_tomo_range(char *sample, double zmin, double zmax)
+{
+  clear_datav_cache();
+  if (strcmp(sample,"source")==0){
+    tomography.source_zmin=zmin;
+    tomography.source_zmax=zmax;
+  }
+  else if (strcmp(sample,"lens")==0){
+    tomography.lens_zmin=zmin;
+    tomography.lens_zmax=zmax;
+  }
+  else {
+    printf("set_tomo_range: sample %s not defined (source, lens)\nEXIT\n",sample);
+    exit(1);
+  }
+}
+
+// edges of Nbin bins with equal number of galaxies:
+// trapezoidal CDF on TOMO_NCDF cells, binary search for each quantile, linear interpolation within the cell
+void tomo_edges_equal_number(double (*nz)(double, void*), double zmin, double zmax, int Nbin, double *zlow, double *zhigh)
+{
+  int k,lo,hi,mid;
+  double dz,frac,f,*cdf,*n;
+
+  dz=(zmax-zmin)/(1.0*TOMO_NCDF);
+  n=create_double_vector(0,TOMO_NCDF);
+  cdf=create_double_vector(0,TOMO_NCDF);
+  for (k=0;k<=TOMO_NCDF; k++) n[k]=nz(zmin+k*dz,NULL);
+  cdf[0]=0.0;
+  for (k=1;k<=TOMO_NCDF; k++) cdf[k]=cdf[k-1]+0.5*(n[k-1]+n[k])*dz;
+
+  zlow[0]=zmin;
+  zhigh[Nbin-1]=zmax;
+  for (k=0;k<Nbin-1; k++){
+    frac=(k+1.)/(1.*Nbin)*cdf[TOMO_NCDF];
+    lo=0;
+    hi=TOMO_NCDF;
+    while (hi-lo > 1){
+      mid=(lo+hi)/2;
+      if (cdf[mid] < frac) lo=mid;
+      else hi=mid;
+    }
+    f=(cdf[hi] > cdf[lo] ? (frac-cdf[lo])/(cdf[hi]-cdf[lo]) : 0.0);
+    zhigh[k]=zmin+(lo+f)*dz;
+    zlow[k+1]=zhigh[k];
+  }
+  free_double_vector(n,0,TOMO_NCDF);
+  free_double_vector(cdf,0,TOMO_NCDF);
+}
+
+void tomo_edges_equal_width(double zmin, double zmax, int Nbin, double *zlow, double *zhigh)
+{
+  int i;
+  double dtomo=(zmax-zmin)/Nbin;
+  for (i=0;i<Nbin; i++){
+    zlow[i]=zmin+i*dtomo;
+    zhigh[i]=zlow[i]+dtomo;
+  }
+  zhigh[Nbin-1]=zmax;
+}
+
+void tomo_edges_user(char *sample, int Nedges, double *edges, int Nbin, double *zlow, double *zhigh)
+{
+  int i;
+  if (Nedges != Nbin+1){
+    printf("tomography: %d %s edges set for %d bins\nEXIT\n",Nedges,sample,Nbin);
+    exit(1);
+  }
+  for (i=0;i<Nbin; i++){
+    zlow[i]=edges[i];
+    zhigh[i]=edges[i+1];
+  }
+}
+
+void set_source_tomo_bins()
+{
+  int k;
+  double zmin,zmax;
+
+  tomo.shear_Npowerspectra=(int) (tomo.shear_Nbin*(tomo.shear_Nbin+1)/2);
+  zdistr_histo_1(0.1, NULL); //reads the n(z) file and sets redshift.shear_zdistrpar_zmin/zmax
+  zmin=redshift.shear_zdistrpar_zmin;
+  zmax=redshift.shear_zdistrpar_zmax;
+  printf("\n");
+  switch (tomography.source_mode){
+    case TOMO_EQUAL_NUMBER:
+      printf("Source Sample - Tomographic Bin limits (equal number):\n");
+      tomo_edges_equal_number(zdistr_histo_1,zmin,zmax,tomo.shear_Nbin,tomo.shear_zmin,tomo.shear_zmax);
+      break;
+    case TOMO_EQUAL_WIDTH:
+      printf("Source Sample - Tomographic Bin limits (equal width):\n");
+      if (tomography.source_zmin >= 0.) zmin=tomography.source_zmin;
+      if (tomography.source_zmax > 0.) zmax=tomography.source_zmax;
+      tomo_edges_equal_width(zmin,zmax,tomo.shear_Nbin,tomo.shear_zmin,tomo.shear_zmax);
+      break;
+    default:
+      printf("Source Sample - Tomographic Bin limits (user):\n");
+      tomo_edges_user("source",tomography.source_Nedges,tomography.source_edges,tomo.shear_Nbin,tomo.shear_zmin,tomo.shear_zmax);
+  }
+  for (k=0;k<tomo.shear_Nbin; k++){
+    printf("min=%le max=%le\n",tomo.shear_zmin[k],tomo.shear_zmax[k]);
+  }
+  printf("redshift.shear_zdistrpar_zmin=%le max=%le\n",redshift.shear_zdistrpar_zmin,redshift.shear_zdistrpar_zmax);
+}
+
+void set_lens_tomo_bins()
+{
+  int k;
+  double zmin,zmax;
+
+  tomo.clustering_Npowerspectra = tomo.clustering_Nbin;
+  printf("\n");
+  switch (tomography.lens_mode){
+    case TOMO_EQUAL_NUMBER:
+      printf("Lens Sample - Tomographic Bin limits (equal number):\n");
+      pf_histo(0.5, NULL); //reads the n(z) file and sets redshift.clustering_zdistrpar_zmin/zmax
+      zmin=redshift.clustering_zdistrpar_zmin;
+      zmax=redshift.clustering_zdistrpar_zmax;
+      if (tomography.lens_zmin >= 0.) zmin=fmax(zmin,tomography.lens_zmin);
+      if (tomography.lens_zmax > 0.) zmax=fmin(zmax,tomography.lens_zmax);
+      tomo_edges_equal_number(pf_histo,zmin,zmax,tomo.clustering_Nbin,tomo.clustering_zmin,tomo.clustering_zmax);
+      break;
+    case TOMO_EQUAL_WIDTH:
+      printf("Lens Sample - Tomographic Bin limits (equal width):\n");
+      tomo_edges_equal_width(tomography.lens_zmin,tomography.lens_zmax,tomo.clustering_Nbin,tomo.clustering_zmin,tomo.clustering_zmax);
+      break;
+    default:
+      printf("Lens Sample - Tomographic Bin limits (user):\n");
+      tomo_edges_user("lens",tomography.lens_Nedges,tomography.lens_edges,tomo.clustering_Nbin,tomo.clustering_zmin,tomo.clustering_zmax);
+  }
+  for (k=0;k<tomo.clustering_Nbin; k++){
+    printf("min=%le max=%le\n",tomo.clustering_zmin[k],tomo.clustering_zmax[k]);
+  }
+  printf("\n");
+}
+#undef TOMO_NCDF
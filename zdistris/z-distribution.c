@@ -17,7 +17,9 @@ double sm2_trapzd(double (*func)(double), double a, double b, int n, double *s);
 
 double pf_LSST(double z);
 double int_for_zdistr(double z);
-void obstrat_zcalc();
+void obstrat_zcalc(char *scenario_file, int Nstep, double zmax);
+void set_zdistr_model(double z0, double alpha, double zmin, double zmax);
+void pf_LSST_grid(int Nstep, double dz, double *nz);
 
 double *sm2_vector(long nl, long nh)
 /* allocate a double vector with subscript range v[nl..nh] */
@@ -36,15 +38,17 @@ void sm2_error(char *s)
 }
 
 
+#define POLINT_NMAX 36
+
 void sm2_polint(double xa[], double ya[], int n, double x, double *y, double *dy)
+/* work arrays are static: polint is only called with n=K from sm2_qromb */
 {
 	int i,m,ns=1;
 	double den,dif,dift,ho,hp,w;
-	double *c,*d;
+	static double c[POLINT_NMAX+1],d[POLINT_NMAX+1];
 
+	if (n > POLINT_NMAX) sm2_error("sm2_polint: n too large");
 	dif=fabs(x-xa[1]);
-	c=sm2_vector(1,n);
-	d=sm2_vector(1,n);
 	for (i=1;i<=n;i++) {
 		if ( (dift=fabs(x-xa[i])) < dif) {
 			ns=i;
@@ -67,9 +71,8 @@ void sm2_polint(double xa[], double ya[], int n, double x, double *y, double *dy
 		}
 		*y += (*dy=(2*ns < (n-m) ? c[ns+1] : d[ns--]));
 	}
-	sm2_free_vector(d,1,n);
-	sm2_free_vector(c,1,n);
 }
+#undef POLINT_NMAX
 
 void sm2_free_vector(double *v, long nl, long nh)
 		/* free a double vector allocated with vector() */
@@ -146,6 +149,7 @@ typedef struct {
      double alpha; 
      double zdistrpar_zmin;   
      double zdistrpar_zmax;
+     double norm;
      char REDSHIFT_FILE[200];
 }redshiftpara;
 
@@ -155,6 +159,7 @@ redshiftpara redshift = {
   0.0,
   0.0,
   3.0,
+  1.0,
   ""
 };
 
@@ -166,79 +171,88 @@ double int_for_zdistr_LSST(double z)
 }
 
 
+/* sets the Smail-type model and computes its normalization once */
+void set_zdistr_model(double z0, double alpha, double zmin, double zmax)
+{
+  redshift.z0      = z0;
+  redshift.alpha   = alpha;
+  redshift.zdistrpar_zmin = zmin;
+  redshift.zdistrpar_zmax = zmax;
+  redshift.norm = 1.0/(sm2_qromb(int_for_zdistr_LSST,redshift.zdistrpar_zmin,redshift.zdistrpar_zmax));
+}
+
 
 double pf_LSST(double z)
 {
-  
-  double x, f, norm;
-  //First, compute the normalization
-  norm = 1.0/(sm2_qromb(int_for_zdistr_LSST,redshift.zdistrpar_zmin,redshift.zdistrpar_zmax));
+  double x, f;
 
   x = z/redshift.z0;
   f = pow(x,redshift.alpha);
   f=exp(-f);
-  return norm*pow(z,2.0)*f;
+  return redshift.norm*pow(z,2.0)*f;
 }
 
 
+/* n(z) of the current model at the bin centers of Nstep bins of width dz starting at z=0 */
+void pf_LSST_grid(int Nstep, double dz, double *nz)
+{
+  int i;
+  for(i=0;i<Nstep;i++) nz[i]=pf_LSST(0.0+(i+0.5)*dz);
+}
 
-void obstrat_zcalc()
+
+/* scenario file: one model per line, "<sample> <model index> <z0> <alpha>",
+   sample is the file prefix (WL, LSS); lines starting with # are skipped.
+   Output: <sample>_zdistri_model<index>_z0=<z0>_alpha=<alpha> with columns zlow zmid zhigh n(z) */
+void obstrat_zcalc(char *scenario_file, int Nstep, double zmax)
 {
-  int i,j;
-  double z,dz;
-  int Nstep=300;
-  double res;
-  FILE *F;
-  char filename[200];
-  
-  double WLz0[12]={0.194, 0.190, 0.186, 0.186, 0.183, 0.179,0.181, 0.179, 0.176, 0.176, 0.174, 0.171};
-  double WLalpha[12]={0.883, 0.862, 0.841,0.841, 0.821, 0.800,0.814, 0.800, 0.786,0.786, 0.772, 0.759};
-  
-  double LSSz0[12]={0.259, 0.261, 0.264,0.264, 0.268, 0.274,0.270, 0.274, 0.278,0.278, 0.283, 0.288};
-  double LSSalpha[12]={0.952, 0.937, 0.925,0.925, 0.915, 0.907,0.912, 0.907, 0.903,0.903, 0.900, 0.898};
-
-  
-  for(j=0;j<12;j++){  
-    sprintf(filename,"WL_zdistri_model%d_z0=%le_alpha=%le",j,WLz0[j],WLalpha[j]);
-    F=fopen(filename,"w");
-    
-    redshift.z0      = WLz0[j];
-    redshift.alpha   = WLalpha[j];
-    redshift.zdistrpar_zmin = 0.000001;
-    redshift.zdistrpar_zmax = 3.5;
-    dz=(redshift.zdistrpar_zmax-redshift.zdistrpar_zmin)/((Nstep)*1.0);
-    
-    for(i=0;i<Nstep;i++){
-      z=0.0+(i+0.5)*dz;
-      res=pf_LSST(z);
-      fprintf(F,"%le %le %le %le\n",0.0+i*dz,z,0.0+(i+1)*dz,res);   
-    }
-    fclose(F);
+  int i,j,Nmodel=0;
+  double z0,alpha,dz,*nz;
+  FILE *F,*S;
+  char filename[400],line[500],sample[100];
+
+  S=fopen(scenario_file,"r");
+  if (S==NULL){
+    printf("obstrat_zcalc: scenario file %s not found\nEXIT\n",scenario_file);
+    exit(1);
   }
+  nz=sm2_vector(0,Nstep-1);
+  while (fgets(line,sizeof line,S)!=NULL){
+    if (line[0]=='#' || sscanf(line,"%99s %d %le %le",sample,&j,&z0,&alpha)!=4) continue;
+    set_zdistr_model(z0,alpha,0.000001,zmax);
+    dz=(redshift.zdistrpar_zmax-redshift.zdistrpar_zmin)/((Nstep)*1.0);
+    pf_LSST_grid(Nstep,dz,nz);
 
-  for(j=0;j<12;j++){  
-    sprintf(filename,"LSS_zdistri_model%d_z0=%le_alpha=%le",j,LSSz0[j],LSSalpha[j]);
+    sprintf(filename,"%s_zdistri_model%d_z0=%le_alpha=%le",sample,j,z0,alpha);
     F=fopen(filename,"w");
-    
-    redshift.z0        = LSSz0[j];
-    redshift.alpha   =   LSSalpha[j];
-    redshift.zdistrpar_zmin = 0.000001;
-    redshift.zdistrpar_zmax = 3.5;
-    dz=(redshift.zdistrpar_zmax-redshift.zdistrpar_zmin)/((Nstep)*1.0);
-    
     for(i=0;i<Nstep;i++){
-      z=0.0+(i+0.5)*dz;
-      res=pf_LSST(z);
-      fprintf(F,"%le %le %le %le\n",0.0+i*dz,z,0.0+(i+1)*dz,res);   
+      fprintf(F,"%le %le %le %le\n",0.0+i*dz,0.0+(i+0.5)*dz,0.0+(i+1)*dz,nz[i]);   
     }
     fclose(F);
+    Nmodel++;
   }
+  fclose(S);
+  sm2_free_vector(nz,0,Nstep-1);
+  printf("wrote %d redshift distributions\n",Nmodel);
 }
 
 
 
-int main(void)
+/* usage: ./z-distribution [scenario file] [Nstep] [zmax]
+   defaults (SRD_scenarios.txt, 300, 3.5) reproduce the SRD n(z) files in this directory */
+int main(int argc, char **argv)
 {
-  obstrat_zcalc();
+  char scenario_file[400]="SRD_scenarios.txt";
+  int Nstep=300;
+  double zmax=3.5;
+
+  if (argc > 1) sprintf(scenario_file,"%s",argv[1]);
+  if (argc > 2) Nstep=atoi(argv[2]);
+  if (argc > 3) zmax=atof(argv[3]);
+  if (Nstep < 1 || zmax <= 0.0){
+    printf("z-distribution: invalid grid Nstep=%d zmax=%le\nEXIT\n",Nstep,zmax);
+    exit(1);
+  }
+  obstrat_zcalc(scenario_file,Nstep,zmax);
   return 0;
 }